@@ -4,6 +4,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <cstring>
 #include "Camera.h"
 #include "Shader.h"
 #include "Raycaster.h"
@@ -11,11 +12,46 @@
 #include "Light.h"
 #include "Skybox.h"
 #include "Model.h"
+#include "ModelInstance.h"
+#include "FrameTimer.h"
+#include "FixedTimestep.h"
+#include "UniformBuffer.h"
+#include "AssetLoader.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "InstanceBatch.h"
+#include "DrawList.h"
+#include "RenderQueue.h"
+#include "GpuTimer.h"
+#include "Profiler.h"
+#include "ProfilerOverlay.h"
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "OffscreenTarget.h"
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Vertical field of view and window height, for the projection and texture streaming
+const float FIELD_OF_VIEW = 45.0f;
+const float SCREEN_HEIGHT = 1080.0f;
+const float FAR_PLANE = 100.0f;
+
+// Movement and gravity advance in fixed ticks, 120 a second
+const float SIMULATION_STEP = 1.0f / 120.0f;
+
+// Instances per job when picking levels of detail and culling
+const size_t INSTANCES_PER_JOB = 256;
 
 // Create a Camera object
 Camera camera(glm::vec3(0.0f, 1.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
 
-// Time tracking variables for smooth movement
+// Frame time, fed to the simulation in fixed ticks
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
@@ -37,6 +73,28 @@ Raycaster raycaster;
 // VAO for the ray line
 unsigned int rayVAO, rayVBO;
 
+// Models placed in the scene
+const char* modelPaths[] = {
+    "Resources/Models/Guns/scene.gltf",
+    "Resources/Models/Ground/scene.gltf",
+    "Resources/Models/Plants1/scene.gltf",
+    "Resources/Models/Target/scene.gltf",
+    "Resources/Models/Tower/scene.gltf",
+    "Resources/Models/Hut/scene.gltf",
+    //"Resources/Models/Desert/scene.gltf",
+};
+std::vector<ModelInstance> scene;
+
+// Stress scene: copies of the target and foliage models, drawn either one
+// instance at a time or as instanced batches
+const unsigned int STRESS_TARGETS = 500;
+const unsigned int STRESS_FOLIAGE = 9500;
+std::vector<ModelInstance> stressScene;
+std::vector<std::unique_ptr<InstanceBatch>> stressBatches;
+
+// Runs the per-frame CPU work, and hit tests, off the GL thread
+std::unique_ptr<JobSystem> jobs;
+
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     static float lastX = 400.0f, lastY = 300.0f;
     static bool firstMouse = true;
@@ -57,40 +115,41 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 }
 
 
-// Process keyboard input
-void processInput(GLFWwindow* window) {
+// Process keyboard input held over one simulation tick of dt seconds
+void processInput(GLFWwindow* window, float dt) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
     // Camera movement
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
+        camera.ProcessKeyboard(FORWARD, dt);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
+        camera.ProcessKeyboard(BACKWARD, dt);
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
+        camera.ProcessKeyboard(LEFT, dt);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
+        camera.ProcessKeyboard(RIGHT, dt);
 
-    // Light position tweaking
+    // Light position tweaking, 6 units a second
+    float lightStep = 6.0f * dt;
     if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-        lightPos.z -= 0.1f;
+        lightPos.z -= lightStep;
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-        lightPos.z += 0.1f;
+        lightPos.z += lightStep;
     if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-        lightPos.x -= 0.1f;
+        lightPos.x -= lightStep;
     if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-        lightPos.x += 0.1f;
+        lightPos.x += lightStep;
     if (glfwGetKey(window, GLFW_KEY_PAGE_UP) == GLFW_PRESS)
-        lightPos.y += 0.1f;
+        lightPos.y += lightStep;
     if (glfwGetKey(window, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS)
-        lightPos.y -= 0.1f;
+        lightPos.y -= lightStep;
 
-    // Adjust light intensity
+    // Adjust light intensity, 3 a second
     if (glfwGetKey(window, GLFW_KEY_KP_ADD) == GLFW_PRESS) // '+'
-        lightIntensity = glm::min(lightIntensity + 0.05f, 10.0f);
+        lightIntensity = glm::min(lightIntensity + 3.0f * dt, 10.0f);
     if (glfwGetKey(window, GLFW_KEY_KP_SUBTRACT) == GLFW_PRESS) // '-'
-        lightIntensity = glm::max(lightIntensity - 0.05f, 0.0f);
+        lightIntensity = glm::max(lightIntensity - 3.0f * dt, 0.0f);
 
 
     // Jump
@@ -100,9 +159,9 @@ void processInput(GLFWwindow* window) {
     }
 }
 
-void applyGravity() {
+void applyGravity(float dt) {
     if (!onGround) {
-        camera.Position.y -= gravity * deltaTime;
+        camera.Position.y -= gravity * dt;
         if (camera.Position.y <= 0.99f) { // Assume ground plane is y = -1
             camera.Position.y = 1.1f;
             onGround = true;
@@ -116,49 +175,140 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
         double xpos, ypos;
         glfwGetCursorPos(window, &xpos, &ypos);
+        ProfileScope profile("hit test");
         raycaster.shootFromCamera(camera);
 
         // Debug output
         std::cout << "Ray Origin: " << raycaster.origin.x << ", " << raycaster.origin.y << ", " << raycaster.origin.z << std::endl;
         std::cout << "Ray Direction: " << raycaster.direction.x << ", " << raycaster.direction.y << ", " << raycaster.direction.z << std::endl;
 
+        // Find the closest model the shot hits, testing the models as jobs
+        std::vector<RayHit> instanceHits(scene.size());
+        TaskGraph hitTests;
+        hitTests.parallelFor(scene.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                raycaster.intersect(scene[i].getModel().getBVH(), scene[i].getModelMatrix(), instanceHits[i]);
+        });
+        jobs->run(hitTests);
+
+        RayHit hit;
+        const ModelInstance* hitInstance = nullptr;
+        for (size_t i = 0; i < scene.size(); i++) {
+            if (instanceHits[i].distance < hit.distance) {
+                hit = instanceHits[i];
+                hitInstance = &scene[i];
+            }
+        }
+        if (hitInstance) {
+            std::cout << "Hit " << hitInstance->getModel().getDirectory() << " mesh " << hit.mesh
+                << " triangle " << hit.triangle << " at distance " << hit.distance << std::endl;
+        }
+
         // Update the ray's vertex buffer for visualization
-        glm::vec3 rayEnd = raycaster.origin + raycaster.direction * 10.0f; // Extend the ray
+        float rayLength = hitInstance ? hit.distance : 10.0f;
+        glm::vec3 rayEnd = raycaster.origin + raycaster.direction * rayLength; // Extend the ray to the hit
 
         float rayVertices[] = {
             raycaster.origin.x, raycaster.origin.y, raycaster.origin.z,
             rayEnd.x, rayEnd.y, rayEnd.z
         };
 
-        glBindBuffer(GL_ARRAY_BUFFER, rayVBO);
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, rayVBO);
         glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(rayVertices), rayVertices);
     }
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
     {
-        std::cout << "Right mouse button clicked!" << std::endl;
+        // Shotgun: a burst of pellets traced together as ray packets
+        ProfileScope profile("hit test");
+        raycaster.shootBurstFromCamera(camera, 16, 4.0f);
+        std::vector<std::vector<RayHit>> instanceHits(scene.size(), std::vector<RayHit>(raycaster.burst.size()));
+        TaskGraph hitTests;
+        hitTests.parallelFor(scene.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                raycaster.intersectBurst(scene[i].getModel().getBVH(), scene[i].getModelMatrix(), instanceHits[i]);
+        });
+        jobs->run(hitTests);
+
+        // Each pellet stops at the closest model it hit
+        std::vector<RayHit> hits(raycaster.burst.size());
+        for (const std::vector<RayHit>& modelHits : instanceHits) {
+            for (size_t pellet = 0; pellet < hits.size(); pellet++) {
+                if (modelHits[pellet].distance < hits[pellet].distance)
+                    hits[pellet] = modelHits[pellet];
+            }
+        }
+
+        unsigned int pelletHits = 0;
+        for (const RayHit& hit : hits)
+            pelletHits += hit.hit();
+        std::cout << "Shotgun: " << pelletHits << " of " << hits.size() << " pellets hit" << std::endl;
     }
 }
 
-// In your render loop
-void renderScene(unsigned int shaderProgram, Model myModel) {
-    // Create transformation matrix
-    glm::mat4 model = glm::mat4(1.0f);
+// Scatter the stress scene copies: rows of targets behind a field of foliage
+void buildStressScene(const Model& target, const Model& foliage) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    for (unsigned int i = 0; i < STRESS_TARGETS; i++) {
+        ModelInstance instance(target);
+        instance.translate(glm::vec3(-50.0f + (i % 50) * 2.0f, 0.0f, -20.0f - (i / 50) * 4.0f));
+        stressScene.push_back(instance);
+    }
+    for (unsigned int i = 0; i < STRESS_FOLIAGE; i++) {
+        ModelInstance instance(foliage);
+        instance.translate(glm::vec3(-60.0f + unit(random) * 120.0f, 0.0f, 10.0f - unit(random) * 70.0f));
+        instance.rotate(unit(random) * 360.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+        stressScene.push_back(instance);
+    }
+
+    // One batch per model for the instanced path
+    stressBatches.emplace_back(new InstanceBatch(target));
+    stressBatches.emplace_back(new InstanceBatch(foliage));
+    for (const ModelInstance& instance : stressScene) {
+        for (std::unique_ptr<InstanceBatch>& batch : stressBatches) {
+            if (&batch->getModel() == &instance.getModel())
+                batch->add(instance.getModelMatrix());
+        }
+    }
+}
 
-    // Apply transformations
-    myModel.setTransform(glm::mat4(1.0f)); // Reset transform
-    myModel.translate(glm::vec3(0.0f, 0.0f, 0.0f));
-    myModel.rotate(45.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-    myModel.scale(glm::vec3(1.0f, 1.0f, 1.0f));
+// Rough size of an instance on screen, in pixels across
+float screenSize(const ModelInstance& instance, const glm::vec3& eye) {
+    const Model& model = instance.getModel();
+    const glm::mat4& matrix = instance.getModelMatrix();
+    glm::vec3 center = glm::vec3(matrix * glm::vec4((model.getBoundsMin() + model.getBoundsMax()) * 0.5f, 1.0f));
+    float scale = glm::max(glm::length(glm::vec3(matrix[0])), glm::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+    float radius = glm::length(model.getBoundsMax() - model.getBoundsMin()) * 0.5f * scale;
+    float distance = glm::max(glm::length(center - eye) - radius, 0.1f);
+    return radius / (distance * glm::tan(glm::radians(FIELD_OF_VIEW) * 0.5f)) * SCREEN_HEIGHT;
+}
 
-    // Send model matrix to shader
-    unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(myModel.getModelMatrix()));
+// Ask for the texture detail of every model at its closest instance, from
+// the largest screen sizes the instance range jobs found
+void requestTextureDetail(const std::vector<std::unordered_map<const Model*, float>>& rangePixels) {
+    std::unordered_map<const Model*, float> pixels;
+    for (const auto& range : rangePixels) {
+        for (const auto& pair : range) {
+            float& size = pixels[pair.first];
+            size = glm::max(size, pair.second);
+        }
+    }
+    for (const auto& pair : pixels)
+        pair.first->requestTextureDetail(pair.second);
+}
 
-    // Draw the model
-    myModel.Draw(shaderProgram);
+// Camera data for the FrameData block
+FrameData currentFrameData() {
+    FrameData frame;
+    frame.view = camera.GetViewMatrix();
+    frame.projection = glm::perspective(glm::radians(FIELD_OF_VIEW), 800.0f / 600.0f, 0.1f, FAR_PLANE);
+    frame.viewPos = glm::vec4(camera.Position, 1.0f);
+    return frame;
 }
 
-void setLightingUniforms(unsigned int shaderProgram) {
+// The sun never changes, so the LightData block is written once at startup
+LightData sunLight() {
     // Simulate sun position (high up and slightly angled)
     glm::vec3 lightPos(-1000.0f, 1000.0f, -250.0f); // Far away to simulate directional light
 
@@ -170,25 +320,143 @@ void setLightingUniforms(unsigned int shaderProgram) {
     glm::vec3 lightDiffuse = sunColor * glm::vec3(1.0f);  // Strong direct sunlight
     glm::vec3 lightSpecular = sunColor * glm::vec3(0.4); // Slightly reduced specular to avoid too much glare
 
-    glUniform3fv(glGetUniformLocation(shaderProgram, "light.position"), 1, glm::value_ptr(lightPos));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "light.ambient"), 1, glm::value_ptr(lightAmbient));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "light.diffuse"), 1, glm::value_ptr(lightDiffuse));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "light.specular"), 1, glm::value_ptr(lightSpecular));
+    LightData light;
+    light.position = glm::vec4(lightPos, 1.0f);
+    light.ambient = glm::vec4(lightAmbient, 0.0f);
+    light.diffuse = glm::vec4(lightDiffuse, 0.0f);
+    light.specular = glm::vec4(lightSpecular, 0.0f);
+    return light;
+}
 
-    // Material properties
-    float shininess = 40.0f; // Higher shininess for sharper highlights, like you'd see in daylight
-    glUniform1f(glGetUniformLocation(shaderProgram, "material.shininess"), shininess);
+// Offline bake: parse every model with Assimp, optimize its meshes, generate
+// their levels of detail and write its mesh cache, then compress each image it uses with its mip chain.
+// highQuality uses BC7 for color.
+int bakeAssets(bool highQuality) {
+    int failures = 0;
+    for (const char* path : modelPaths) {
+        ModelData data;
+        if (!parseModel(path, data)) {
+            std::cout << "ERROR::BAKE::FAILED: " << path << std::endl;
+            failures++;
+            continue;
+        }
+        std::vector<MeshOptimizeStats> stats = optimizeModel(data);
+        generateLods(data);
+        if (!writeMeshCache(path, data)) {
+            std::cout << "ERROR::BAKE::FAILED: " << path << std::endl;
+            failures++;
+            continue;
+        }
+        std::cout << "Baked " << meshCachePath(path) << std::endl;
+        for (size_t i = 0; i < stats.size(); i++) {
+            std::cout << "  mesh " << i << ": ACMR " << stats[i].before.acmr << " -> " << stats[i].after.acmr
+                << ", ATVR " << stats[i].before.atvr << " -> " << stats[i].after.atvr << ", triangles "
+                << data.meshes[i].indices.size() / 3;
+            for (const MeshLod& lod : data.meshes[i].lods)
+                std::cout << " -> " << lod.indices.size() / 3;
+            std::cout << std::endl;
+        }
 
-    // View position (camera position)
-    glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, glm::value_ptr(camera.Position));
+        for (ImageData& image : data.images) {
+            std::string imagePath = TextureManager::canonicalPath(data.directory, image.path);
+            decodeImageFile(imagePath, image);
+            CompressedImage compressed = compressImage(image, chooseBlockFormat(image.components, highQuality));
+            if (!writeKtx2(imagePath, compressed)) {
+                std::cout << "ERROR::BAKE::FAILED: " << imagePath << std::endl;
+                failures++;
+                continue;
+            }
+            std::cout << "Baked " << ktx2Path(imagePath) << " (" << blockFormatName(compressed.format) << ", "
+                << compressed.levels.size() << " levels)" << std::endl;
+            image.pixels.reset();
+        }
+    }
+    return failures == 0 ? 0 : 1;
 }
 
-int main() {
+int main(int argc, char** argv) {
+    // --frame-stats prints the CPU time per frame every few seconds
+    // --bake rebuilds the mesh caches and compressed textures of every model and
+    // exits, without a window; add --bc7 to compress color textures as BC7
+    // --stress adds 10k targets and plants and alternates between instanced and
+    // per-instance drawing at every frame stats report
+    // --texture-budget <MB> limits the GPU memory of streamed textures
+    // --float-vertices uploads meshes without vertex compression
+    // --no-lod draws every model at full detail
+    // --no-draw-list draws the scene one mesh at a time with its own uniforms;
+    // --no-multi-draw keeps the draw list but with one draw per mesh
+    // --no-state-cache issues every bind and depth state call, even redundant ones
+    // --profile times the frame in CPU scopes and GPU passes, shown in an overlay
+    // and the window title; --trace <path> also writes the timings as Chrome
+    // trace-event JSON at exit
+    // --workers <n> runs the per-frame jobs on n threads, the main one included;
+    // by default one per hardware thread
+    // --benchmark <script.json> flies the camera along the script's path at a
+    // fixed timestep, drawing into an offscreen framebuffer of a hidden window,
+    // and appends the frame time percentiles to a CSV (see Benchmark.h)
+    bool frameStats = false;
+    bool lod = true;
+    bool useDrawList = true, multiDraw = true;
+    bool stress = false;
+    bool bake = false, bc7 = false;
+    StreamingSettings streaming;
+    std::string tracePath, benchmarkPath;
+    unsigned int workerCount = std::thread::hardware_concurrency();
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--frame-stats") == 0)
+            frameStats = true;
+        if (std::strcmp(argv[i], "--stress") == 0)
+            stress = frameStats = true;
+        if (std::strcmp(argv[i], "--bake") == 0)
+            bake = true;
+        if (std::strcmp(argv[i], "--bc7") == 0)
+            bc7 = true;
+        if (std::strcmp(argv[i], "--float-vertices") == 0)
+            vertexCompression() = false;
+        if (std::strcmp(argv[i], "--no-lod") == 0)
+            lod = false;
+        if (std::strcmp(argv[i], "--no-draw-list") == 0)
+            useDrawList = false;
+        if (std::strcmp(argv[i], "--no-multi-draw") == 0)
+            multiDraw = false;
+        if (std::strcmp(argv[i], "--no-state-cache") == 0)
+            GLState::instance().caching = false;
+        if (std::strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+            streaming.budgetBytes = (size_t)std::atoi(argv[++i]) << 20;
+        if (std::strcmp(argv[i], "--profile") == 0)
+            Profiler::instance().enabled = true;
+        if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+            Profiler::instance().enabled = true;
+        }
+        if (std::strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc)
+            benchmarkPath = argv[++i];
+        if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            char* end = nullptr;
+            long count = std::strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || count < 1) {
+                std::cout << "ERROR::ARGUMENTS::INVALID_WORKER_COUNT: " << argv[i] << std::endl;
+                return 1;
+            }
+            workerCount = (unsigned int)std::min(count, (long)JobSystem::MAX_WORKERS);
+        }
+    }
+    if (bake)
+        return bakeAssets(bc7);
+    jobs.reset(new JobSystem(workerCount));
+
+    bool benchmark = !benchmarkPath.empty();
+    BenchmarkScript script;
+    if (benchmark && !loadBenchmarkScript(benchmarkPath, script))
+        return 1;
+
     // Initialize GLFW
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (benchmark)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 
     GLFWwindow* window = glfwCreateWindow(1350, 1080, "Target Practice", NULL, NULL);
@@ -205,9 +473,40 @@ int main() {
     }
 
     glViewport(0, 0, 1350, 1080);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    if (multiDraw && !loadMultiDrawIndirect((GLADloadproc)glfwGetProcAddress))
+        std::cout << "No multi-draw indirect, drawing the scene with one base-vertex draw per mesh" << std::endl;
+    TextureManager::instance().detectCompressedFormats();
+    // A benchmark reads its levels on the GL thread, so each run draws the
+    // same levels on the same frames
+    streaming.synchronous = benchmark;
+    TextureManager::instance().configureStreaming(streaming);
+
+    // A benchmark takes no input, waits for no display and draws offscreen
+    std::unique_ptr<OffscreenTarget> benchmarkTarget;
+    if (benchmark) {
+        glfwSwapInterval(0);
+        benchmarkTarget.reset(new OffscreenTarget(script.width, script.height));
+        if (!benchmarkTarget->complete()) {
+            std::cout << "ERROR::BENCHMARK::FRAMEBUFFER_INCOMPLETE" << std::endl;
+            benchmarkTarget.reset();
+            glfwTerminate();
+            return 1;
+        }
+
+        CameraKey start = sampleCameraPath(script.path, 0.0f);
+        camera.SetPose(start.position, start.yaw, start.pitch);
+    }
+    else {
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+    }
+
+    // Start loading the models in the background while the rest is set up
+    AssetLoader loader;
+    std::vector<unsigned int> modelIds;
+    for (const char* path : modelPaths)
+        modelIds.push_back(loader.loadModel(path));
 
     // Prepare skybox
     std::vector<std::string> skyboxFaces{
@@ -220,12 +519,14 @@ int main() {
     };
     Skybox skybox(skyboxFaces);
 
-    glEnable(GL_DEPTH_TEST);
+    GLState::instance().setEnabled(GL_DEPTH_TEST, true);
+    resetInstanceAttributes();
 
     Shader lightingShader("vertex_shader.glsl", "lighting.glsl");
     Shader rayShader("ray_vertex_shader.glsl", "ray_fragment_shader.glsl", "ray_geometry_shader.glsl"); // Include geometry shader
     Shader ObjectShader("vertex_shader.glsl", "fragment_shader.glsl");
     Shader modelShader("model_vertex.glsl", "model_fragment.glsl");
+    Shader drawListShader("model_vertex.glsl", "model_fragment.glsl", nullptr, "#define DRAW_ID\n");
 
     // After creating shader program
     GLint isLinked;
@@ -239,14 +540,37 @@ int main() {
     }
 
     // Print all active uniforms
-    GLint numUniforms;
-    glGetProgramiv(modelShader.ID, GL_ACTIVE_UNIFORMS, &numUniforms);
-    for (GLint i = 0; i < numUniforms; ++i) {
-        GLint size; GLenum type;
-        GLchar name[128];
-        glGetActiveUniform(modelShader.ID, i, sizeof(name) - 1, nullptr, &size, &type, name);
-        std::cout << "Active uniform " << i << ": " << name << std::endl;
-    }
+    modelShader.printActiveUniforms();
+
+    // Camera and light data shared by every program through uniform blocks
+    UniformBuffer<FrameData> frameData(FRAME_DATA_BINDING);
+    UniformBuffer<LightData> lightData(LIGHT_DATA_BINDING);
+    lightData.update(sunLight());
+
+    // Resolve uniform handles once so the render loop never looks up names
+    UniformHandle<glm::mat4> modelLoc = modelShader.uniform<glm::mat4>("model");
+    UniformHandle<glm::mat3> normalMatrixLoc = modelShader.uniform<glm::mat3>("normalMatrix");
+    UniformHandle<glm::vec3> objectColorLoc = ObjectShader.uniform<glm::vec3>("objectColor");
+    UniformHandle<glm::mat4> objectModelLoc = ObjectShader.uniform<glm::mat4>("model");
+    UniformHandle<float> rayThicknessLoc = rayShader.uniform<float>("thickness");
+
+    // Values that never change are set once
+    modelShader.use();
+    modelShader.set(modelShader.uniform<float>("material.shininess"), 40.0f); // Sharper highlights, like you'd see in daylight
+    drawListShader.use();
+    drawListShader.set(drawListShader.uniform<float>("material.shininess"), 40.0f);
+    ObjectShader.use();
+    ObjectShader.set(objectColorLoc, glm::vec3(0.0f, 0.0f, 1.0f));  // Blue color
+    ObjectShader.set(objectModelLoc, glm::mat4(1.0f));
+    ObjectShader.set(ObjectShader.uniform<glm::mat3>("normalMatrix"), glm::mat3(1.0f));
+    lightingShader.use();
+    lightingShader.set(lightingShader.uniform<glm::mat4>("model"), glm::mat4(1.0f));
+    lightingShader.set(lightingShader.uniform<glm::mat3>("normalMatrix"), glm::mat3(1.0f));
+    rayShader.use();
+    rayShader.set(rayThicknessLoc, 0.5f); // Adjust thickness as needed
+
+    DirectionalLight pointLight(glm::vec3(0.f, .0f, .0f), glm::vec3(0.5f, 1.0f, 1.0f), lightIntensity);
+    pointLight.bind(lightingShader, "pointLight");
 
 
     // Generate a plane at position (2.0f, 0.0f, 0.0f)
@@ -256,15 +580,41 @@ int main() {
     MeshGen cube = MeshGenerator::generateCube(2.0f, 2.0f, 2.0f, glm::vec3(-2.0f, 1.0f, 0.0f));
 
 
-    // Load 3D model
-    Model Guns("Resources/Models/Guns/scene.gltf");
-    Model Ground("Resources/Models/Ground/scene.gltf");
-    Model Plants("Resources/Models/Plants1/scene.gltf");
-    Model Targets("Resources/Models/Target/scene.gltf");
-    Model Tower("Resources/Models/Tower/scene.gltf");
-    Model Hut("Resources/Models/Hut/scene.gltf");
-    //Model Desert("Resources/Models/Desert/scene.gltf");
+    // Show the skybox while the models finish loading
+    while (!loader.done() && !glfwWindowShouldClose(window)) {
+        loader.uploadFinished();
+
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        GLState::instance().clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        frameData.update(currentFrameData());
+        skybox.Draw();
+
+        if (!benchmark)
+            glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
 
+    TextureManager::instance().report();
+
+    // Place the models in the scene. Instances share the loaded models.
+    for (unsigned int id : modelIds) {
+        const Model* asset = loader.getModel(id);
+        if (!asset)
+            continue;
+        ModelInstance instance(*asset);
+        instance.rotate(45.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+        scene.push_back(instance);
+    }
+
+    bool instancing = true;
+    if (stress) {
+        const Model* target = loader.getModel(modelIds[3]);
+        const Model* foliage = loader.getModel(modelIds[2]);
+        if (target && foliage)
+            buildStressScene(*target, *foliage);
+        else
+            std::cout << "ERROR::STRESS::MODELS_NOT_LOADED" << std::endl;
+    }
 
     
     // Aim Position
@@ -280,83 +630,323 @@ int main() {
     glGenVertexArrays(1, &rayVAO);
     glGenBuffers(1, &rayVBO);
 
-    glBindVertexArray(rayVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, rayVBO);
+    GLState::instance().bindVertexArray(rayVAO);
+    GLState::instance().bindBuffer(GL_ARRAY_BUFFER, rayVBO);
     glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(float), NULL, GL_DYNAMIC_DRAW); // Dynamic as ray vertices change
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
+    std::unique_ptr<DrawList> drawList;
+    if (useDrawList)
+        drawList.reset(new DrawList());
+    const char* perInstanceLabel = drawList ? "stress, draw list" : "stress, per instance";
+    RenderQueue renderQueue;
+
+    FrameTimer frameTimer;
+    GpuTimer scenePassTimer;
+    GLState::instance().counting = frameStats;
+    Profiler& profiler = Profiler::instance();
+    std::unique_ptr<ProfilerOverlay> profilerOverlay;
+    if (profiler.enabled)
+        profilerOverlay.reset(new ProfilerOverlay());
+    double titleTime = 0.0;
+    unsigned int benchmarkFrame = 0;
+
+    // Per-frame jobs and what they leave for the GL thread
+    TaskGraph frameTasks;
+    std::vector<CulledDraws> rangeDraws;
+    std::vector<CullStats> rangeStats, batchStats;
+    std::vector<std::unordered_map<const Model*, float>> rangePixels; // largest screen size of each model
+
+    // The camera is simulated at the last tick and drawn between it and the one before
+    FixedTimestep simulation(SIMULATION_STEP);
+    glm::vec3 simulatedPosition = camera.Position, previousPosition = camera.Position;
+    std::vector<double> benchmarkFrameMs;
+    std::chrono::steady_clock::time_point benchmarkFrameStart;
+    if (!stressScene.empty())
+        frameTimer.setLabel("stress, instanced");
+
     while (!glfwWindowShouldClose(window)) {
+        frameTimer.beginFrame();
+        profiler.beginFrame();
+        Shader::nameLookups() = 0;
+        drawCounters() = DrawCounters();
+        GLState::instance().counters = GLCallCounters();
+
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
-        processInput(window);
-        applyGravity();
+        if (benchmark) {
+            // Warm-up frames hold the first pose, then the path is played
+            // back one timestep per frame whatever the frame took
+            benchmarkFrameStart = std::chrono::steady_clock::now();
+            unsigned int pathFrame = benchmarkFrame > script.warmupFrames ? benchmarkFrame - script.warmupFrames : 0;
+            CameraKey pose = sampleCameraPath(script.path, pathFrame * script.timestep);
+            camera.SetPose(pose.position, pose.yaw, pose.pitch);
+        }
+        else {
+            ProfileScope profile("simulation");
+            camera.Position = simulatedPosition;
+            for (unsigned int ticks = simulation.advance(deltaTime); ticks > 0; ticks--) {
+                previousPosition = camera.Position;
+                {
+                    ProfileScope profile("input");
+                    processInput(window, simulation.step());
+                }
+                {
+                    ProfileScope profile("gravity");
+                    applyGravity(simulation.step());
+                }
+            }
+            simulatedPosition = camera.Position;
+            camera.Position = glm::mix(previousPosition, simulatedPosition, simulation.alpha());
+        }
 
 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+        GLState::instance().clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // One buffer write shares the camera with every program
+        FrameData frame = currentFrameData();
+        frameData.update(frame);
+        Frustum frustum(frame.projection * frame.view);
 
-        glm::mat4 model = glm::mat4(1.0f);
-        ObjectShader.use();
-        ObjectShader.setVec3("objectColor", glm::vec3(0.0f, 0.0f, 1.0f));  // Blue color
-        ObjectShader.setMat4("model", model);
-        ObjectShader.setMat4("view", view);
-        ObjectShader.setMat4("projection", projection);
 
+        // With ObjectShader
         //plane.render();
         //cube.render();
 
-
-        skybox.Draw(view, projection);
-        DirectionalLight pointLight(glm::vec3(0.f, .0f, .0f), glm::vec3(0.5f, 1.0f, 1.0f), lightIntensity);
+        pointLight.intensity = lightIntensity;
 
         // Apply lights in the render loop
         lightingShader.use();
-        pointLight.apply(lightingShader, "pointLight");
+        pointLight.apply(lightingShader);
 
+        // Everything drawn below is queued and submitted sorted by pass,
+        // program and material
+        renderQueue.begin(camera.Position, FAR_PLANE);
 
+        // The sky goes last, so early depth testing skips every pixel the
+        // scene covered instead of shading the whole window
+        renderQueue.add(RENDER_PASS_SKY, skybox.getProgram(), 1.0f, [&]() {
+            ProfileScope profile("skybox");
+            skybox.Draw();
+        });
 
         // Render ray
-        rayShader.use();
-        rayShader.setMat4("view", camera.GetViewMatrix());
-        rayShader.setMat4("projection", glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f));
-        rayShader.setFloat("thickness", 0.5f); // Adjust thickness as needed
-        glBindVertexArray(rayVAO);
-        glDrawArrays(GL_LINES, 0, 2);
-
-        modelShader.use();
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", camera.GetViewMatrix());
-        modelShader.setVec3("viewPos", camera.Position);
-
-        // Set lighting uniforms
-        modelShader.setVec3("light.position", lightPos);
-        modelShader.setVec3("light.ambient", glm::vec3(0.2f));
-        modelShader.setVec3("light.diffuse", glm::vec3(0.5f));
-        modelShader.setVec3("light.specular", glm::vec3(1.0f));
-        setLightingUniforms(modelShader.ID);
-        renderScene(modelShader.ID, Guns);
-        renderScene(modelShader.ID, Ground);
-        renderScene(modelShader.ID, Plants);
-        renderScene(modelShader.ID, Targets);
-        renderScene(modelShader.ID, Tower);
-        renderScene(modelShader.ID, Hut);
-        //renderScene(modelShader.ID, Desert);
-        
-
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        renderQueue.add(RENDER_PASS_OPAQUE, rayShader.ID, 0.0f, [&]() {
+            ProfileScope profile("ray");
+            GLState::instance().bindVertexArray(rayVAO);
+            glDrawArrays(GL_LINES, 0, 2);
+            drawCounters().vertexArrayBinds++;
+            drawCounters().drawCalls++;
+        });
+
+        if (profilerOverlay) {
+            renderQueue.add(RENDER_PASS_OVERLAY, profilerOverlay->getProgram(), 0.0f, [&]() {
+                profilerOverlay->Draw();
+            });
+        }
+
+        // Levels of detail keep their projected error under a pixel
+        LodView lodView = LodView::perspective(camera.Position, glm::radians(FIELD_OF_VIEW), SCREEN_HEIGHT);
+
+        // Levels of detail, culling and screen sizes for texture streaming run
+        // as jobs, a range of instances each with its own culled draws, joined
+        // into the draw list in order. Every instance is sized, batched or not.
+        // The batches cull alongside. Only the GL work is left to this thread.
+        CullStats cullStats;
+        bool drawStressInstances = !stressScene.empty() && !instancing;
+        bool drawBatches = !stressScene.empty() && instancing;
+        size_t instanceCount = scene.size() + stressScene.size();
+        size_t ranges = (instanceCount + INSTANCES_PER_JOB - 1) / INSTANCES_PER_JOB;
+        rangeDraws.resize(ranges);
+        rangePixels.resize(ranges);
+        rangeStats.assign(ranges, CullStats());
+        glm::vec3 eye = camera.Position;
+        batchStats.assign(stressBatches.size(), CullStats());
+        frameTasks.clear();
+        TaskGraph::TaskId culled = frameTasks.parallelFor(instanceCount, INSTANCES_PER_JOB, [&](size_t begin, size_t end) {
+            size_t range = begin / INSTANCES_PER_JOB;
+            rangeDraws[range].clear();
+            rangePixels[range].clear();
+            for (size_t i = begin; i < end; i++) {
+                ModelInstance& instance = i < scene.size() ? scene[i] : stressScene[i - scene.size()];
+                float& pixels = rangePixels[range][&instance.getModel()];
+                pixels = glm::max(pixels, screenSize(instance, eye));
+
+                // Batches pick their own levels of detail
+                if (i >= scene.size() && !drawStressInstances)
+                    continue;
+                if (lod)
+                    instance.updateLod(lodView);
+                if (drawList)
+                    rangeDraws[range].add(instance, frustum, rangeStats[range]);
+            }
+        });
+        if (drawList) {
+            frameTasks.add([&]() {
+                drawList->clear();
+                for (const CulledDraws& draws : rangeDraws)
+                    drawList->append(draws);
+            }, { culled });
+        }
+        if (drawBatches) {
+            for (size_t i = 0; i < stressBatches.size(); i++) {
+                frameTasks.add([&, i]() {
+                    stressBatches[i]->cull(frustum, batchStats[i], lod ? &lodView : nullptr);
+                });
+            }
+        }
+        {
+            ProfileScope profile("jobs");
+            jobs->run(frameTasks);
+        }
+        for (const CullStats& stats : rangeStats)
+            cullStats.add(stats);
+        if (drawBatches) {
+            for (const CullStats& stats : batchStats)
+                cullStats.add(stats);
+        }
+
+        // Stream texture levels in and out for where the camera is now
+        {
+            ProfileScope profile("streaming");
+            requestTextureDetail(rangePixels);
+            TextureManager::instance().updateStreaming();
+        }
+
+        {
+            ProfileScope profile("models");
+            if (drawList) {
+                // The whole scene in a few multi-draws
+                drawList->useMultiDraw = multiDraw;
+                renderQueue.add(RENDER_PASS_OPAQUE, drawListShader.ID, 0.0f, [&]() {
+                    drawList->Draw(drawListShader);
+                });
+            }
+            else {
+                // One packet per visible mesh
+                for (const ModelInstance& instance : scene)
+                    renderQueue.add(modelShader, instance, frustum, cullStats);
+                if (drawStressInstances) {
+                    for (const ModelInstance& instance : stressScene)
+                        renderQueue.add(modelShader, instance, frustum, cullStats);
+                }
+            }
+        }
+
+        if (drawBatches) {
+            // Batches carry their transforms per instance
+            renderQueue.add(RENDER_PASS_OPAQUE, modelShader.ID, 0.0f, [&]() {
+                modelShader.set(modelLoc, glm::mat4(1.0f));
+                modelShader.set(normalMatrixLoc, glm::mat3(1.0f));
+                for (std::unique_ptr<InstanceBatch>& batch : stressBatches)
+                    batch->Draw(modelShader);
+            });
+        }
+
+        // The profiler times each pass itself, and time queries cannot nest
+        bool timeScene = frameStats && !profiler.enabled;
+        if (timeScene)
+            scenePassTimer.begin();
+        {
+            ProfileScope profile("submit");
+            renderQueue.submit();
+        }
+        if (timeScene)
+            scenePassTimer.end();
+
+        if (profiler.enabled) {
+            profiler.counter("draw calls", drawCounters().drawCalls);
+            profiler.counter("triangles", cullStats.triangles);
+            profiler.counter("binds", drawCounters().vertexArrayBinds + drawCounters().textureBinds);
+            profiler.counter("binds avoided", drawCounters().bindsAvoided);
+
+            // No text rendering here, so the numbers go in the title twice a second
+            if (currentFrame - titleTime > 0.5) {
+                titleTime = currentFrame;
+                std::string title = "Target Practice | frame " + std::to_string(profiler.lastFrameMs()).substr(0, 5) + " ms |";
+                for (const Profiler::Section& section : profiler.cpuSections())
+                    title += std::string(" ") + section.name + " " + std::to_string(section.ms).substr(0, 5);
+                title += " | GPU";
+                for (const Profiler::Section& section : profiler.gpuSections())
+                    title += std::string(" ") + section.name + " " + std::to_string(section.ms).substr(0, 5);
+                glfwSetWindowTitle(window, title.c_str());
+            }
+        }
+
+        if (frameStats) {
+            if (timeScene)
+                frameTimer.addCount("scene GPU us", (unsigned long long)(scenePassTimer.lastMs() * 1000.0));
+            frameTimer.addCount("uniform name lookups", Shader::nameLookups());
+            frameTimer.addCount("draw calls", drawCounters().drawCalls);
+            frameTimer.addCount("state changes", drawCounters().stateChanges());
+            frameTimer.addCount("binds avoided", drawCounters().bindsAvoided);
+            frameTimer.addCount("GL calls issued", GLState::instance().counters.issued);
+            frameTimer.addCount("GL calls elided", GLState::instance().counters.elided);
+            frameTimer.addCount("meshes drawn", cullStats.drawn);
+            frameTimer.addCount("meshes culled", cullStats.culled);
+            frameTimer.addCount("triangles drawn", cullStats.triangles);
+            TextureResidency residency = TextureManager::instance().residency();
+            frameTimer.addCount("texture KB resident", residency.residentBytes / 1024);
+            frameTimer.addCount("texture KB wanted", residency.wantedBytes / 1024);
+            frameTimer.addCount("texture loads pending", residency.pendingLoads);
+            if (frameTimer.endFrame() && !stressScene.empty()) {
+                // Measure the other path over the next report
+                instancing = !instancing;
+                frameTimer.setLabel(instancing ? "stress, instanced" : perInstanceLabel);
+            }
+        }
+
+        if (benchmark) {
+            // Frame time to the end of the GPU's work, as there is no swap to wait for
+            glFinish();
+            if (benchmarkFrame >= script.warmupFrames) {
+                benchmarkFrameMs.push_back(std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - benchmarkFrameStart).count());
+            }
+            if (++benchmarkFrame == script.warmupFrames + script.frames)
+                glfwSetWindowShouldClose(window, true);
+        }
+        else {
+            ProfileScope profile("swap");
+            glfwSwapBuffers(window);
+        }
+        {
+            // Shots are traced in the mouse callbacks
+            ProfileScope profile("events");
+            glfwPollEvents();
+        }
+        profiler.endFrame();
     }
 
-    glDeleteVertexArrays(1, &rayVAO);
-    glDeleteBuffers(1, &rayVBO);
+    if (benchmark && !benchmarkFrameMs.empty()) {
+        FrameTimeSummary summary = summarizeFrameTimes(benchmarkFrameMs);
+        std::cout << "Benchmark " << benchmarkPath << ": " << summary.frames << " frames, mean " << summary.meanMs
+            << " ms, p50 " << summary.p50Ms << " ms, p95 " << summary.p95Ms << " ms, p99 " << summary.p99Ms
+            << " ms, max " << summary.maxMs << " ms" << std::endl;
+        if (writeBenchmarkCsv(script.output, benchmarkPath, summary))
+            std::cout << "Wrote " << script.output << std::endl;
+    }
+    benchmarkTarget.reset();
+
+    if (!tracePath.empty())
+        profiler.writeTrace(tracePath);
+    profiler.release();
+    profilerOverlay.reset();
+    GLState::instance().deleteVertexArrays(1, &rayVAO);
+    GLState::instance().deleteBuffers(1, &rayVBO);
+
+    // Everything holding GL objects goes before the context
+    drawList.reset();
+    stressBatches.clear();
+    stressScene.clear();
+    scene.clear();
+    loader.releaseModels();
+    GeometryArena::instance().release();
+    jobs.reset();
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,174 @@
+#include "AssetLoader.h"
+#include "MeshCache.h"
+#include <iostream>
+
+AssetLoader::AssetLoader(unsigned int workerCount) {
+    if (workerCount == 0)
+        workerCount = 1;
+    for (unsigned int i = 0; i < workerCount; i++)
+        workers.emplace_back(&AssetLoader::workerLoop, this);
+}
+
+AssetLoader::~AssetLoader() {
+    // Queued image decodes still run: their entries are shared, and anyone
+    // waiting for them would wait forever. Models not yet parsed are dropped.
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+
+    // Images another loader decodes still call back into this one
+    std::unique_lock<std::mutex> lock(finishedMutex);
+    assetsFinished.wait(lock, [this] {
+        for (const std::unique_ptr<Asset>& asset : assets) {
+            if (asset->pendingJobs != 0)
+                return false;
+        }
+        return true;
+    });
+}
+
+unsigned int AssetLoader::loadModel(const std::string& path) {
+    unsigned int id = (unsigned int)assets.size();
+    std::unique_ptr<Asset> asset(new Asset());
+    asset->id = id;
+    asset->path = path;
+    asset->requested = Clock::now();
+    asset->pendingJobs = 1;
+
+    // Jobs hold the Asset pointer, never an index into assets, which may grow
+    Asset* job = asset.get();
+    assets.push_back(std::move(asset));
+    enqueue([this, job] { parseAsset(job); });
+    return id;
+}
+
+void AssetLoader::uploadFinished() {
+    std::vector<unsigned int> ready;
+    {
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        ready.swap(finished);
+    }
+
+    for (unsigned int id : ready)
+        upload(*assets[id]);
+}
+
+bool AssetLoader::done() const {
+    for (const std::unique_ptr<Asset>& asset : assets) {
+        if (!asset->uploaded)
+            return false;
+    }
+    return true;
+}
+
+const Model* AssetLoader::getModel(unsigned int id) const {
+    return id < assets.size() ? assets[id]->model.get() : nullptr;
+}
+
+void AssetLoader::releaseModels() {
+    for (std::unique_ptr<Asset>& asset : assets)
+        asset->model.reset();
+}
+
+void AssetLoader::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        jobs.push_back(std::move(job));
+    }
+    jobReady.notify_one();
+}
+
+void AssetLoader::workerLoop() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void AssetLoader::parseAsset(Asset* asset) {
+    bool dropped;
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        dropped = stopping;
+    }
+    if (dropped) {
+        asset->failed = true;
+        jobDone(asset);
+        return;
+    }
+
+    Clock::time_point start = Clock::now();
+    asset->failed = !loadModelData(asset->path, asset->data);
+    asset->parseMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    if (!asset->failed) {
+        start = Clock::now();
+        asset->bvh.build(asset->data.meshes);
+        asset->bvhMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Fan the images out as separate jobs so large texture sets decode in parallel.
+    // Images another asset already requested are decoded by that asset; either
+    // way this asset waits for each one. The asset's job count is raised before
+    // any of them can finish.
+    if (!asset->failed) {
+        TextureManager& textureManager = TextureManager::instance();
+        asset->pendingJobs += (unsigned int)asset->data.images.size();
+        for (const ImageData& image : asset->data.images) {
+            bool decode;
+            std::shared_ptr<TextureEntry> entry = textureManager.request(asset->data.directory, image.path, decode);
+            asset->images.push_back(entry);
+            if (decode) {
+                asset->imagesDecoded++;
+                enqueue([asset, entry] {
+                    Clock::time_point start = Clock::now();
+                    TextureManager::instance().decode(*entry);
+                    asset->decodeUs += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+                });
+            }
+        }
+        for (const std::shared_ptr<TextureEntry>& entry : asset->images)
+            textureManager.whenDecoded(*entry, [this, asset] { jobDone(asset); });
+    }
+
+    jobDone(asset);
+}
+
+void AssetLoader::jobDone(Asset* asset) {
+    // Under the lock, so the destructor cannot finish while a waiter is in here
+    std::lock_guard<std::mutex> lock(finishedMutex);
+    if (--asset->pendingJobs == 0) {
+        finished.push_back(asset->id);
+        assetsFinished.notify_all();
+    }
+}
+
+void AssetLoader::upload(Asset& asset) {
+    Clock::time_point start = Clock::now();
+    if (!asset.failed)
+        asset.model.reset(new Model(asset.data, std::move(asset.bvh), asset.images));
+    double uploadMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    double totalMs = std::chrono::duration<double, std::milli>(Clock::now() - asset.requested).count();
+
+    std::cout << "Loaded " << asset.path << (asset.failed ? " (failed)" : "")
+        << ": parse " << asset.parseMs << " ms, BVH " << asset.bvhMs << " ms, decode " << asset.decodeUs / 1000.0
+        << " ms (" << asset.imagesDecoded << " of " << asset.data.images.size() << " images), upload " << uploadMs
+        << " ms, ready after " << totalMs << " ms" << std::endl;
+
+    // The CPU copies are no longer needed once the GPU has them
+    asset.data = ModelData();
+    asset.images.clear();
+    asset.uploaded = true;
+}
@@ -0,0 +1,92 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ModelData.h"
+#include "Model.h"
+#include "TextureManager.h"
+
+// Loads models in the background. Mesh loading (from the baked cache, or
+// Assimp when it is stale), BVH builds and image decoding run on a
+// pool of worker threads; the finished CPU-side data is handed back to the GL
+// thread, which uploads it in uploadFinished(). Images go through the
+// TextureManager, so one used by several models is decoded by whichever asset
+// asks first and the others wait for it.
+class AssetLoader {
+public:
+    AssetLoader(unsigned int workerCount = std::thread::hardware_concurrency());
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    // Queue a model for loading. Returns its id, in the order requested.
+    unsigned int loadModel(const std::string& path);
+
+    // GL thread: upload every model whose CPU-side work has finished
+    void uploadFinished();
+
+    // True once every requested model has been uploaded
+    bool done() const;
+
+    // The uploaded model, or null while it is still loading or if it failed
+    const Model* getModel(unsigned int id) const;
+
+    // GL thread: delete the uploaded models while the context is still current
+    void releaseModels();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Asset {
+        unsigned int id;
+        std::string path;
+        ModelData data;
+        BVH bvh;
+        std::vector<std::shared_ptr<TextureEntry>> images; // parallel to data.images
+        unsigned int imagesDecoded = 0; // images this asset decoded itself
+        std::unique_ptr<Model> model;
+        bool failed = false;
+        bool uploaded = false;
+
+        // Parse job plus one wait per image
+        std::atomic<unsigned int> pendingJobs{ 0 };
+
+        // Timings in milliseconds; decodeUs sums this asset's image jobs
+        Clock::time_point requested;
+        double parseMs = 0.0; // mesh cache read or Assimp parse
+        double bvhMs = 0.0;
+        std::atomic<long long> decodeUs{ 0 };
+    };
+
+    std::vector<std::unique_ptr<Asset>> assets;
+
+    // Worker pool
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    bool stopping = false;
+
+    // Ids of assets whose CPU work is finished, waiting for upload
+    std::vector<unsigned int> finished;
+    std::mutex finishedMutex;
+    std::condition_variable assetsFinished; // an asset's last job is done
+
+    void enqueue(std::function<void()> job);
+    void workerLoop();
+    void parseAsset(Asset* asset);
+    void jobDone(Asset* asset);
+    void upload(Asset& asset);
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include "BVH.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+
+const int BIN_COUNT = 16;
+const unsigned int MAX_LEAF_SIZE = 8;
+// Cost of visiting a node relative to one triangle test
+const float TRAVERSAL_COST = 1.0f;
+
+struct Bounds {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void grow(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void grow(const Bounds& b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+
+    float area() const {
+        glm::vec3 e = max - min;
+        if (e.x < 0.0f)
+            return 0.0f;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+};
+
+struct BuildTriangle {
+    Bounds bounds;
+    glm::vec3 centroid;
+};
+
+// Slab test; returns the entry distance, or infinity on a miss or when the box
+// is farther than maxDistance
+inline float intersectBounds(const glm::vec3& origin, const glm::vec3& invDir, const BVH::Node& node, float maxDistance) {
+    glm::vec3 t0 = (node.boundsMin - origin) * invDir;
+    glm::vec3 t1 = (node.boundsMax - origin) * invDir;
+    glm::vec3 tSmall = glm::min(t0, t1);
+    glm::vec3 tLarge = glm::max(t0, t1);
+    float tNear = std::max(std::max(tSmall.x, tSmall.y), std::max(tSmall.z, 0.0f));
+    float tFar = std::min(std::min(tLarge.x, tLarge.y), std::min(tLarge.z, maxDistance));
+    return tNear <= tFar ? tNear : std::numeric_limits<float>::infinity();
+}
+
+}
+
+void BVH::build(const std::vector<MeshData>& meshes) {
+    nodes.clear();
+    triangles.clear();
+
+    std::vector<Triangle> source;
+    std::vector<BuildTriangle> build;
+    for (unsigned int m = 0; m < meshes.size(); m++) {
+        const MeshData& mesh = meshes[m];
+        for (unsigned int i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const glm::vec3& a = mesh.vertices[mesh.indices[i]].Position;
+            const glm::vec3& b = mesh.vertices[mesh.indices[i + 1]].Position;
+            const glm::vec3& c = mesh.vertices[mesh.indices[i + 2]].Position;
+            source.push_back({ a, b - a, c - a, m, i / 3 });
+
+            BuildTriangle t;
+            t.bounds.grow(a);
+            t.bounds.grow(b);
+            t.bounds.grow(c);
+            t.centroid = (a + b + c) / 3.0f;
+            build.push_back(t);
+        }
+    }
+    if (source.empty())
+        return;
+
+    std::vector<unsigned int> order(source.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    nodes.reserve(source.size() * 2);
+    nodes.push_back({ glm::vec3(0.0f), 0, glm::vec3(0.0f), (unsigned int)source.size() });
+
+    // Nodes to split and their depth
+    std::vector<std::pair<unsigned int, unsigned int>> stack;
+    stack.push_back(std::make_pair(0u, 0u));
+    while (!stack.empty()) {
+        unsigned int nodeIndex = stack.back().first;
+        unsigned int depth = stack.back().second;
+        stack.pop_back();
+        unsigned int first = nodes[nodeIndex].leftFirst;
+        unsigned int count = nodes[nodeIndex].count;
+
+        Bounds bounds, centroidBounds;
+        for (unsigned int i = first; i < first + count; i++) {
+            bounds.grow(build[order[i]].bounds);
+            centroidBounds.grow(build[order[i]].centroid);
+        }
+        nodes[nodeIndex].boundsMin = bounds.min;
+        nodes[nodeIndex].boundsMax = bounds.max;
+        if (count <= 2 || depth >= MAX_DEPTH)
+            continue;
+
+        // Find the cheapest split plane over BIN_COUNT bins per axis
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        float bestSplit = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            float lo = centroidBounds.min[axis], hi = centroidBounds.max[axis];
+            if (hi <= lo)
+                continue;
+
+            Bounds binBounds[BIN_COUNT];
+            unsigned int binCount[BIN_COUNT] = {};
+            float scale = BIN_COUNT / (hi - lo);
+            if (!std::isfinite(scale))
+                continue; // centroids too close together to bin
+            for (unsigned int i = first; i < first + count; i++) {
+                const BuildTriangle& t = build[order[i]];
+                int bin = std::min(BIN_COUNT - 1, (int)((t.centroid[axis] - lo) * scale));
+                binCount[bin]++;
+                binBounds[bin].grow(t.bounds);
+            }
+
+            // Sweep from both sides to get the cost of each of the BIN_COUNT - 1 planes
+            float leftArea[BIN_COUNT - 1], rightArea[BIN_COUNT - 1];
+            unsigned int leftCount[BIN_COUNT - 1], rightCount[BIN_COUNT - 1];
+            Bounds leftBox, rightBox;
+            unsigned int leftSum = 0, rightSum = 0;
+            for (int i = 0; i < BIN_COUNT - 1; i++) {
+                leftSum += binCount[i];
+                leftCount[i] = leftSum;
+                leftBox.grow(binBounds[i]);
+                leftArea[i] = leftBox.area();
+                rightSum += binCount[BIN_COUNT - 1 - i];
+                rightCount[BIN_COUNT - 2 - i] = rightSum;
+                rightBox.grow(binBounds[BIN_COUNT - 1 - i]);
+                rightArea[BIN_COUNT - 2 - i] = rightBox.area();
+            }
+            for (int i = 0; i < BIN_COUNT - 1; i++) {
+                if (leftCount[i] == 0 || rightCount[i] == 0)
+                    continue;
+                float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = lo + (i + 1) / scale;
+                }
+            }
+        }
+
+        // Keep a leaf when splitting does not pay off
+        float leafCost = count * bounds.area();
+        float splitCost = TRAVERSAL_COST * bounds.area() + bestCost;
+        if (bestAxis == -1 || (splitCost >= leafCost && count <= MAX_LEAF_SIZE))
+            continue;
+
+        unsigned int* middle = std::partition(order.data() + first, order.data() + first + count,
+            [&](unsigned int t) { return build[t].centroid[bestAxis] < bestSplit; });
+        unsigned int leftCount = (unsigned int)(middle - (order.data() + first));
+        if (leftCount == 0 || leftCount == count)
+            continue;
+
+        unsigned int left = (unsigned int)nodes.size();
+        nodes.push_back({ glm::vec3(0.0f), first, glm::vec3(0.0f), leftCount });
+        nodes.push_back({ glm::vec3(0.0f), first + leftCount, glm::vec3(0.0f), count - leftCount });
+        nodes[nodeIndex].leftFirst = left;
+        nodes[nodeIndex].count = 0;
+        stack.push_back(std::make_pair(left + 1, depth + 1));
+        stack.push_back(std::make_pair(left, depth + 1));
+    }
+
+    triangles.reserve(source.size());
+    for (unsigned int index : order)
+        triangles.push_back(source[index]);
+    nodes.shrink_to_fit();
+}
+
+bool BVH::intersect(const Ray& ray, RayHit& hit) const {
+    if (nodes.empty())
+        return false;
+
+    glm::vec3 invDir = 1.0f / ray.direction;
+    bool found = false;
+
+    // Interior nodes are at most MAX_DEPTH - 1 deep, one push each on the way down
+    const Node* stack[MAX_DEPTH];
+    unsigned int stackSize = 0;
+    const Node* node = &nodes[0];
+    if (intersectBounds(ray.origin, invDir, *node, hit.distance) == std::numeric_limits<float>::infinity())
+        return false;
+
+    for (;;) {
+        if (node->isLeaf()) {
+            for (unsigned int i = node->leftFirst; i < node->leftFirst + node->count; i++) {
+                float u, v;
+                float t = intersectTriangle(ray, triangles[i], u, v);
+                if (t > 0.0f && t < hit.distance) {
+                    hit.distance = t;
+                    hit.mesh = triangles[i].mesh;
+                    hit.triangle = triangles[i].index;
+                    hit.u = u;
+                    hit.v = v;
+                    found = true;
+                }
+            }
+            if (stackSize == 0)
+                break;
+            node = stack[--stackSize];
+            continue;
+        }
+
+        // Visit the nearer child first and push the farther one
+        const Node* near = &nodes[node->leftFirst];
+        const Node* far = &nodes[node->leftFirst + 1];
+        float nearT = intersectBounds(ray.origin, invDir, *near, hit.distance);
+        float farT = intersectBounds(ray.origin, invDir, *far, hit.distance);
+        if (farT < nearT) {
+            std::swap(near, far);
+            std::swap(nearT, farT);
+        }
+
+        if (nearT == std::numeric_limits<float>::infinity()) {
+            if (stackSize == 0)
+                break;
+            node = stack[--stackSize];
+        }
+        else {
+            node = near;
+            if (farT != std::numeric_limits<float>::infinity()) {
+                assert(stackSize < MAX_DEPTH);
+                stack[stackSize++] = far;
+            }
+        }
+    }
+
+    return found;
+}
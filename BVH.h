@@ -0,0 +1,102 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+#include <limits>
+#include <vector>
+#include "ModelData.h"
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction; // need not be normalized; distances are in units of its length
+};
+
+// Closest hit found so far. Start with distance = infinity (or a maximum range).
+struct RayHit {
+    float distance = std::numeric_limits<float>::infinity();
+    unsigned int mesh = 0;     // index of the mesh in its model
+    unsigned int triangle = 0; // index of the triangle in that mesh
+    float u = 0.0f, v = 0.0f;  // barycentric weights of the triangle's 2nd and 3rd vertex
+
+    bool hit() const {
+        return distance != std::numeric_limits<float>::infinity();
+    }
+};
+
+// Instruction set used by BVH::intersectPackets. Only the paths compiled into
+// the build are available; the scalar one always is.
+enum class SimdPath {
+    Scalar,
+    SSE,
+    AVX2
+};
+
+bool simdPathAvailable(SimdPath path);
+SimdPath bestSimdPath();
+const char* simdPathName(SimdPath path);
+
+// Bounding volume hierarchy over the triangles of a model, in model space.
+// Built with binned SAH; needs no GL context.
+class BVH {
+public:
+    struct Node {
+        glm::vec3 boundsMin;
+        unsigned int leftFirst;  // first child for interior nodes, first triangle for leaves
+        glm::vec3 boundsMax;
+        unsigned int count;      // triangle count of a leaf, 0 for interior nodes
+
+        bool isLeaf() const { return count > 0; }
+    };
+
+    // Triangle stored for intersection as a vertex and two edges
+    struct Triangle {
+        glm::vec3 v0, e1, e2;
+        unsigned int mesh;
+        unsigned int index;
+    };
+
+    // Nodes this deep are never split, so a traversal stack holding one node
+    // per level never overflows whatever the triangles look like
+    static const unsigned int MAX_DEPTH = 64;
+
+    void build(const std::vector<MeshData>& meshes);
+
+    // Update hit if the ray hits a triangle closer than hit.distance
+    bool intersect(const Ray& ray, RayHit& hit) const;
+
+    // Trace count rays in packets of packetSize (4, 8 or 16) that share one
+    // traversal, testing nodes and triangles against all rays of a packet at
+    // once. Best for coherent rays such as the pellets of one shot. Each hits[i]
+    // is updated like intersect() would.
+    void intersectPackets(const Ray* rays, RayHit* hits, size_t count, unsigned int packetSize,
+        SimdPath path = bestSimdPath()) const;
+
+    bool empty() const { return nodes.empty(); }
+    const std::vector<Node>& getNodes() const { return nodes; }
+    const std::vector<Triangle>& getTriangles() const { return triangles; }
+
+private:
+    std::vector<Node> nodes;
+    std::vector<Triangle> triangles; // in leaf order
+};
+
+// Ray/triangle test (Moller-Trumbore); returns the distance or a negative value on a miss
+inline float intersectTriangle(const Ray& ray, const BVH::Triangle& tri, float& u, float& v) {
+    const float epsilon = 1e-8f;
+    glm::vec3 p = glm::cross(ray.direction, tri.e2);
+    float det = glm::dot(tri.e1, p);
+    if (det > -epsilon && det < epsilon)
+        return -1.0f;
+    float invDet = 1.0f / det;
+    glm::vec3 s = ray.origin - tri.v0;
+    u = glm::dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f)
+        return -1.0f;
+    glm::vec3 q = glm::cross(s, tri.e1);
+    v = glm::dot(ray.direction, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f)
+        return -1.0f;
+    return glm::dot(tri.e2, q) * invDet;
+}
+
+#endif
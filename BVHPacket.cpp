@@ -0,0 +1,354 @@
+// Packet traversal for BVH::intersectPackets. The traversal is written once
+// against a small vector interface and instantiated for AVX2 (8 lanes), SSE
+// (4 lanes) and plain floats (1 lane). A packet of 4, 8 or 16 rays is held as
+// K vectors of V::width lanes.
+
+#include "BVH.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_HAS_SSE 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define BVH_HAS_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+struct ScalarLanes {
+    typedef float T;
+    typedef bool Mask;
+    static const int width = 1;
+
+    static T set1(float f) { return f; }
+    static T load(const float* p) { return *p; }
+    static void store(float* p, T v) { *p = v; }
+    static T add(T a, T b) { return a + b; }
+    static T sub(T a, T b) { return a - b; }
+    static T mul(T a, T b) { return a * b; }
+    static T div(T a, T b) { return a / b; }
+    static T min(T a, T b) { return a < b ? a : b; }
+    static T max(T a, T b) { return a > b ? a : b; }
+    static Mask lt(T a, T b) { return a < b; }
+    static Mask le(T a, T b) { return a <= b; }
+    static Mask both(Mask a, Mask b) { return a && b; }
+    static Mask none() { return false; }
+    static Mask either(Mask a, Mask b) { return a || b; }
+    static bool any(Mask m) { return m; }
+    static T select(Mask m, T a, T b) { return m ? a : b; }
+    // Triangle slots travel as float bit patterns so they can use select()
+    static T fromIndex(int i) { float f; std::memcpy(&f, &i, sizeof(f)); return f; }
+};
+
+#ifdef BVH_HAS_SSE
+struct SseLanes {
+    typedef __m128 T;
+    typedef __m128 Mask;
+    static const int width = 4;
+
+    static T set1(float f) { return _mm_set1_ps(f); }
+    static T load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, T v) { _mm_storeu_ps(p, v); }
+    static T add(T a, T b) { return _mm_add_ps(a, b); }
+    static T sub(T a, T b) { return _mm_sub_ps(a, b); }
+    static T mul(T a, T b) { return _mm_mul_ps(a, b); }
+    static T div(T a, T b) { return _mm_div_ps(a, b); }
+    static T min(T a, T b) { return _mm_min_ps(a, b); }
+    static T max(T a, T b) { return _mm_max_ps(a, b); }
+    static Mask lt(T a, T b) { return _mm_cmplt_ps(a, b); }
+    static Mask le(T a, T b) { return _mm_cmple_ps(a, b); }
+    static Mask both(Mask a, Mask b) { return _mm_and_ps(a, b); }
+    static Mask none() { return _mm_setzero_ps(); }
+    static Mask either(Mask a, Mask b) { return _mm_or_ps(a, b); }
+    static bool any(Mask m) { return _mm_movemask_ps(m) != 0; }
+    static T select(Mask m, T a, T b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static T fromIndex(int i) { return _mm_castsi128_ps(_mm_set1_epi32(i)); }
+};
+#endif
+
+#ifdef BVH_HAS_AVX2
+struct AvxLanes {
+    typedef __m256 T;
+    typedef __m256 Mask;
+    static const int width = 8;
+
+    static T set1(float f) { return _mm256_set1_ps(f); }
+    static T load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, T v) { _mm256_storeu_ps(p, v); }
+    static T add(T a, T b) { return _mm256_add_ps(a, b); }
+    static T sub(T a, T b) { return _mm256_sub_ps(a, b); }
+    static T mul(T a, T b) { return _mm256_mul_ps(a, b); }
+    static T div(T a, T b) { return _mm256_div_ps(a, b); }
+    static T min(T a, T b) { return _mm256_min_ps(a, b); }
+    static T max(T a, T b) { return _mm256_max_ps(a, b); }
+    static Mask lt(T a, T b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Mask le(T a, T b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static Mask none() { return _mm256_setzero_ps(); }
+    static Mask either(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+    static bool any(Mask m) { return _mm256_movemask_ps(m) != 0; }
+    static T select(Mask m, T a, T b) { return _mm256_blendv_ps(b, a, m); }
+    static T fromIndex(int i) { return _mm256_castsi256_ps(_mm256_set1_epi32(i)); }
+};
+#endif
+
+const float INF = std::numeric_limits<float>::infinity();
+
+// Structure-of-arrays copy of up to 16 rays
+struct PacketData {
+    float ox[16], oy[16], oz[16];
+    float dx[16], dy[16], dz[16];
+    float ix[16], iy[16], iz[16];
+    float tMax[16], u[16], v[16], slot[16];
+};
+
+template <typename V, int K>
+class PacketTracer {
+public:
+    static const int SIZE = V::width * K;
+
+    PacketTracer(const std::vector<BVH::Node>& nodes, const std::vector<BVH::Triangle>& triangles)
+        : nodes(nodes), triangles(triangles) {}
+
+    void trace(const Ray* rays, RayHit* hits, unsigned int count) {
+        // Lanes past count repeat the first ray with an empty range, so they never hit
+        PacketData p;
+        for (int i = 0; i < SIZE; i++) {
+            const Ray& ray = rays[i < (int)count ? i : 0];
+            p.ox[i] = ray.origin.x; p.oy[i] = ray.origin.y; p.oz[i] = ray.origin.z;
+            p.dx[i] = ray.direction.x; p.dy[i] = ray.direction.y; p.dz[i] = ray.direction.z;
+            p.ix[i] = 1.0f / ray.direction.x; p.iy[i] = 1.0f / ray.direction.y; p.iz[i] = 1.0f / ray.direction.z;
+            p.tMax[i] = i < (int)count ? hits[i].distance : -1.0f;
+            p.u[i] = p.v[i] = 0.0f;
+            int none = -1;
+            std::memcpy(&p.slot[i], &none, sizeof(float));
+        }
+
+        for (int k = 0; k < K; k++) {
+            ox[k] = V::load(p.ox + k * V::width); oy[k] = V::load(p.oy + k * V::width); oz[k] = V::load(p.oz + k * V::width);
+            dx[k] = V::load(p.dx + k * V::width); dy[k] = V::load(p.dy + k * V::width); dz[k] = V::load(p.dz + k * V::width);
+            ix[k] = V::load(p.ix + k * V::width); iy[k] = V::load(p.iy + k * V::width); iz[k] = V::load(p.iz + k * V::width);
+            tMax[k] = V::load(p.tMax + k * V::width);
+            u[k] = V::set1(0.0f); v[k] = V::set1(0.0f);
+            slot[k] = V::load(p.slot + k * V::width);
+        }
+
+        traverse();
+
+        for (int k = 0; k < K; k++) {
+            V::store(p.tMax + k * V::width, tMax[k]);
+            V::store(p.u + k * V::width, u[k]);
+            V::store(p.v + k * V::width, v[k]);
+            V::store(p.slot + k * V::width, slot[k]);
+        }
+        for (unsigned int i = 0; i < count; i++) {
+            int s;
+            std::memcpy(&s, &p.slot[i], sizeof(int));
+            if (s < 0)
+                continue;
+            hits[i].distance = p.tMax[i];
+            hits[i].mesh = triangles[s].mesh;
+            hits[i].triangle = triangles[s].index;
+            hits[i].u = p.u[i];
+            hits[i].v = p.v[i];
+        }
+    }
+
+private:
+    const std::vector<BVH::Node>& nodes;
+    const std::vector<BVH::Triangle>& triangles;
+    typename V::T ox[K], oy[K], oz[K], dx[K], dy[K], dz[K], ix[K], iy[K], iz[K];
+    typename V::T tMax[K], u[K], v[K], slot[K];
+
+    // Entry distance of the nearest ray that hits the node, or infinity if none does
+    float testNode(const BVH::Node& node) const {
+        typename V::T nearest = V::set1(INF);
+        typename V::Mask anyHit = V::none();
+        for (int k = 0; k < K; k++) {
+            typename V::T t0x = V::mul(V::sub(V::set1(node.boundsMin.x), ox[k]), ix[k]);
+            typename V::T t1x = V::mul(V::sub(V::set1(node.boundsMax.x), ox[k]), ix[k]);
+            typename V::T t0y = V::mul(V::sub(V::set1(node.boundsMin.y), oy[k]), iy[k]);
+            typename V::T t1y = V::mul(V::sub(V::set1(node.boundsMax.y), oy[k]), iy[k]);
+            typename V::T t0z = V::mul(V::sub(V::set1(node.boundsMin.z), oz[k]), iz[k]);
+            typename V::T t1z = V::mul(V::sub(V::set1(node.boundsMax.z), oz[k]), iz[k]);
+            typename V::T tNear = V::max(V::max(V::min(t0x, t1x), V::min(t0y, t1y)), V::max(V::min(t0z, t1z), V::set1(0.0f)));
+            typename V::T tFar = V::min(V::min(V::max(t0x, t1x), V::max(t0y, t1y)), V::min(V::max(t0z, t1z), tMax[k]));
+            typename V::Mask hit = V::le(tNear, tFar);
+            anyHit = V::either(anyHit, hit);
+            nearest = V::min(nearest, V::select(hit, tNear, V::set1(INF)));
+        }
+        if (!V::any(anyHit))
+            return INF;
+
+        float lanes[V::width];
+        V::store(lanes, nearest);
+        float result = lanes[0];
+        for (int i = 1; i < V::width; i++)
+            result = std::min(result, lanes[i]);
+        return result;
+    }
+
+    void testTriangle(unsigned int index) {
+        const BVH::Triangle& tri = triangles[index];
+        typename V::T e1x = V::set1(tri.e1.x), e1y = V::set1(tri.e1.y), e1z = V::set1(tri.e1.z);
+        typename V::T e2x = V::set1(tri.e2.x), e2y = V::set1(tri.e2.y), e2z = V::set1(tri.e2.z);
+        typename V::T zero = V::set1(0.0f), one = V::set1(1.0f);
+        typename V::T id = V::fromIndex((int)index);
+
+        for (int k = 0; k < K; k++) {
+            // Moller-Trumbore across the lanes; see intersectTriangle()
+            typename V::T px = V::sub(V::mul(dy[k], e2z), V::mul(dz[k], e2y));
+            typename V::T py = V::sub(V::mul(dz[k], e2x), V::mul(dx[k], e2z));
+            typename V::T pz = V::sub(V::mul(dx[k], e2y), V::mul(dy[k], e2x));
+            typename V::T det = V::add(V::add(V::mul(e1x, px), V::mul(e1y, py)), V::mul(e1z, pz));
+            typename V::Mask valid = V::either(V::lt(det, V::set1(-1e-8f)), V::lt(V::set1(1e-8f), det));
+            typename V::T invDet = V::select(valid, V::div(one, det), zero);
+
+            typename V::T sx = V::sub(ox[k], V::set1(tri.v0.x));
+            typename V::T sy = V::sub(oy[k], V::set1(tri.v0.y));
+            typename V::T sz = V::sub(oz[k], V::set1(tri.v0.z));
+            typename V::T hu = V::mul(V::add(V::add(V::mul(sx, px), V::mul(sy, py)), V::mul(sz, pz)), invDet);
+            typename V::T qx = V::sub(V::mul(sy, e1z), V::mul(sz, e1y));
+            typename V::T qy = V::sub(V::mul(sz, e1x), V::mul(sx, e1z));
+            typename V::T qz = V::sub(V::mul(sx, e1y), V::mul(sy, e1x));
+            typename V::T hv = V::mul(V::add(V::add(V::mul(dx[k], qx), V::mul(dy[k], qy)), V::mul(dz[k], qz)), invDet);
+            typename V::T t = V::mul(V::add(V::add(V::mul(e2x, qx), V::mul(e2y, qy)), V::mul(e2z, qz)), invDet);
+
+            typename V::Mask hit = V::both(valid, V::le(zero, hu));
+            hit = V::both(hit, V::le(zero, hv));
+            hit = V::both(hit, V::le(V::add(hu, hv), one));
+            hit = V::both(hit, V::lt(zero, t));
+            hit = V::both(hit, V::lt(t, tMax[k]));
+            if (!V::any(hit))
+                continue;
+
+            tMax[k] = V::select(hit, t, tMax[k]);
+            u[k] = V::select(hit, hu, u[k]);
+            v[k] = V::select(hit, hv, v[k]);
+            slot[k] = V::select(hit, id, slot[k]);
+        }
+    }
+
+    void traverse() {
+        // The build caps the depth, see BVH::MAX_DEPTH
+        const BVH::Node* stack[BVH::MAX_DEPTH];
+        unsigned int stackSize = 0;
+        const BVH::Node* node = &nodes[0];
+        if (testNode(*node) == INF)
+            return;
+
+        for (;;) {
+            if (node->isLeaf()) {
+                for (unsigned int i = node->leftFirst; i < node->leftFirst + node->count; i++)
+                    testTriangle(i);
+                if (stackSize == 0)
+                    return;
+                node = stack[--stackSize];
+                continue;
+            }
+
+            const BVH::Node* near = &nodes[node->leftFirst];
+            const BVH::Node* far = &nodes[node->leftFirst + 1];
+            float nearT = testNode(*near);
+            float farT = testNode(*far);
+            if (farT < nearT) {
+                std::swap(near, far);
+                std::swap(nearT, farT);
+            }
+
+            if (nearT == INF) {
+                if (stackSize == 0)
+                    return;
+                node = stack[--stackSize];
+            }
+            else {
+                node = near;
+                if (farT != INF) {
+                    assert(stackSize < BVH::MAX_DEPTH);
+                    stack[stackSize++] = far;
+                }
+            }
+        }
+    }
+};
+
+template <typename V, int K>
+void tracePackets(const std::vector<BVH::Node>& nodes, const std::vector<BVH::Triangle>& triangles,
+    const Ray* rays, RayHit* hits, size_t count) {
+    const unsigned int size = PacketTracer<V, K>::SIZE;
+    for (size_t first = 0; first < count; first += size) {
+        PacketTracer<V, K> tracer(nodes, triangles);
+        tracer.trace(rays + first, hits + first, (unsigned int)std::min<size_t>(size, count - first));
+    }
+}
+
+// Dispatch a packet size onto K vectors of the lane type
+template <typename V>
+void tracePacketsOf(unsigned int packetSize, const std::vector<BVH::Node>& nodes, const std::vector<BVH::Triangle>& triangles,
+    const Ray* rays, RayHit* hits, size_t count) {
+    if (packetSize <= 4)
+        tracePackets<V, (4 + V::width - 1) / V::width>(nodes, triangles, rays, hits, count);
+    else if (packetSize <= 8)
+        tracePackets<V, 8 / V::width>(nodes, triangles, rays, hits, count);
+    else
+        tracePackets<V, 16 / V::width>(nodes, triangles, rays, hits, count);
+}
+
+}
+
+bool simdPathAvailable(SimdPath path) {
+    switch (path) {
+#ifdef BVH_HAS_SSE
+    case SimdPath::SSE: return true;
+#endif
+#ifdef BVH_HAS_AVX2
+    case SimdPath::AVX2: return true;
+#endif
+    case SimdPath::Scalar: return true;
+    default: return false;
+    }
+}
+
+SimdPath bestSimdPath() {
+#if defined(BVH_HAS_AVX2)
+    return SimdPath::AVX2;
+#elif defined(BVH_HAS_SSE)
+    return SimdPath::SSE;
+#else
+    return SimdPath::Scalar;
+#endif
+}
+
+const char* simdPathName(SimdPath path) {
+    switch (path) {
+    case SimdPath::SSE: return "SSE";
+    case SimdPath::AVX2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+void BVH::intersectPackets(const Ray* rays, RayHit* hits, size_t count, unsigned int packetSize, SimdPath path) const {
+    if (nodes.empty() || count == 0)
+        return;
+
+#ifdef BVH_HAS_AVX2
+    // An 8-lane register cannot hold a 4-ray packet; use SSE for those
+    if (path == SimdPath::AVX2 && packetSize > 4) {
+        tracePacketsOf<AvxLanes>(packetSize, nodes, triangles, rays, hits, count);
+        return;
+    }
+    if (path == SimdPath::AVX2)
+        path = SimdPath::SSE;
+#endif
+#ifdef BVH_HAS_SSE
+    if (path == SimdPath::SSE) {
+        tracePacketsOf<SseLanes>(packetSize, nodes, triangles, rays, hits, count);
+        return;
+    }
+#endif
+    tracePacketsOf<ScalarLanes>(packetSize, nodes, triangles, rays, hits, count);
+}
@@ -0,0 +1,243 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// Just enough JSON for the scripts: objects, arrays, numbers and strings
+struct JsonValue {
+    enum Type { NONE, NUMBER, STRING, ARRAY, OBJECT } type = NONE;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::string> keys; // of OBJECT, one per item
+
+    const JsonValue* find(const char* key) const {
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (keys[i] == key)
+                return &items[i];
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : text(text) {}
+
+    bool parse(JsonValue& value) {
+        return parseValue(value) && (skipSpace(), at == text.size());
+    }
+
+private:
+    const std::string& text;
+    size_t at = 0;
+
+    void skipSpace() {
+        while (at < text.size() && std::isspace((unsigned char)text[at]))
+            at++;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (at < text.size() && text[at] == c) {
+            at++;
+            return true;
+        }
+        return false;
+    }
+
+    bool parseString(std::string& out) {
+        if (!consume('"'))
+            return false;
+        out.clear();
+        while (at < text.size() && text[at] != '"') {
+            if (text[at] == '\\' && at + 1 < text.size())
+                at++;
+            out += text[at++];
+        }
+        return consume('"');
+    }
+
+    bool parseValue(JsonValue& value) {
+        skipSpace();
+        if (at >= text.size())
+            return false;
+        char c = text[at];
+        if (c == '{') {
+            value.type = JsonValue::OBJECT;
+            at++;
+            if (consume('}'))
+                return true;
+            do {
+                std::string key;
+                value.items.emplace_back();
+                if (!parseString(key) || !consume(':') || !parseValue(value.items.back()))
+                    return false;
+                value.keys.push_back(key);
+            } while (consume(','));
+            return consume('}');
+        }
+        if (c == '[') {
+            value.type = JsonValue::ARRAY;
+            at++;
+            if (consume(']'))
+                return true;
+            do {
+                value.items.emplace_back();
+                if (!parseValue(value.items.back()))
+                    return false;
+            } while (consume(','));
+            return consume(']');
+        }
+        if (c == '"') {
+            value.type = JsonValue::STRING;
+            return parseString(value.string);
+        }
+        char* end = nullptr;
+        value.number = std::strtod(text.c_str() + at, &end);
+        if (end == text.c_str() + at)
+            return false;
+        value.type = JsonValue::NUMBER;
+        at = end - text.c_str();
+        return true;
+    }
+};
+
+void readNumber(const JsonValue& object, const char* key, float& out) {
+    const JsonValue* value = object.find(key);
+    if (value && value->type == JsonValue::NUMBER)
+        out = (float)value->number;
+}
+
+void readNumber(const JsonValue& object, const char* key, unsigned int& out) {
+    const JsonValue* value = object.find(key);
+    if (value && value->type == JsonValue::NUMBER && value->number >= 0.0)
+        out = (unsigned int)value->number;
+}
+
+// Nearest-rank percentile of sorted values
+double percentile(const std::vector<double>& sorted, double p) {
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+}
+
+bool loadBenchmarkScript(const std::string& path, BenchmarkScript& script) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "ERROR::BENCHMARK::SCRIPT_NOT_FOUND: " << path << std::endl;
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+
+    JsonValue root;
+    JsonParser parser(text);
+    if (!parser.parse(root) || root.type != JsonValue::OBJECT) {
+        std::cout << "ERROR::BENCHMARK::SCRIPT_NOT_JSON: " << path << std::endl;
+        return false;
+    }
+
+    readNumber(root, "frames", script.frames);
+    readNumber(root, "warmup", script.warmupFrames);
+    readNumber(root, "timestep", script.timestep);
+    readNumber(root, "width", script.width);
+    readNumber(root, "height", script.height);
+    const JsonValue* output = root.find("output");
+    if (output && output->type == JsonValue::STRING)
+        script.output = output->string;
+
+    script.path.clear();
+    const JsonValue* keys = root.find("path");
+    if (keys && keys->type == JsonValue::ARRAY) {
+        for (const JsonValue& item : keys->items) {
+            if (item.type != JsonValue::OBJECT)
+                continue;
+            CameraKey key;
+            readNumber(item, "time", key.time);
+            readNumber(item, "yaw", key.yaw);
+            readNumber(item, "pitch", key.pitch);
+            const JsonValue* position = item.find("position");
+            if (position && position->type == JsonValue::ARRAY && position->items.size() == 3) {
+                for (int i = 0; i < 3; i++)
+                    key.position[i] = (float)position->items[i].number;
+            }
+            script.path.push_back(key);
+        }
+    }
+
+    if (script.path.empty() || script.frames == 0 || script.timestep <= 0.0f || script.width == 0 || script.height == 0) {
+        std::cout << "ERROR::BENCHMARK::SCRIPT_INVALID: " << path
+            << " needs a path, frames, a positive timestep and a size" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+CameraKey sampleCameraPath(const std::vector<CameraKey>& path, float time) {
+    if (time <= path.front().time)
+        return path.front();
+    if (time >= path.back().time)
+        return path.back();
+
+    size_t i = 1;
+    while (path[i].time < time)
+        i++;
+    const CameraKey& p0 = path[i > 1 ? i - 2 : 0];
+    const CameraKey& p1 = path[i - 1];
+    const CameraKey& p2 = path[i];
+    const CameraKey& p3 = path[std::min(i + 1, path.size() - 1)];
+
+    float span = p2.time - p1.time;
+    float t = span > 0.0f ? (time - p1.time) / span : 1.0f;
+    float t2 = t * t, t3 = t2 * t;
+    auto spline = [&](float a, float b, float c, float d) {
+        return 0.5f * (2.0f * b + (c - a) * t + (2.0f * a - 5.0f * b + 4.0f * c - d) * t2 + (3.0f * b - a - 3.0f * c + d) * t3);
+    };
+
+    CameraKey key;
+    key.time = time;
+    for (int c = 0; c < 3; c++)
+        key.position[c] = spline(p0.position[c], p1.position[c], p2.position[c], p3.position[c]);
+    key.yaw = spline(p0.yaw, p1.yaw, p2.yaw, p3.yaw);
+    key.pitch = glm::clamp(spline(p0.pitch, p1.pitch, p2.pitch, p3.pitch), -89.0f, 89.0f);
+    return key;
+}
+
+FrameTimeSummary summarizeFrameTimes(std::vector<double> frameMs) {
+    FrameTimeSummary summary;
+    if (frameMs.empty())
+        return summary;
+    std::sort(frameMs.begin(), frameMs.end());
+    summary.frames = frameMs.size();
+    for (double ms : frameMs)
+        summary.meanMs += ms;
+    summary.meanMs /= frameMs.size();
+    summary.p50Ms = percentile(frameMs, 50.0);
+    summary.p95Ms = percentile(frameMs, 95.0);
+    summary.p99Ms = percentile(frameMs, 99.0);
+    summary.maxMs = frameMs.back();
+    return summary;
+}
+
+bool writeBenchmarkCsv(const std::string& path, const std::string& script, const FrameTimeSummary& summary) {
+    bool exists = std::ifstream(path).good();
+    std::ofstream file(path, std::ios::app);
+    if (!file) {
+        std::cout << "ERROR::BENCHMARK::CSV_NOT_WRITTEN: " << path << std::endl;
+        return false;
+    }
+    if (!exists)
+        file << "script,frames,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+    file << script << "," << summary.frames << "," << summary.meanMs << "," << summary.p50Ms << ","
+        << summary.p95Ms << "," << summary.p99Ms << "," << summary.maxMs << "\n";
+    return true;
+}
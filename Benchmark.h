@@ -0,0 +1,66 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// A scripted run for --benchmark: the camera follows a path at a fixed
+// timestep and every frame is timed, so two builds can be compared on the
+// same frames. Scripts are JSON:
+//
+//   {
+//     "frames": 600,          frames timed
+//     "warmup": 60,           frames drawn first and not timed
+//     "timestep": 0.0166667,  seconds of game time per frame
+//     "width": 1350, "height": 1080,
+//     "output": "benchmark.csv",
+//     "path": [
+//       { "time": 0.0, "position": [0.0, 1.0, 3.0], "yaw": -90.0, "pitch": 0.0 },
+//       ...
+//     ]
+//   }
+//
+// Every field but path is optional. Keys are in time order.
+
+// Camera pose at a point in time
+struct CameraKey {
+    float time = 0.0f;
+    glm::vec3 position = glm::vec3(0.0f);
+    float yaw = -90.0f;
+    float pitch = 0.0f;
+};
+
+struct BenchmarkScript {
+    unsigned int frames = 600;
+    unsigned int warmupFrames = 60;
+    float timestep = 1.0f / 60.0f;
+    unsigned int width = 1350;
+    unsigned int height = 1080;
+    std::string output = "benchmark.csv";
+    std::vector<CameraKey> path;
+};
+
+// False, with a message, if the file cannot be read or is not a script
+bool loadBenchmarkScript(const std::string& path, BenchmarkScript& script);
+
+// Pose at time on a Catmull-Rom spline through the keys, held before the
+// first and after the last
+CameraKey sampleCameraPath(const std::vector<CameraKey>& path, float time);
+
+struct FrameTimeSummary {
+    size_t frames = 0;
+    double meanMs = 0.0;
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+};
+
+FrameTimeSummary summarizeFrameTimes(std::vector<double> frameMs);
+
+// Appends a row for the run to the CSV at path, with a header if the file is
+// new, so runs of several builds collect in one file
+bool writeBenchmarkCsv(const std::string& path, const std::string& script, const FrameTimeSummary& summary);
+
+#endif
@@ -0,0 +1,528 @@
+#include "BlockCompression.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstring>
+
+unsigned int blockBytes(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1:
+    case BlockFormat::BC4:
+        return 8;
+    case BlockFormat::BC3:
+    case BlockFormat::BC5:
+    case BlockFormat::BC7:
+        return 16;
+    }
+    return 0;
+}
+
+const char* blockFormatName(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1: return "BC1";
+    case BlockFormat::BC3: return "BC3";
+    case BlockFormat::BC4: return "BC4";
+    case BlockFormat::BC5: return "BC5";
+    case BlockFormat::BC7: return "BC7";
+    }
+    return "unknown";
+}
+
+BlockFormat chooseBlockFormat(int components, bool highQuality) {
+    if (components == 1)
+        return BlockFormat::BC4;
+    if (components == 2)
+        return BlockFormat::BC5;
+    if (highQuality)
+        return BlockFormat::BC7;
+    return components == 4 ? BlockFormat::BC3 : BlockFormat::BC1;
+}
+
+// Principal axis of a set of points (power iteration on the covariance)
+template <typename Vec>
+static Vec principalAxis(const Vec* points, int count, const Vec& mean) {
+    const int n = Vec::length();
+    float covariance[4][4] = {};
+    for (int i = 0; i < count; i++) {
+        Vec d = points[i] - mean;
+        for (int r = 0; r < n; r++)
+            for (int c = 0; c < n; c++)
+                covariance[r][c] += d[r] * d[c];
+    }
+
+    Vec axis(1.0f);
+    for (int iteration = 0; iteration < 8; iteration++) {
+        Vec next(0.0f);
+        for (int r = 0; r < n; r++)
+            for (int c = 0; c < n; c++)
+                next[r] += covariance[r][c] * axis[c];
+        float length = glm::length(next);
+        if (length < 1e-6f)
+            return Vec(0.0f);
+        axis = next / length;
+    }
+    return axis;
+}
+
+// Endpoints of the points' extent along their principal axis
+template <typename Vec>
+static void fitEndpoints(const Vec* points, int count, Vec& low, Vec& high) {
+    Vec mean(0.0f);
+    for (int i = 0; i < count; i++)
+        mean += points[i];
+    mean /= (float)count;
+
+    Vec axis = principalAxis(points, count, mean);
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < count; i++) {
+        float t = glm::dot(points[i] - mean, axis);
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    low = mean + axis * minT;
+    high = mean + axis * maxT;
+}
+
+// Little-endian bit writer/reader over one block
+struct BlockBits {
+    uint8_t* bytes;
+    unsigned int position = 0;
+
+    void write(uint32_t value, unsigned int count) {
+        for (unsigned int i = 0; i < count; i++, position++) {
+            if (value >> i & 1)
+                bytes[position >> 3] |= (uint8_t)(1 << (position & 7));
+        }
+    }
+};
+
+static uint32_t readBits(const uint8_t* bytes, unsigned int& position, unsigned int count) {
+    uint32_t value = 0;
+    for (unsigned int i = 0; i < count; i++, position++)
+        value |= (uint32_t)(bytes[position >> 3] >> (position & 7) & 1) << i;
+    return value;
+}
+
+// ---- BC1 ----
+
+static uint16_t packRGB565(const glm::vec3& color) {
+    glm::vec3 c = glm::clamp(color, 0.0f, 255.0f);
+    uint16_t r = (uint16_t)(c.r * 31.0f / 255.0f + 0.5f);
+    uint16_t g = (uint16_t)(c.g * 63.0f / 255.0f + 0.5f);
+    uint16_t b = (uint16_t)(c.b * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+static glm::vec3 unpackRGB565(uint16_t packed) {
+    int r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+    return glm::vec3((float)(r << 3 | r >> 2), (float)(g << 2 | g >> 4), (float)(b << 3 | b >> 2));
+}
+
+// Four-color palette in BC1 index order
+static void bc1Palette(uint16_t c0, uint16_t c1, glm::vec3 palette[4]) {
+    palette[0] = unpackRGB565(c0);
+    palette[1] = unpackRGB565(c1);
+    palette[2] = (palette[0] * 2.0f + palette[1]) / 3.0f;
+    palette[3] = (palette[0] + palette[1] * 2.0f) / 3.0f;
+}
+
+// Nearest palette entry for each pixel; returns the squared error
+static float bc1Indices(const glm::vec3 colors[16], const glm::vec3 palette[4], uint8_t indices[16]) {
+    float error = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float best = 1e30f;
+        for (uint8_t p = 0; p < 4; p++) {
+            glm::vec3 d = colors[i] - palette[p];
+            float distance = glm::dot(d, d);
+            if (distance < best) {
+                best = distance;
+                indices[i] = p;
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+static void encodeBC1(const uint8_t rgba[64], uint8_t* block) {
+    glm::vec3 colors[16];
+    for (int i = 0; i < 16; i++)
+        colors[i] = glm::vec3(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2]);
+
+    glm::vec3 low, high;
+    fitEndpoints(colors, 16, low, high);
+    // Pull the endpoints in slightly; the extremes are rarely worth exact hits
+    glm::vec3 inset = (high - low) / 16.0f;
+    uint16_t c0 = packRGB565(high - inset), c1 = packRGB565(low + inset);
+
+    glm::vec3 palette[4];
+    uint8_t indices[16];
+    bc1Palette(c0, c1, palette);
+    float error = bc1Indices(colors, palette, indices);
+
+    // One least-squares refit of the endpoints to the chosen indices
+    static const float weight0[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    glm::vec3 ax(0.0f), bx(0.0f);
+    for (int i = 0; i < 16; i++) {
+        float a = weight0[indices[i]], b = 1.0f - a;
+        aa += a * a; ab += a * b; bb += b * b;
+        ax += colors[i] * a; bx += colors[i] * b;
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) > 1e-6f) {
+        uint16_t r0 = packRGB565((ax * bb - bx * ab) / determinant);
+        uint16_t r1 = packRGB565((bx * aa - ax * ab) / determinant);
+        glm::vec3 refitPalette[4];
+        uint8_t refitIndices[16];
+        bc1Palette(r0, r1, refitPalette);
+        float refitError = bc1Indices(colors, refitPalette, refitIndices);
+        if (refitError < error) {
+            c0 = r0;
+            c1 = r1;
+            std::memcpy(indices, refitIndices, 16);
+        }
+    }
+
+    // c0 > c1 selects the four-color mode; swapping endpoints remaps 0<->1 and 2<->3
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        for (uint8_t& index : indices)
+            index ^= 1;
+    }
+    else if (c0 == c1) {
+        std::memset(indices, 0, 16);
+    }
+
+    std::memset(block, 0, 8);
+    block[0] = (uint8_t)c0; block[1] = (uint8_t)(c0 >> 8);
+    block[2] = (uint8_t)c1; block[3] = (uint8_t)(c1 >> 8);
+    for (int i = 0; i < 16; i++)
+        block[4 + i / 4] |= (uint8_t)(indices[i] << (i % 4 * 2));
+}
+
+static void decodeBC1(const uint8_t* block, uint8_t rgba[64], bool forceFourColor) {
+    uint16_t c0 = (uint16_t)(block[0] | block[1] << 8), c1 = (uint16_t)(block[2] | block[3] << 8);
+    glm::vec4 palette[4];
+    glm::vec3 e0 = unpackRGB565(c0), e1 = unpackRGB565(c1);
+    palette[0] = glm::vec4(e0, 255.0f);
+    palette[1] = glm::vec4(e1, 255.0f);
+    if (c0 > c1 || forceFourColor) {
+        palette[2] = glm::vec4((e0 * 2.0f + e1) / 3.0f, 255.0f);
+        palette[3] = glm::vec4((e0 + e1 * 2.0f) / 3.0f, 255.0f);
+    }
+    else {
+        palette[2] = glm::vec4((e0 + e1) / 2.0f, 255.0f);
+        palette[3] = glm::vec4(0.0f);
+    }
+    for (int i = 0; i < 16; i++) {
+        const glm::vec4& color = palette[block[4 + i / 4] >> (i % 4 * 2) & 3];
+        for (int c = 0; c < 4; c++)
+            rgba[i * 4 + c] = (uint8_t)(color[c] + 0.5f);
+    }
+}
+
+// ---- BC4 ----
+
+static void bc4Palette(uint8_t a0, uint8_t a1, int palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int k = 2; k < 8; k++)
+            palette[k] = ((8 - k) * a0 + (k - 1) * a1 + 3) / 7;
+    }
+    else {
+        for (int k = 2; k < 6; k++)
+            palette[k] = ((6 - k) * a0 + (k - 1) * a1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// values are read with the given stride, e.g. 4 to pick one channel of RGBA
+static void encodeBC4(const uint8_t* values, int stride, uint8_t* block) {
+    uint8_t low = 255, high = 0;
+    for (int i = 0; i < 16; i++) {
+        low = std::min(low, values[i * stride]);
+        high = std::max(high, values[i * stride]);
+    }
+
+    // high > low selects the eight-value mode; equal endpoints need no indices
+    int palette[8];
+    bc4Palette(high, low, palette);
+    std::memset(block, 0, 8);
+    block[0] = high;
+    block[1] = low;
+    if (high == low)
+        return;
+
+    BlockBits bits = { block + 2 };
+    for (int i = 0; i < 16; i++) {
+        int value = values[i * stride], best = 1 << 30;
+        uint32_t bestIndex = 0;
+        for (uint32_t k = 0; k < 8; k++) {
+            int distance = std::abs(palette[k] - value);
+            if (distance < best) {
+                best = distance;
+                bestIndex = k;
+            }
+        }
+        bits.write(bestIndex, 3);
+    }
+}
+
+static void decodeBC4(const uint8_t* block, uint8_t* values, int stride) {
+    int palette[8];
+    bc4Palette(block[0], block[1], palette);
+    unsigned int position = 0;
+    for (int i = 0; i < 16; i++)
+        values[i * stride] = (uint8_t)palette[readBits(block + 2, position, 3)];
+}
+
+// ---- BC7 (mode 6: one subset, RGBA 7.7.7.7 endpoints with a p-bit each, 4-bit indices) ----
+
+static const int bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Quantize an endpoint to 7 bits per channel plus a shared p-bit
+static void quantizeBC7Endpoint(const glm::vec4& endpoint, uint8_t quantized[4], uint8_t& pbit) {
+    float bestError = 1e30f;
+    for (uint8_t p = 0; p < 2; p++) {
+        uint8_t q[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            float value = glm::clamp(endpoint[c], 0.0f, 255.0f);
+            int level = (int)((value - p) / 2.0f + 0.5f);
+            q[c] = (uint8_t)glm::clamp(level, 0, 127);
+            float restored = (float)(q[c] << 1 | p);
+            error += (restored - value) * (restored - value);
+        }
+        if (error < bestError) {
+            bestError = error;
+            pbit = p;
+            std::memcpy(quantized, q, 4);
+        }
+    }
+}
+
+static void encodeBC7(const uint8_t rgba[64], uint8_t* block) {
+    glm::vec4 colors[16];
+    for (int i = 0; i < 16; i++)
+        colors[i] = glm::vec4(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2], rgba[i * 4 + 3]);
+
+    glm::vec4 low, high;
+    fitEndpoints(colors, 16, low, high);
+
+    uint8_t q[2][4], pbit[2];
+    quantizeBC7Endpoint(low, q[0], pbit[0]);
+    quantizeBC7Endpoint(high, q[1], pbit[1]);
+
+    glm::vec4 e0, e1;
+    for (int c = 0; c < 4; c++) {
+        e0[c] = (float)(q[0][c] << 1 | pbit[0]);
+        e1[c] = (float)(q[1][c] << 1 | pbit[1]);
+    }
+    uint8_t indices[16];
+    for (int i = 0; i < 16; i++) {
+        float best = 1e30f;
+        for (uint8_t k = 0; k < 16; k++) {
+            glm::vec4 d = (e0 * (float)(64 - bc7Weights4[k]) + e1 * (float)bc7Weights4[k]) / 64.0f - colors[i];
+            float distance = glm::dot(d, d);
+            if (distance < best) {
+                best = distance;
+                indices[i] = k;
+            }
+        }
+    }
+
+    // The first index is stored without its top bit, so it must be below 8
+    int first = 0, second = 1;
+    if (indices[0] >= 8) {
+        std::swap(first, second);
+        for (uint8_t& index : indices)
+            index = (uint8_t)(15 - index);
+    }
+
+    std::memset(block, 0, 16);
+    BlockBits bits = { block };
+    bits.write(1 << 6, 7); // mode 6
+    for (int c = 0; c < 4; c++) {
+        bits.write(q[first][c], 7);
+        bits.write(q[second][c], 7);
+    }
+    bits.write(pbit[first], 1);
+    bits.write(pbit[second], 1);
+    bits.write(indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        bits.write(indices[i], 4);
+}
+
+static void decodeBC7(const uint8_t* block, uint8_t rgba[64]) {
+    unsigned int position = 0;
+    if (readBits(block, position, 7) != 1 << 6) {
+        // Only mode 6, as written by encodeBC7, is supported; show magenta otherwise
+        for (int i = 0; i < 16; i++) {
+            rgba[i * 4] = 255; rgba[i * 4 + 1] = 0; rgba[i * 4 + 2] = 255; rgba[i * 4 + 3] = 255;
+        }
+        return;
+    }
+
+    int endpoints[2][4];
+    for (int c = 0; c < 4; c++) {
+        endpoints[0][c] = (int)readBits(block, position, 7) << 1;
+        endpoints[1][c] = (int)readBits(block, position, 7) << 1;
+    }
+    uint32_t p0 = readBits(block, position, 1), p1 = readBits(block, position, 1);
+    for (int c = 0; c < 4; c++) {
+        endpoints[0][c] |= p0;
+        endpoints[1][c] |= p1;
+    }
+    for (int i = 0; i < 16; i++) {
+        int weight = bc7Weights4[readBits(block, position, i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; c++)
+            rgba[i * 4 + c] = (uint8_t)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+    }
+}
+
+void encodeBlock(BlockFormat format, const uint8_t rgba[64], uint8_t* block) {
+    switch (format) {
+    case BlockFormat::BC1:
+        encodeBC1(rgba, block);
+        break;
+    case BlockFormat::BC3:
+        encodeBC4(rgba + 3, 4, block);
+        encodeBC1(rgba, block + 8);
+        break;
+    case BlockFormat::BC4:
+        encodeBC4(rgba, 4, block);
+        break;
+    case BlockFormat::BC5:
+        encodeBC4(rgba, 4, block);
+        encodeBC4(rgba + 1, 4, block + 8);
+        break;
+    case BlockFormat::BC7:
+        encodeBC7(rgba, block);
+        break;
+    }
+}
+
+void decodeBlock(BlockFormat format, const uint8_t* block, uint8_t rgba[64]) {
+    switch (format) {
+    case BlockFormat::BC1:
+        decodeBC1(block, rgba, false);
+        break;
+    case BlockFormat::BC3:
+        decodeBC1(block + 8, rgba, true); // BC3 colors always use four colors
+        decodeBC4(block, rgba + 3, 4);
+        break;
+    case BlockFormat::BC4:
+    case BlockFormat::BC5:
+        for (int i = 0; i < 16; i++) {
+            rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+            rgba[i * 4 + 3] = 255;
+        }
+        decodeBC4(block, rgba, 4);
+        if (format == BlockFormat::BC5)
+            decodeBC4(block + 8, rgba + 1, 4);
+        break;
+    case BlockFormat::BC7:
+        decodeBC7(block, rgba);
+        break;
+    }
+}
+
+// Expand any component count to RGBA. Grey goes to red (BC4); grey + alpha
+// goes to red and green (BC5), matching the swizzle applied when sampling.
+static std::vector<uint8_t> toRGBA(const ImageData& image) {
+    size_t pixels = (size_t)image.width * image.height;
+    std::vector<uint8_t> rgba(pixels * 4);
+    const uint8_t* source = image.pixels.get();
+    for (size_t i = 0; i < pixels; i++) {
+        const uint8_t* s = source + i * image.components;
+        uint8_t* d = &rgba[i * 4];
+        switch (image.components) {
+        case 1: d[0] = d[1] = d[2] = s[0]; d[3] = 255; break;
+        case 2: d[0] = s[0]; d[1] = s[1]; d[2] = 0; d[3] = 255; break;
+        case 3: d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = 255; break;
+        default: d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = s[3]; break;
+        }
+    }
+    return rgba;
+}
+
+// Next mip level with a 2x2 box filter; odd edges repeat the last texel
+static std::vector<uint8_t> downsample(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height) {
+    uint32_t nextWidth = std::max(1u, width / 2), nextHeight = std::max(1u, height / 2);
+    std::vector<uint8_t> next((size_t)nextWidth * nextHeight * 4);
+    for (uint32_t y = 0; y < nextHeight; y++) {
+        uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+        for (uint32_t x = 0; x < nextWidth; x++) {
+            uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            for (int c = 0; c < 4; c++) {
+                int sum = rgba[((size_t)y0 * width + x0) * 4 + c] + rgba[((size_t)y0 * width + x1) * 4 + c] +
+                    rgba[((size_t)y1 * width + x0) * 4 + c] + rgba[((size_t)y1 * width + x1) * 4 + c];
+                next[((size_t)y * nextWidth + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+            }
+        }
+    }
+    return next;
+}
+
+static std::vector<uint8_t> compressLevel(BlockFormat format, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height) {
+    uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    unsigned int bytes = blockBytes(format);
+    std::vector<uint8_t> data((size_t)blocksX * blocksY * bytes);
+
+    uint8_t pixels[64];
+    for (uint32_t by = 0; by < blocksY; by++) {
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            // Blocks past the edge repeat the last row and column
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = std::min(bx * 4 + i % 4, width - 1), y = std::min(by * 4 + i / 4, height - 1);
+                std::memcpy(pixels + i * 4, &rgba[((size_t)y * width + x) * 4], 4);
+            }
+            encodeBlock(format, pixels, &data[((size_t)by * blocksX + bx) * bytes]);
+        }
+    }
+    return data;
+}
+
+CompressedImage compressImage(const ImageData& image, BlockFormat format) {
+    CompressedImage result;
+    result.format = format;
+    if (!image.pixels || image.width <= 0 || image.height <= 0)
+        return result;
+
+    uint32_t width = (uint32_t)image.width, height = (uint32_t)image.height;
+    std::vector<uint8_t> rgba = toRGBA(image);
+    for (;;) {
+        CompressedImage::Level level;
+        level.width = width;
+        level.height = height;
+        level.data = compressLevel(format, rgba, width, height);
+        result.levels.push_back(std::move(level));
+        if (width == 1 && height == 1)
+            break;
+        rgba = downsample(rgba, width, height);
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    return result;
+}
+
+std::vector<uint8_t> decompressLevel(BlockFormat format, const uint8_t* data, uint32_t width, uint32_t height) {
+    uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    unsigned int bytes = blockBytes(format);
+    std::vector<uint8_t> rgba((size_t)width * height * 4);
+
+    uint8_t pixels[64];
+    for (uint32_t by = 0; by < blocksY; by++) {
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            decodeBlock(format, data + ((size_t)by * blocksX + bx) * bytes, pixels);
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                if (x < width && y < height)
+                    std::memcpy(&rgba[((size_t)y * width + x) * 4], pixels + i * 4, 4);
+            }
+        }
+    }
+    return rgba;
+}
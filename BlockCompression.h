@@ -0,0 +1,56 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ModelData.h"
+
+// GPU block-compressed formats. Each 4x4 pixel block is stored in 8 or 16
+// bytes. The values are the matching Vulkan formats, as used by KTX2.
+enum class BlockFormat : uint32_t {
+    BC1 = 131, // RGB, 8 bytes (VK_FORMAT_BC1_RGB_UNORM_BLOCK)
+    BC3 = 137, // RGBA, 16 bytes: BC1 color plus a BC4 alpha block
+    BC4 = 139, // one channel, 8 bytes
+    BC5 = 141, // two channels, 16 bytes: two BC4 blocks
+    BC7 = 145  // RGBA, 16 bytes; encoded here in mode 6 only
+};
+
+// Bytes per 4x4 block, or 0 for an unknown format
+unsigned int blockBytes(BlockFormat format);
+
+const char* blockFormatName(BlockFormat format);
+
+// BC4 for grey, BC5 for grey + alpha, BC1 for RGB and BC3 for RGBA;
+// highQuality picks BC7 for RGB and RGBA instead
+BlockFormat chooseBlockFormat(int components, bool highQuality);
+
+// Encode one block of 16 RGBA pixels (row major, 64 bytes). BC4 reads red,
+// BC5 red and green.
+void encodeBlock(BlockFormat format, const uint8_t rgba[64], uint8_t* block);
+
+// Decode one block back to 16 RGBA pixels. BC4/BC5 leave the unused
+// channels at 0 (alpha at 255).
+void decodeBlock(BlockFormat format, const uint8_t* block, uint8_t rgba[64]);
+
+// A compressed image with its full mip chain, level 0 first
+struct CompressedImage {
+    struct Level {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> data;
+    };
+
+    BlockFormat format = BlockFormat::BC1;
+    std::vector<Level> levels;
+};
+
+// Build the mip chain of a decoded image with a box filter and compress every
+// level. Grey and grey + alpha images have their channels placed for BC4/BC5.
+CompressedImage compressImage(const ImageData& image, BlockFormat format);
+
+// Decompress one level to RGBA, e.g. for a GPU without the format or to
+// measure the encoding error
+std::vector<uint8_t> decompressLevel(BlockFormat format, const uint8_t* data, uint32_t width, uint32_t height);
+
+#endif
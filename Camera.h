@@ -45,6 +45,14 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // Place the camera directly, e.g. along a scripted path
+    void SetPose(const glm::vec3& position, float yaw, float pitch) {
+        Position = position;
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
     // Process keyboard input for specific movement direction
     void ProcessKeyboard(CameraMovement direction, float deltaTime) {
         float velocity = MovementSpeed * deltaTime;
@@ -0,0 +1,350 @@
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "Model.h"
+#include "ModelInstance.h"
+#include "GeometryArena.h"
+#include "GLState.h"
+#include "Frustum.h"
+#include "Shader.h"
+
+typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+
+// glMultiDrawElementsIndirect, or null when the context does not have it
+inline MultiDrawElementsIndirectProc& multiDrawElementsIndirect() {
+    static MultiDrawElementsIndirectProc proc = nullptr;
+    return proc;
+}
+
+// GL thread, after glad: load glMultiDrawElementsIndirect if the context has
+// GL 4.3, or the multi-draw and base instance extensions it needs on 4.2 and
+// older. Without it DrawList falls back to one base-vertex draw per mesh.
+inline bool loadMultiDrawIndirect(GLADloadproc load) {
+    GLint major = 0, minor = 0, extensions = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+
+    bool multiDraw = major > 4 || (major == 4 && minor >= 3);
+    bool baseInstance = multiDraw;
+    for (GLint i = 0; i < extensions; i++) {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (std::strcmp(name, "GL_ARB_multi_draw_indirect") == 0)
+            multiDraw = true;
+        else if (std::strcmp(name, "GL_ARB_base_instance") == 0)
+            baseInstance = true;
+    }
+
+    multiDrawElementsIndirect() = multiDraw && baseInstance ?
+        (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect") : nullptr;
+    return multiDrawElementsIndirect() != nullptr;
+}
+
+// What the DRAW_ID variant of model_vertex.glsl reads for each draw, one vec4
+// per texel of a buffer texture
+struct DrawData {
+    glm::vec4 model[4];
+    glm::vec4 normal[3];     // normal matrix columns, w unused
+    glm::vec4 positionOffset;
+    glm::vec4 positionScale;
+};
+static_assert(sizeof(DrawData) == 9 * sizeof(glm::vec4), "model_vertex.glsl reads DrawData as 9 texels");
+
+// Texture unit of the draw data, above the material's units
+const unsigned int DRAW_DATA_TEXTURE_UNIT = 8;
+// Attribute location of the draw id, after the instance matrices
+const unsigned int DRAW_ID_LOCATION = 10;
+
+// Meshes of model placements that passed frustum culling, and their
+// transforms. There is nothing GL in here, so jobs can each cull part of the
+// scene into their own and the GL thread appends them to a DrawList.
+class CulledDraws {
+public:
+    void clear() {
+        draws.clear();
+        transforms.clear();
+    }
+
+    // Keep the meshes of model whose bounds, placed by modelMatrix, touch the
+    // frustum, at level of detail lod
+    void add(const Model& model, const glm::mat4& modelMatrix, const glm::mat3& normalMatrix, const Frustum& frustum,
+        CullStats& stats, unsigned int lod = 0) {
+        const std::vector<Mesh>& meshes = model.getMeshes();
+        if (!frustum.isBoxVisible(model.getBoundsMin(), model.getBoundsMax(), modelMatrix)) {
+            stats.culled += (unsigned int)meshes.size();
+            return;
+        }
+
+        unsigned int transform = (unsigned int)transforms.size();
+        transforms.push_back({ modelMatrix, normalMatrix });
+        for (const Mesh& mesh : meshes) {
+            if (frustum.isBoxVisible(mesh.boundsMin, mesh.boundsMax, modelMatrix)) {
+                draws.push_back({ &mesh, transform, lod });
+                stats.drawn++;
+                stats.triangles += mesh.getTriangleCount(lod);
+            }
+            else {
+                stats.culled++;
+            }
+        }
+    }
+
+    void add(const ModelInstance& instance, const Frustum& frustum, CullStats& stats) {
+        add(instance.getModel(), instance.getModelMatrix(), instance.getNormalMatrix(), frustum, stats, instance.getLod());
+    }
+
+    size_t size() const {
+        return draws.size();
+    }
+
+private:
+    friend class DrawList;
+
+    struct Transform {
+        glm::mat4 model;
+        glm::mat3 normal;
+    };
+
+    struct QueuedDraw {
+        const Mesh* mesh;
+        unsigned int transform; // into transforms
+        unsigned int lod;
+    };
+
+    std::vector<QueuedDraw> draws;
+    std::vector<Transform> transforms;
+};
+
+// The meshes of many model placements, drawn with one multi-draw per
+// geometry pool and material. Each draw's transform and position decoding
+// sit in a buffer texture; the shader finds them by draw id, which with
+// multi-draw is the command's base instance read through an instanced
+// attribute, and without it a generic attribute value set before each
+// base-vertex draw. Either way there are no per-draw uniforms or VAO binds.
+class DrawList {
+public:
+    DrawList() {
+        glGenBuffers(1, &dataBuffer);
+        glGenTextures(1, &dataTexture);
+        glGenBuffers(1, &commandBuffer);
+        glGenBuffers(1, &drawIdBuffer);
+
+        // GL 3.3 only promises 65536 texels, about 7000 draws
+        GLint texels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+        maxDrawsPerSubmission = std::max(texels, 65536) / (sizeof(DrawData) / sizeof(glm::vec4));
+    }
+
+    ~DrawList() {
+        if (!indirectVAOs.empty())
+            GLState::instance().deleteVertexArrays((GLsizei)indirectVAOs.size(), &indirectVAOs[0]);
+        GLState::instance().deleteBuffers(1, &dataBuffer);
+        GLState::instance().deleteTextures(1, &dataTexture);
+        GLState::instance().deleteBuffers(1, &commandBuffer);
+        GLState::instance().deleteBuffers(1, &drawIdBuffer);
+    }
+
+    DrawList(const DrawList&) = delete;
+    DrawList& operator=(const DrawList&) = delete;
+
+    // Whether Draw uses multi-draw when the context has it
+    bool useMultiDraw = true;
+
+    // Draws whose data fits in the buffer texture at once; more are drawn in
+    // several submissions
+    size_t maxDrawsPerSubmission;
+
+    void clear() {
+        queued.clear();
+    }
+
+    // Queue the meshes of model whose bounds, placed by modelMatrix, touch the
+    // frustum, at level of detail lod
+    void add(const Model& model, const glm::mat4& modelMatrix, const glm::mat3& normalMatrix, const Frustum& frustum,
+        CullStats& stats, unsigned int lod = 0) {
+        queued.add(model, modelMatrix, normalMatrix, frustum, stats, lod);
+    }
+
+    void add(const ModelInstance& instance, const Frustum& frustum, CullStats& stats) {
+        add(instance.getModel(), instance.getModelMatrix(), instance.getNormalMatrix(), frustum, stats, instance.getLod());
+    }
+
+    // Queue meshes culled elsewhere, after those already queued
+    void append(const CulledDraws& culled) {
+        unsigned int transformBase = (unsigned int)queued.transforms.size();
+        queued.transforms.insert(queued.transforms.end(), culled.transforms.begin(), culled.transforms.end());
+        for (CulledDraws::QueuedDraw draw : culled.draws) {
+            draw.transform += transformBase;
+            queued.draws.push_back(draw);
+        }
+    }
+
+    // Draw everything queued. shader must be model_vertex.glsl compiled with
+    // DRAW_ID.
+    void Draw(const Shader& shader) {
+        std::vector<QueuedDraw>& draws = queued.draws;
+        const std::vector<Transform>& transforms = queued.transforms;
+        if (draws.empty())
+            return;
+
+        // Group by pool, then material, so each group is one multi-draw
+        std::sort(draws.begin(), draws.end(), [](const QueuedDraw& a, const QueuedDraw& b) {
+            if (a.mesh->getPool() != b.mesh->getPool())
+                return a.mesh->getPool() < b.mesh->getPool();
+            return a.mesh->getMaterial() < b.mesh->getMaterial();
+        });
+
+        data.resize(draws.size());
+        commands.resize(draws.size());
+        for (size_t i = 0; i < draws.size(); i++) {
+            const QueuedDraw& draw = draws[i];
+            const Transform& transform = transforms[draw.transform];
+            DrawData& drawData = data[i];
+            for (int column = 0; column < 4; column++)
+                drawData.model[column] = transform.model[column];
+            for (int column = 0; column < 3; column++)
+                drawData.normal[column] = glm::vec4(transform.normal[column], 0.0f);
+            drawData.positionOffset = glm::vec4(draw.mesh->getPositionOffset(), 0.0f);
+            drawData.positionScale = glm::vec4(draw.mesh->getPositionScale(), 0.0f);
+
+            DrawCommand& command = commands[i];
+            GLsizei count;
+            draw.mesh->getLodIndices(draw.lod, command.firstIndex, count);
+            command.count = (GLuint)count;
+            command.instanceCount = 1;
+            command.baseVertex = draw.mesh->getBaseVertex();
+            command.baseInstance = (GLuint)(i % maxDrawsPerSubmission);
+        }
+
+        GLState& state = GLState::instance();
+        state.activeTexture(DRAW_DATA_TEXTURE_UNIT);
+        state.bindTexture(GL_TEXTURE_BUFFER, dataTexture);
+        if (dataProgram != shader.ID) {
+            dataHandle = shader.uniform<int>("drawData");
+            dataProgram = shader.ID;
+        }
+        shader.set(dataHandle, (int)DRAW_DATA_TEXTURE_UNIT);
+        drawCounters().textureBinds++;
+        drawCounters().uniformUploads++;
+
+        bool multiDraw = useMultiDraw && multiDrawElementsIndirect() != nullptr;
+        if (multiDraw) {
+            growDrawIds(std::min(draws.size(), maxDrawsPerSubmission));
+            state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), &commands[0], GL_STREAM_DRAW);
+        }
+
+        // Draw ids count from the start of their submission
+        const GeometryArena& arena = GeometryArena::instance();
+        unsigned int boundPool = ~0u;
+        for (size_t submission = 0; submission < draws.size(); submission += maxDrawsPerSubmission) {
+            size_t submissionEnd = std::min(submission + maxDrawsPerSubmission, draws.size());
+
+            // Orphan the old storage so the driver need not wait for earlier draws
+            state.bindBuffer(GL_TEXTURE_BUFFER, dataBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, (submissionEnd - submission) * sizeof(DrawData), &data[submission], GL_STREAM_DRAW);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, dataBuffer);
+
+            for (size_t start = submission; start < submissionEnd;) {
+                const Mesh& first = *draws[start].mesh;
+                size_t end = start + 1;
+                while (end < submissionEnd && draws[end].mesh->getPool() == first.getPool() &&
+                    draws[end].mesh->getMaterial() == first.getMaterial())
+                    end++;
+
+                const GeometryPool& pool = arena.pool(first.getPool());
+                if (first.getPool() != boundPool) {
+                    state.bindVertexArray(multiDraw ? indirectVAO(first.getPool()) : pool.VAO);
+                    boundPool = first.getPool();
+                    drawCounters().vertexArrayBinds++;
+                }
+                first.bindTextures(shader);
+
+                if (multiDraw) {
+                    multiDrawElementsIndirect()(GL_TRIANGLES, pool.indexType, (void*)(start * sizeof(DrawCommand)),
+                        (GLsizei)(end - start), 0);
+                    drawCounters().drawCalls++;
+                }
+                else {
+                    for (size_t i = start; i < end; i++) {
+                        const DrawCommand& command = commands[i];
+                        glVertexAttribI1ui(DRAW_ID_LOCATION, command.baseInstance);
+                        glDrawElementsBaseVertex(GL_TRIANGLES, command.count, pool.indexType,
+                            (void*)(command.firstIndex * pool.indexSize()), command.baseVertex);
+                    }
+                    drawCounters().drawCalls += (unsigned int)(end - start);
+                    drawCounters().uniformUploads += (unsigned int)(end - start);
+                }
+                start = end;
+            }
+        }
+    }
+
+    // Meshes queued since clear()
+    size_t size() const {
+        return queued.size();
+    }
+
+private:
+    using Transform = CulledDraws::Transform;
+    using QueuedDraw = CulledDraws::QueuedDraw;
+
+    // Layout of glMultiDrawElementsIndirect's commands
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    CulledDraws queued;
+    std::vector<DrawData> data;
+    std::vector<DrawCommand> commands;
+    unsigned int dataBuffer, dataTexture, commandBuffer, drawIdBuffer;
+    size_t drawIdCount = 0;
+    std::vector<unsigned int> indirectVAOs; // per geometry pool, made on first use
+    unsigned int dataProgram = 0;
+    UniformHandle<int> dataHandle;
+
+    // The draw id buffer holds 0, 1, 2... so the instanced attribute reads a
+    // command's base instance back as its draw id
+    void growDrawIds(size_t count) {
+        if (count <= drawIdCount)
+            return;
+        drawIdCount = std::max(count, drawIdCount * 2);
+        std::vector<GLuint> ids(drawIdCount);
+        for (size_t i = 0; i < ids.size(); i++)
+            ids[i] = (GLuint)i;
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+        glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), &ids[0], GL_STATIC_DRAW);
+    }
+
+    // The pool's buffers plus the draw id attribute
+    unsigned int indirectVAO(unsigned int pool) {
+        if (pool >= indirectVAOs.size())
+            indirectVAOs.resize(pool + 1, 0);
+        if (indirectVAOs[pool])
+            return indirectVAOs[pool];
+
+        const GeometryPool& geometry = GeometryArena::instance().pool(pool);
+        glGenVertexArrays(1, &indirectVAOs[pool]);
+        GLState::instance().bindVertexArray(indirectVAOs[pool]);
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, geometry.VBO);
+        GLState::instance().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry.EBO);
+        GeometryArena::setupVertexAttributes(geometry.packed);
+
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+        glEnableVertexAttribArray(DRAW_ID_LOCATION);
+        glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+        return indirectVAOs[pool];
+    }
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+// Runs the simulation in ticks of a fixed length whatever the frame rate.
+// Each frame adds its time to an accumulator and runs the whole ticks that
+// fit; the remainder carries over, and alpha() tells how far the frame is
+// from the last tick to the next, for drawing between the two. A frame runs
+// at most maxTicks ticks: past that the simulation falls behind real time
+// rather than spending the next frame catching up on this one.
+class FixedTimestep {
+public:
+    explicit FixedTimestep(float step, unsigned int maxTicks = 8)
+        : tickSeconds(step), maxTicks(maxTicks) {}
+
+    // Add a frame's seconds; returns how many ticks to run
+    unsigned int advance(float frameSeconds) {
+        accumulator += frameSeconds > 0.0f ? frameSeconds : 0.0f;
+        unsigned int ticks = 0;
+        while (accumulator >= tickSeconds && ticks < maxTicks) {
+            accumulator -= tickSeconds;
+            ticks++;
+        }
+        if (ticks == maxTicks && accumulator >= tickSeconds)
+            accumulator = 0.0f;
+        return ticks;
+    }
+
+    float step() const {
+        return tickSeconds;
+    }
+
+    // In [0, 1): 0 at the last tick, towards 1 near the next
+    float alpha() const {
+        return accumulator / tickSeconds;
+    }
+
+private:
+    float tickSeconds;
+    unsigned int maxTicks;
+    float accumulator = 0.0f;
+};
+
+#endif
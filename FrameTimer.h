@@ -0,0 +1,90 @@
+#ifndef FRAME_TIMER_H
+#define FRAME_TIMER_H
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Measures the CPU time spent building each frame (everything up to, but not
+// including, the buffer swap) and prints a summary every reportInterval frames.
+// Named counters added during a frame are reported as per-frame averages.
+class FrameTimer {
+public:
+    FrameTimer(unsigned int reportInterval = 240)
+        : reportInterval(reportInterval) {
+        counters.reserve(16);
+        reset();
+    }
+
+    void beginFrame() {
+        frameStart = Clock::now();
+    }
+
+    // Returns true on the frames that print a report
+    bool endFrame() {
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+        lastMs = ms;
+        totalMs += ms;
+        if (ms < minMs) minMs = ms;
+        if (ms > maxMs) maxMs = ms;
+
+        if (++frames == reportInterval) {
+            std::cout << "Frame CPU time" << (label ? " [" : "") << (label ? label : "") << (label ? "]" : "")
+                << " over " << frames << " frames: avg " << totalMs / frames
+                << " ms, min " << minMs << " ms, max " << maxMs << " ms" << std::endl;
+            for (const Counter& counter : counters)
+                std::cout << "  " << counter.name << ": " << (double)counter.total / frames << " per frame" << std::endl;
+            reset();
+            return true;
+        }
+        return false;
+    }
+
+    // Tag the following reports, e.g. with the render path being measured
+    void setLabel(const char* name) {
+        label = name;
+    }
+
+    // Add to a named counter for the current frame. The name must outlive the timer.
+    void addCount(const char* name, unsigned long long value) {
+        for (Counter& counter : counters) {
+            if (std::strcmp(counter.name, name) == 0) {
+                counter.total += value;
+                return;
+            }
+        }
+        counters.push_back({ name, value });
+    }
+
+    double lastFrameMs() const {
+        return lastMs;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Counter {
+        const char* name;
+        unsigned long long total;
+    };
+
+    unsigned int reportInterval;
+    unsigned int frames;
+    double totalMs, minMs, maxMs;
+    double lastMs = 0.0;
+    const char* label = nullptr;
+    Clock::time_point frameStart;
+    std::vector<Counter> counters;
+
+    void reset() {
+        for (Counter& counter : counters)
+            counter.total = 0;
+        frames = 0;
+        totalMs = 0.0;
+        minMs = 1e30;
+        maxMs = 0.0;
+    }
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// View frustum as six planes (ax + by + cz + d >= 0 inside), extracted from a
+// projection * view matrix
+class Frustum {
+public:
+    Frustum(const glm::mat4& viewProjection) {
+        // Rows of the matrix (glm is column major)
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+        planes[0] = row3 + row0; // left
+        planes[1] = row3 - row0; // right
+        planes[2] = row3 + row1; // bottom
+        planes[3] = row3 - row1; // top
+        planes[4] = row3 + row2; // near
+        planes[5] = row3 - row2; // far
+    }
+
+    // Test a model-space AABB placed in the world by modelMatrix
+    bool isBoxVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& modelMatrix) const {
+        // World-space AABB enclosing the transformed box
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f;
+        glm::mat3 absolute(glm::abs(glm::vec3(modelMatrix[0])), glm::abs(glm::vec3(modelMatrix[1])), glm::abs(glm::vec3(modelMatrix[2])));
+        glm::vec3 extent = absolute * halfExtent;
+
+        for (const glm::vec4& plane : planes) {
+            // Distance of the box's most positive corner along the plane normal
+            float radius = glm::dot(extent, glm::abs(glm::vec3(plane)));
+            if (glm::dot(glm::vec3(plane), center) + plane.w + radius < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    glm::vec4 planes[6];
+};
+
+// Meshes drawn and skipped, accumulated over a frame
+struct CullStats {
+    unsigned int drawn = 0;
+    unsigned int culled = 0;
+    unsigned long long triangles = 0; // in the meshes drawn
+
+    // Sum in the stats of another part of the scene
+    void add(const CullStats& other) {
+        drawn += other.drawn;
+        culled += other.culled;
+        triangles += other.triangles;
+    }
+};
+
+#endif
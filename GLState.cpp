@@ -0,0 +1,155 @@
+#include "GLState.h"
+
+GLState& GLState::instance() {
+    static GLState state;
+    return state;
+}
+
+int GLState::textureTarget(GLenum target) {
+    switch (target) {
+    case GL_TEXTURE_2D: return 0;
+    case GL_TEXTURE_CUBE_MAP: return 1;
+    case GL_TEXTURE_BUFFER: return 2;
+    default: return -1;
+    }
+}
+
+int GLState::bufferTarget(GLenum target) {
+    switch (target) {
+    case GL_ARRAY_BUFFER: return 0;
+    case GL_UNIFORM_BUFFER: return 1;
+    case GL_COPY_READ_BUFFER: return 2;
+    case GL_COPY_WRITE_BUFFER: return 3;
+    case GL_TEXTURE_BUFFER: return 4;
+    case GL_DRAW_INDIRECT_BUFFER: return 5;
+    default: return -1;
+    }
+}
+
+GLuint* GLState::capability(GLenum capability) {
+    switch (capability) {
+    case GL_DEPTH_TEST: return &depthTest;
+    case GL_BLEND: return &blend;
+    case GL_CULL_FACE: return &cullFace;
+    default: return nullptr;
+    }
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture) {
+    // A bind to an unknown unit would leave the copy unable to say which
+    // unit changed
+    if (activeUnit == UNKNOWN)
+        activeTexture(0);
+
+    int index = textureTarget(target);
+    if (index < 0 || activeUnit >= TEXTURE_UNITS) {
+        if (counting)
+            counters.issued++;
+        glBindTexture(target, texture);
+        return;
+    }
+    if (changed(textures[activeUnit][index], texture))
+        glBindTexture(target, texture);
+}
+
+void GLState::bindTexture(unsigned int unit, GLenum target, GLuint texture) {
+    int index = textureTarget(target);
+    if (caching && index >= 0 && unit < TEXTURE_UNITS && textures[unit][index] == texture) {
+        if (counting)
+            counters.elided++;
+        return;
+    }
+    activeTexture(unit);
+    bindTexture(target, texture);
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+    int index = bufferTarget(target);
+    if (index < 0) {
+        if (counting)
+            counters.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (changed(buffers[index], buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    if (counting)
+        counters.issued++;
+    glBindBufferBase(target, index, buffer);
+    int generic = bufferTarget(target);
+    if (generic >= 0)
+        buffers[generic] = buffer;
+}
+
+void GLState::setEnabled(GLenum cap, bool enabled) {
+    GLuint* current = capability(cap);
+    if (current && !changed(*current, (GLuint)enabled))
+        return;
+    if (!current && counting)
+        counters.issued++;
+    if (enabled)
+        glEnable(cap);
+    else
+        glDisable(cap);
+}
+
+void GLState::clear(GLbitfield mask) {
+    if (mask & GL_DEPTH_BUFFER_BIT)
+        depthMask(true);
+    glClear(mask);
+}
+
+void GLState::deleteTextures(GLsizei count, const GLuint* ids) {
+    for (GLsizei i = 0; i < count; i++) {
+        for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++) {
+            for (unsigned int target = 0; target < TEXTURE_TARGETS; target++) {
+                if (textures[unit][target] == ids[i])
+                    textures[unit][target] = 0;
+            }
+        }
+    }
+    glDeleteTextures(count, ids);
+}
+
+void GLState::deleteBuffers(GLsizei count, const GLuint* ids) {
+    for (GLsizei i = 0; i < count; i++) {
+        for (unsigned int target = 0; target < BUFFER_TARGETS; target++) {
+            if (buffers[target] == ids[i])
+                buffers[target] = 0;
+        }
+    }
+    glDeleteBuffers(count, ids);
+}
+
+void GLState::deleteVertexArrays(GLsizei count, const GLuint* ids) {
+    for (GLsizei i = 0; i < count; i++) {
+        if (currentVertexArray == ids[i])
+            currentVertexArray = 0;
+    }
+    glDeleteVertexArrays(count, ids);
+}
+
+void GLState::deleteProgram(GLuint program) {
+    // A program in use lives on until another is used
+    if (currentProgram == program)
+        currentProgram = UNKNOWN;
+    glDeleteProgram(program);
+}
+
+void GLState::invalidate() {
+    currentProgram = UNKNOWN;
+    currentVertexArray = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++) {
+        for (unsigned int target = 0; target < TEXTURE_TARGETS; target++)
+            textures[unit][target] = UNKNOWN;
+    }
+    for (unsigned int target = 0; target < BUFFER_TARGETS; target++)
+        buffers[target] = UNKNOWN;
+    depthTest = blend = cullFace = UNKNOWN;
+    depthWrite = depthFunction = UNKNOWN;
+    blendFactors = UNKNOWN;
+}
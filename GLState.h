@@ -0,0 +1,133 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// Not in the GL 3.3 headers
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// GL calls that went through GLState over a frame, for --frame-stats
+struct GLCallCounters {
+    unsigned int issued = 0;
+    unsigned int elided = 0;
+};
+
+// Shadow copy of the binding and depth/blend state of the context. Setting a
+// value the context already has is dropped before it reaches the driver, so
+// draws can set everything they need without unbinding or restoring after
+// themselves. Every bind of a tracked kind has to go through here, and every
+// delete of a tracked object too, or the copy goes stale. Values start
+// unknown, so the first set of each is always issued. GL thread only.
+class GLState {
+public:
+    static GLState& instance();
+
+    // Texture units and buffer targets tracked; others pass straight through
+    static const unsigned int TEXTURE_UNITS = 16;
+
+    void useProgram(GLuint program) {
+        if (changed(currentProgram, program))
+            glUseProgram(program);
+    }
+
+    void bindVertexArray(GLuint vertexArray) {
+        if (changed(currentVertexArray, vertexArray))
+            glBindVertexArray(vertexArray);
+    }
+
+    // unit is a number from 0, not GL_TEXTURE0 + unit
+    void activeTexture(unsigned int unit) {
+        if (changed(activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // Bind to the active unit
+    void bindTexture(GLenum target, GLuint texture);
+
+    // Bind to unit, making it active only when the binding changes
+    void bindTexture(unsigned int unit, GLenum target, GLuint texture);
+
+    // GL_ELEMENT_ARRAY_BUFFER is part of the VAO and is never elided
+    void bindBuffer(GLenum target, GLuint buffer);
+
+    // Also binds buffer to target's generic binding point, as GL does
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+    // GL_DEPTH_TEST, GL_BLEND and GL_CULL_FACE are tracked
+    void setEnabled(GLenum capability, bool enabled);
+
+    void depthMask(bool write) {
+        if (changed(depthWrite, (GLuint)write))
+            glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    void depthFunc(GLenum func) {
+        if (changed(depthFunction, func))
+            glDepthFunc(func);
+    }
+
+    void blendFunc(GLenum source, GLenum destination) {
+        // Blend factors fit in 16 bits
+        if (changed(blendFactors, (source << 16) | destination))
+            glBlendFunc(source, destination);
+    }
+
+    // glClear honours the depth mask, so clearing depth turns writes on first
+    void clear(GLbitfield mask);
+
+    // Delete objects and forget them wherever they were bound, since GL
+    // unbinds them and may hand their names out again
+    void deleteTextures(GLsizei count, const GLuint* textures);
+    void deleteBuffers(GLsizei count, const GLuint* buffers);
+    void deleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+    void deleteProgram(GLuint program);
+
+    // Forget everything, after code that bound things directly
+    void invalidate();
+
+    // With caching off every call is issued, for comparing against it
+    bool caching = true;
+
+    // Count issued and elided calls in counters; off, nothing is counted
+    bool counting = false;
+    GLCallCounters counters;
+
+private:
+    static const GLuint UNKNOWN = ~0u;
+    static const unsigned int TEXTURE_TARGETS = 3;
+    static const unsigned int BUFFER_TARGETS = 6;
+
+    GLuint currentProgram;
+    GLuint currentVertexArray;
+    GLuint activeUnit;
+    GLuint textures[TEXTURE_UNITS][TEXTURE_TARGETS];
+    GLuint buffers[BUFFER_TARGETS];
+    GLuint depthTest, blend, cullFace;
+    GLuint depthWrite, depthFunction;
+    GLuint blendFactors;
+
+    GLState() {
+        invalidate();
+    }
+
+    // Record value and say whether the call has to be issued
+    bool changed(GLuint& current, GLuint value) {
+        if (current == value && caching) {
+            if (counting)
+                counters.elided++;
+            return false;
+        }
+        current = value;
+        if (counting)
+            counters.issued++;
+        return true;
+    }
+
+    static int textureTarget(GLenum target);
+    static int bufferTarget(GLenum target);
+    GLuint* capability(GLenum capability);
+};
+
+#endif
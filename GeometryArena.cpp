@@ -0,0 +1,143 @@
+#include "GeometryArena.h"
+#include "VertexFormat.h"
+#include "GLState.h"
+#include <algorithm>
+#include <cstdint>
+
+// New buffers start with room for this much, and grow at least twofold
+static const size_t MIN_POOL_BYTES = 1u << 20;
+
+size_t GeometryPool::vertexSize() const {
+    return packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+size_t GeometryPool::indexSize() const {
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+GeometryArena& GeometryArena::instance() {
+    static GeometryArena arena;
+    return arena;
+}
+
+unsigned int GeometryArena::findPool(bool packed, GLenum indexType) {
+    for (unsigned int i = 0; i < pools.size(); i++) {
+        if (pools[i].packed == packed && pools[i].indexType == indexType)
+            return i;
+    }
+
+    GeometryPool pool;
+    pool.packed = packed;
+    pool.indexType = indexType;
+    glGenVertexArrays(1, &pool.VAO);
+    glGenBuffers(1, &pool.VBO);
+    glGenBuffers(1, &pool.EBO);
+
+    GLState::instance().bindVertexArray(pool.VAO);
+    GLState::instance().bindBuffer(GL_ARRAY_BUFFER, pool.VBO);
+    GLState::instance().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.EBO);
+    setupVertexAttributes(packed);
+    GLState::instance().bindVertexArray(0);
+
+    pools.push_back(pool);
+    return (unsigned int)pools.size() - 1;
+}
+
+// Reallocate buffer with capacityBytes, keeping its first usedBytes
+void GeometryArena::grow(unsigned int buffer, size_t usedBytes, size_t capacityBytes) {
+    // The copy targets leave the VAO and array buffer bindings alone
+    unsigned int temp = 0;
+    if (usedBytes > 0) {
+        glGenBuffers(1, &temp);
+        GLState::instance().bindBuffer(GL_COPY_WRITE_BUFFER, temp);
+        glBufferData(GL_COPY_WRITE_BUFFER, usedBytes, NULL, GL_STREAM_COPY);
+        GLState::instance().bindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+    }
+
+    GLState::instance().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacityBytes, NULL, GL_STATIC_DRAW);
+
+    if (usedBytes > 0) {
+        GLState::instance().bindBuffer(GL_COPY_READ_BUFFER, temp);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+        GLState::instance().deleteBuffers(1, &temp);
+    }
+}
+
+GeometryRange GeometryArena::allocate(bool packed, GLenum indexType, const void* vertices, size_t vertexCount,
+    const void* indices, size_t indexCount) {
+    GeometryRange range;
+    range.pool = findPool(packed, indexType);
+    GeometryPool& pool = pools[range.pool];
+    size_t vertexSize = pool.vertexSize(), indexSize = pool.indexSize();
+
+    if (pool.vertexCount + vertexCount > pool.vertexCapacity) {
+        size_t capacity = std::max(std::max(pool.vertexCapacity * 2, pool.vertexCount + vertexCount), MIN_POOL_BYTES / vertexSize);
+        grow(pool.VBO, pool.vertexCount * vertexSize, capacity * vertexSize);
+        pool.vertexCapacity = capacity;
+    }
+    if (pool.indexCount + indexCount > pool.indexCapacity) {
+        size_t capacity = std::max(std::max(pool.indexCapacity * 2, pool.indexCount + indexCount), MIN_POOL_BYTES / indexSize);
+        grow(pool.EBO, pool.indexCount * indexSize, capacity * indexSize);
+        pool.indexCapacity = capacity;
+    }
+
+    GLState::instance().bindBuffer(GL_COPY_WRITE_BUFFER, pool.VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, pool.vertexCount * vertexSize, vertexCount * vertexSize, vertices);
+    GLState::instance().bindBuffer(GL_COPY_WRITE_BUFFER, pool.EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, pool.indexCount * indexSize, indexCount * indexSize, indices);
+    GLState::instance().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    range.baseVertex = (GLint)pool.vertexCount;
+    range.firstIndex = (GLuint)pool.indexCount;
+    pool.vertexCount += vertexCount;
+    pool.indexCount += indexCount;
+    return range;
+}
+
+void GeometryArena::setupVertexAttributes(bool packed) {
+    if (packed) {
+        // The shader sees floats either way: normalized integers and halves are expanded
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+        return;
+    }
+
+    // vertex positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+}
+
+size_t GeometryArena::usedBytes() const {
+    size_t bytes = 0;
+    for (const GeometryPool& pool : pools)
+        bytes += pool.vertexCount * pool.vertexSize() + pool.indexCount * pool.indexSize();
+    return bytes;
+}
+
+size_t GeometryArena::capacityBytes() const {
+    size_t bytes = 0;
+    for (const GeometryPool& pool : pools)
+        bytes += pool.vertexCapacity * pool.vertexSize() + pool.indexCapacity * pool.indexSize();
+    return bytes;
+}
+
+void GeometryArena::release() {
+    for (GeometryPool& pool : pools) {
+        GLState::instance().deleteVertexArrays(1, &pool.VAO);
+        GLState::instance().deleteBuffers(1, &pool.VBO);
+        GLState::instance().deleteBuffers(1, &pool.EBO);
+    }
+    pools.clear();
+}
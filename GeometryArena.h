@@ -0,0 +1,85 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+// GL calls made by the draw paths, counted over a frame for --frame-stats
+struct DrawCounters {
+    unsigned int drawCalls = 0;
+    unsigned int vertexArrayBinds = 0;
+    unsigned int textureBinds = 0;
+    unsigned int uniformUploads = 0;
+    unsigned int bindsAvoided = 0; // program, VAO and texture binds the render queue skipped
+
+    unsigned int stateChanges() const {
+        return vertexArrayBinds + textureBinds + uniformUploads;
+    }
+};
+
+inline DrawCounters& drawCounters() {
+    static DrawCounters counters;
+    return counters;
+}
+
+// Where a mesh's vertices and indices went in the arena
+struct GeometryRange {
+    unsigned int pool = 0;
+    GLint baseVertex = 0;   // added to every index by the draw
+    GLuint firstIndex = 0;  // in indices from the start of the pool's index buffer
+};
+
+// One vertex buffer and one index buffer holding every mesh of one vertex
+// format and index type, with a VAO over both
+struct GeometryPool {
+    bool packed;
+    GLenum indexType;
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    size_t vertexCount = 0, vertexCapacity = 0;
+    size_t indexCount = 0, indexCapacity = 0;
+
+    size_t vertexSize() const;
+    size_t indexSize() const;
+};
+
+// Process-wide storage of static mesh geometry. Meshes no longer own buffers;
+// they sub-allocate ranges here and are drawn with base-vertex draws, so any
+// number of meshes of one format draw from one VAO and can be batched into a
+// multi-draw. Ranges live until release(); buffers grow by copying on the GPU
+// and keep their names, so VAOs made over them stay valid.
+class GeometryArena {
+public:
+    static GeometryArena& instance();
+
+    // GL thread: copy a mesh in. vertices are PackedVertex when packed and
+    // Vertex otherwise; indices are GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+    GeometryRange allocate(bool packed, GLenum indexType, const void* vertices, size_t vertexCount,
+        const void* indices, size_t indexCount);
+
+    const GeometryPool& pool(unsigned int index) const {
+        return pools[index];
+    }
+
+    size_t poolCount() const {
+        return pools.size();
+    }
+
+    // Per-vertex attributes 0-2 of the bound VAO, read from the bound VBO
+    static void setupVertexAttributes(bool packed);
+
+    // Bytes in use and allocated across every pool
+    size_t usedBytes() const;
+    size_t capacityBytes() const;
+
+    // GL thread: delete every buffer, before the context goes away
+    void release();
+
+private:
+    std::vector<GeometryPool> pools;
+
+    unsigned int findPool(bool packed, GLenum indexType);
+    static void grow(unsigned int buffer, size_t usedBytes, size_t capacityBytes);
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// Measures the GPU time of the commands between begin() and end() with
+// GL_TIME_ELAPSED queries. A ring of queries is kept so results are read a
+// few frames late and the CPU never waits for the GPU.
+class GpuTimer {
+public:
+    GpuTimer() {
+        glGenQueries(LATENCY, queries);
+    }
+
+    ~GpuTimer() {
+        glDeleteQueries(LATENCY, queries);
+    }
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    void begin() {
+        glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+    }
+
+    // Ends the current query and collects the oldest one if it is ready.
+    // Returns true when a new result is available from lastMs().
+    bool end() {
+        glEndQuery(GL_TIME_ELAPSED);
+        next = (next + 1) % LATENCY;
+        if (issued < LATENCY)
+            issued++;
+        if (issued < LATENCY)
+            return false;
+
+        // queries[next] is the oldest and will be reused by the next begin()
+        GLint available = 0;
+        glGetQueryObjectiv(queries[next], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return false; // the GPU is more than LATENCY frames behind; skip this sample
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[next], GL_QUERY_RESULT, &ns);
+        lastResultMs = ns / 1e6;
+        return true;
+    }
+
+    double lastMs() const {
+        return lastResultMs;
+    }
+
+private:
+    static const unsigned int LATENCY = 4;
+    GLuint queries[LATENCY];
+    unsigned int next = 0;
+    unsigned int issued = 0;
+    double lastResultMs = 0.0;
+};
+
+#endif
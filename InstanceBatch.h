@@ -0,0 +1,139 @@
+#ifndef INSTANCE_BATCH_H
+#define INSTANCE_BATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Model.h"
+#include "Frustum.h"
+#include "Shader.h"
+#include "GLState.h"
+
+// The instance matrices occupy attribute locations 3-6 (model) and 7-9
+// (normal), one per column. When no instance buffer is attached those arrays
+// are disabled and GL uses the current generic attribute value instead, which
+// is context state, so setting it to the identity once makes non-instanced
+// draws behave as before.
+inline void resetInstanceAttributes() {
+    for (unsigned int column = 0; column < 4; column++) {
+        glm::vec4 value(0.0f);
+        value[column] = 1.0f;
+        glVertexAttrib4f(3 + column, value.x, value.y, value.z, value.w);
+    }
+    for (unsigned int column = 0; column < 3; column++) {
+        glm::vec3 value(0.0f);
+        value[column] = 1.0f;
+        glVertexAttrib3f(7 + column, value.x, value.y, value.z);
+    }
+}
+
+// Many copies of one Model drawn with a single instanced draw per mesh and
+// level of detail. The transforms live in a per-instance vertex buffer instead
+// of a uniform, so the draw cost no longer grows with the number of copies.
+// GL 3.3 has no base instance, so each level gets its own instance buffer.
+class InstanceBatch {
+public:
+    InstanceBatch(const Model& model) : model(&model) {
+        levels.resize(model.getLodCount());
+        for (Level& level : levels) {
+            glGenBuffers(1, &level.instanceVBO);
+            for (const Mesh& mesh : model.getMeshes())
+                level.meshVAOs.push_back(mesh.createInstancedVAO(level.instanceVBO));
+        }
+    }
+
+    ~InstanceBatch() {
+        for (Level& level : levels) {
+            if (!level.meshVAOs.empty())
+                GLState::instance().deleteVertexArrays((GLsizei)level.meshVAOs.size(), &level.meshVAOs[0]);
+            GLState::instance().deleteBuffers(1, &level.instanceVBO);
+        }
+    }
+
+    InstanceBatch(const InstanceBatch&) = delete;
+    InstanceBatch& operator=(const InstanceBatch&) = delete;
+
+    void add(const glm::mat4& modelMatrix) {
+        InstanceData instance;
+        instance.model = modelMatrix;
+        instance.normal = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+        instances.push_back(instance);
+        lods.push_back(0);
+    }
+
+    size_t size() const {
+        return instances.size();
+    }
+
+    const Model& getModel() const {
+        return *model;
+    }
+
+    // Upload the instances whose model bounds touch the frustum and draw them,
+    // each at the level of detail lodView picks for it, or at full detail
+    // without one. The shader's model and normalMatrix uniforms must be the
+    // identity.
+    void Draw(const Shader& shader, const Frustum& frustum, CullStats& stats, const LodView* lodView = nullptr) {
+        cull(frustum, stats, lodView);
+        Draw(shader);
+    }
+
+    // The CPU half of Draw: pick the instances to draw and their levels of
+    // detail. Touches no GL, so it may run on a job.
+    void cull(const Frustum& frustum, CullStats& stats, const LodView* lodView = nullptr) {
+        unsigned int meshCount = (unsigned int)model->getMeshes().size();
+
+        for (Level& level : levels)
+            level.visible.clear();
+        size_t visibleCount = 0;
+        for (size_t i = 0; i < instances.size(); i++) {
+            const InstanceData& instance = instances[i];
+            if (!frustum.isBoxVisible(model->getBoundsMin(), model->getBoundsMax(), instance.model))
+                continue;
+            lods[i] = lodView ? model->selectLod(instance.model, *lodView, lods[i]) : 0;
+            levels[lods[i]].visible.push_back(instance);
+            visibleCount++;
+        }
+        stats.drawn += (unsigned int)visibleCount * meshCount;
+        stats.culled += (unsigned int)(instances.size() - visibleCount) * meshCount;
+        const std::vector<Mesh>& meshes = model->getMeshes();
+        for (unsigned int lod = 0; lod < levels.size(); lod++) {
+            for (const Mesh& mesh : meshes)
+                stats.triangles += (unsigned long long)mesh.getTriangleCount(lod) * levels[lod].visible.size();
+        }
+    }
+
+    // The GL half of Draw: upload and draw what the last cull() picked
+    void Draw(const Shader& shader) {
+        unsigned int meshCount = (unsigned int)model->getMeshes().size();
+        const std::vector<Mesh>& meshes = model->getMeshes();
+        for (unsigned int lod = 0; lod < levels.size(); lod++) {
+            Level& level = levels[lod];
+            if (level.visible.empty())
+                continue;
+
+            // Orphan the old storage so the driver need not wait for last frame's draws
+            GLState::instance().bindBuffer(GL_ARRAY_BUFFER, level.instanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, level.visible.size() * sizeof(InstanceData), &level.visible[0]);
+
+            for (unsigned int i = 0; i < meshCount; i++)
+                meshes[i].DrawInstanced(shader, level.meshVAOs[i], (GLsizei)level.visible.size(), lod);
+        }
+    }
+
+private:
+    // The instances drawn at one level of detail
+    struct Level {
+        std::vector<InstanceData> visible;
+        unsigned int instanceVBO;
+        std::vector<unsigned int> meshVAOs;
+    };
+
+    const Model* model;
+    std::vector<InstanceData> instances;
+    std::vector<unsigned int> lods; // last level of detail of each instance
+    std::vector<Level> levels;
+};
+
+#endif
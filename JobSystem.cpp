@@ -0,0 +1,152 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+TaskGraph::TaskId TaskGraph::add(std::function<void()> work, std::initializer_list<TaskId> after) {
+    TaskId id = (TaskId)tasks.size();
+    tasks.emplace_back();
+    tasks.back().work = std::move(work);
+    for (TaskId before : after) {
+        tasks[before].next.push_back(id);
+        tasks[id].dependencies++;
+    }
+    return id;
+}
+
+TaskGraph::TaskId TaskGraph::parallelFor(size_t count, size_t grain, std::function<void(size_t, size_t)> work,
+    std::initializer_list<TaskId> after) {
+    grain = std::max(grain, (size_t)1);
+    std::vector<TaskId> ranges;
+    for (size_t begin = 0; begin < count; begin += grain) {
+        size_t end = std::min(begin + grain, count);
+        ranges.push_back(add([work, begin, end]() { work(begin, end); }, after));
+    }
+
+    // The join runs nothing, it only waits for the ranges
+    TaskId join = add(std::function<void()>(), ranges.empty() ? after : std::initializer_list<TaskId>());
+    for (TaskId range : ranges) {
+        tasks[range].next.push_back(join);
+        tasks[join].dependencies++;
+    }
+    return join;
+}
+
+const unsigned int JobSystem::MAX_WORKERS;
+
+JobSystem::JobSystem(unsigned int workerCount) {
+    workerCount = std::min(std::max(workerCount, 1u), MAX_WORKERS);
+    for (unsigned int i = 0; i < workerCount; i++)
+        queues.emplace_back(new Queue());
+    for (unsigned int i = 1; i < workerCount; i++)
+        threads.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void JobSystem::run(TaskGraph& tasks) {
+    size_t count = tasks.tasks.size();
+    if (count == 0)
+        return;
+
+    graph = &tasks;
+    waiting.reset(new std::atomic<unsigned int>[count]);
+    for (size_t i = 0; i < count; i++)
+        waiting[i] = tasks.tasks[i].dependencies;
+    remaining = count;
+
+    // Spread the tasks that are ready at once over every thread's deque
+    unsigned int next = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (tasks.tasks[i].dependencies == 0) {
+            push(next, (TaskId)i);
+            next = (next + 1) % workerCount();
+        }
+    }
+
+    // The caller works too until the last task is done
+    while (remaining > 0) {
+        TaskId task;
+        if (take(0, task)) {
+            execute(0, task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait(lock, [this] { return queued > 0 || remaining == 0; });
+    }
+    graph = nullptr;
+}
+
+void JobSystem::workerLoop(unsigned int index) {
+    for (;;) {
+        TaskId task;
+        if (take(index, task)) {
+            execute(index, task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping)
+            return;
+    }
+}
+
+void JobSystem::push(unsigned int queue, TaskId task) {
+    // Counted before it is queued, so the count never runs below the deques
+    queued++;
+    {
+        std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+        queues[queue]->tasks.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wake.notify_one();
+}
+
+bool JobSystem::take(unsigned int queue, TaskId& task) {
+    {
+        Queue& own = *queues[queue];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    for (unsigned int i = 1; i < workerCount(); i++) {
+        Queue& victim = *queues[(queue + i) % workerCount()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            queued--;
+            stolen++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(unsigned int queue, TaskId task) {
+    const TaskGraph::Task& entry = graph->tasks[task];
+    if (entry.work)
+        entry.work();
+    for (TaskId next : entry.next) {
+        if (waiting[next].fetch_sub(1) == 1)
+            push(queue, next);
+    }
+    if (remaining.fetch_sub(1) == 1) {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+        }
+        wake.notify_all();
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The CPU work of a frame as tasks and the order they must run in. A task
+// runs once every task it comes after has finished; tasks with nothing
+// between them may run at the same time on different threads. Build the
+// graph, hand it to JobSystem::run, and reuse it by clearing it.
+class TaskGraph {
+public:
+    using TaskId = unsigned int;
+
+    // Add work to run after every task in after
+    TaskId add(std::function<void()> work, std::initializer_list<TaskId> after = {});
+
+    // Split [0, count) into ranges of at most grain items and add a task
+    // calling work(begin, end) for each. Returns a task that finishes when
+    // they all have, to come after.
+    TaskId parallelFor(size_t count, size_t grain, std::function<void(size_t, size_t)> work,
+        std::initializer_list<TaskId> after = {});
+
+    void clear() {
+        tasks.clear();
+    }
+
+    size_t size() const {
+        return tasks.size();
+    }
+
+private:
+    friend class JobSystem;
+
+    struct Task {
+        std::function<void()> work;
+        std::vector<TaskId> next;         // tasks that come after this one
+        unsigned int dependencies = 0;    // tasks this one comes after
+    };
+
+    std::vector<Task> tasks;
+};
+
+// Runs task graphs on a fixed set of threads: the one calling run() and
+// workerCount - 1 workers, so one worker runs everything on the caller.
+// Each thread keeps its ready tasks in its own deque, working from the back
+// of it, newest first, while idle threads steal from the front of the
+// others'. A finished task makes the tasks after it ready on the thread that
+// ran it. Tasks must not touch GL, and run() must only be called by one
+// thread at a time.
+class JobSystem {
+public:
+    explicit JobSystem(unsigned int workerCount = std::thread::hardware_concurrency());
+    ~JobSystem();
+
+    // More threads than this only contend for the deques
+    static const unsigned int MAX_WORKERS = 64;
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Run every task of graph and return when they have all finished
+    void run(TaskGraph& graph);
+
+    unsigned int workerCount() const {
+        return (unsigned int)queues.size();
+    }
+
+    // Tasks taken from another thread's deque since construction
+    unsigned long long steals() const {
+        return stolen;
+    }
+
+private:
+    using TaskId = TaskGraph::TaskId;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<TaskId> tasks;
+    };
+
+    // One per thread, the caller's first
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    // The graph being run and what is left of it
+    TaskGraph* graph = nullptr;
+    std::unique_ptr<std::atomic<unsigned int>[]> waiting; // unfinished dependencies per task
+    std::atomic<size_t> remaining{ 0 };
+
+    // Sleeping threads wake when tasks are queued or the graph is done
+    std::atomic<size_t> queued{ 0 };
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::atomic<unsigned long long> stolen{ 0 };
+
+    void workerLoop(unsigned int index);
+    void push(unsigned int queue, TaskId task);
+    bool take(unsigned int queue, TaskId& task);
+    void execute(unsigned int queue, TaskId task);
+};
+
+#endif
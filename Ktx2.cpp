@@ -0,0 +1,196 @@
+#include "Ktx2.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const char SOURCE_KEY[] = "TPsource";
+
+struct Ktx2Header {
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must be 80 bytes");
+
+struct Ktx2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+struct Ktx2SourceStamp {
+    uint64_t size;
+    int64_t time;
+    uint64_t contentHash;
+};
+
+Ktx2Texture::Ktx2Texture() = default;
+Ktx2Texture::~Ktx2Texture() = default;
+
+std::string ktx2Path(const std::string& sourcePath) {
+    return sourcePath + ".ktx2";
+}
+
+// Multiply-xor hash of the format, size and every level, eight bytes at a time
+static uint64_t hashLevels(const CompressedImage& image) {
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = (hash ^ (uint32_t)image.format) * prime;
+    hash = (hash ^ image.levels[0].width) * prime;
+    hash = (hash ^ image.levels[0].height) * prime;
+    for (const CompressedImage::Level& level : image.levels) {
+        const uint8_t* data = level.data.data();
+        size_t i = 0;
+        for (; i + 8 <= level.data.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            hash = (hash ^ word) * prime;
+            hash ^= hash >> 29;
+        }
+        for (; i < level.data.size(); i++)
+            hash = (hash ^ data[i]) * prime;
+    }
+    return hash;
+}
+
+static uint32_t alignTo(uint32_t offset, uint32_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool readKtx2(const std::string& sourcePath, Ktx2Texture& texture) {
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!fileStamp(sourcePath, sourceSize, sourceTime))
+        return false;
+
+    std::unique_ptr<MappedFile> file(new MappedFile(ktx2Path(sourcePath)));
+    if (!file->data || file->size < sizeof(Ktx2Header))
+        return false;
+
+    Ktx2Header header;
+    std::memcpy(&header, file->data, sizeof(header));
+    BlockFormat format = (BlockFormat)header.vkFormat;
+    if (std::memcmp(header.identifier, KTX2_IDENTIFIER, 12) != 0 || blockBytes(format) == 0 ||
+        header.pixelDepth != 0 || header.faceCount != 1 || header.levelCount == 0 || header.levelCount > 32 ||
+        header.supercompressionScheme != 0 ||
+        sizeof(Ktx2Header) + (uint64_t)header.levelCount * sizeof(Ktx2LevelIndex) > file->size ||
+        (uint64_t)header.kvdByteOffset + header.kvdByteLength > file->size)
+        return false;
+
+    // The source stamp must match, or the file is stale
+    bool fresh = false;
+    uint32_t offset = header.kvdByteOffset, end = header.kvdByteOffset + header.kvdByteLength;
+    while (offset + 4 <= end) {
+        uint32_t length;
+        std::memcpy(&length, file->data + offset, 4);
+        if (length > end - offset - 4)
+            break;
+        const char* entry = (const char*)file->data + offset + 4;
+        if (length == sizeof(SOURCE_KEY) + sizeof(Ktx2SourceStamp) && std::memcmp(entry, SOURCE_KEY, sizeof(SOURCE_KEY)) == 0) {
+            Ktx2SourceStamp stamp;
+            std::memcpy(&stamp, entry + sizeof(SOURCE_KEY), sizeof(stamp));
+            fresh = stamp.size == sourceSize && stamp.time == sourceTime;
+            texture.contentHash = stamp.contentHash;
+        }
+        offset = alignTo(offset + 4 + length, 4);
+    }
+    if (!fresh)
+        return false;
+
+    const Ktx2LevelIndex* index = (const Ktx2LevelIndex*)(file->data + sizeof(Ktx2Header));
+    unsigned int bytes = blockBytes(format);
+    texture.levels.resize(header.levelCount);
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        Ktx2Texture::Level& level = texture.levels[i];
+        level.width = header.pixelWidth >> i ? header.pixelWidth >> i : 1;
+        level.height = header.pixelHeight >> i ? header.pixelHeight >> i : 1;
+        level.size = (size_t)index[i].byteLength;
+        uint64_t expected = (uint64_t)((level.width + 3) / 4) * ((level.height + 3) / 4) * bytes;
+        if (index[i].byteOffset + index[i].byteLength > file->size || index[i].byteLength != expected)
+            return false;
+        level.data = file->data + index[i].byteOffset;
+    }
+
+    texture.format = format;
+    texture.width = header.pixelWidth;
+    texture.height = header.pixelHeight;
+    texture.file = std::move(file);
+    return true;
+}
+
+bool writeKtx2(const std::string& sourcePath, const CompressedImage& image) {
+    if (image.levels.empty())
+        return false;
+
+    Ktx2SourceStamp stamp;
+    if (!fileStamp(sourcePath, stamp.size, stamp.time))
+        return false;
+    stamp.contentHash = hashLevels(image);
+
+    uint32_t levelCount = (uint32_t)image.levels.size();
+    Ktx2Header header = {};
+    std::memcpy(header.identifier, KTX2_IDENTIFIER, 12);
+    header.vkFormat = (uint32_t)image.format;
+    header.typeSize = 1;
+    header.pixelWidth = image.levels[0].width;
+    header.pixelHeight = image.levels[0].height;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+
+    // Key/value data: one entry, padded to 4 bytes
+    uint32_t entryLength = (uint32_t)(sizeof(SOURCE_KEY) + sizeof(stamp));
+    header.kvdByteOffset = (uint32_t)(sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex));
+    header.kvdByteLength = alignTo(4 + entryLength, 4);
+
+    // Level data follows, smallest level first, each aligned to its block size
+    uint32_t alignment = blockBytes(image.format);
+    std::vector<Ktx2LevelIndex> index(levelCount);
+    uint32_t offset = header.kvdByteOffset + header.kvdByteLength;
+    for (uint32_t i = levelCount; i-- > 0;) {
+        offset = alignTo(offset, alignment);
+        index[i].byteOffset = offset;
+        index[i].byteLength = index[i].uncompressedByteLength = image.levels[i].data.size();
+        offset += (uint32_t)image.levels[i].data.size();
+    }
+
+    // Write to a temporary file first so a crash never leaves a truncated file
+    std::string path = ktx2Path(sourcePath);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        static const char padding[16] = {};
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)index.data(), index.size() * sizeof(Ktx2LevelIndex));
+        out.write((const char*)&entryLength, 4);
+        out.write(SOURCE_KEY, sizeof(SOURCE_KEY));
+        out.write((const char*)&stamp, sizeof(stamp));
+        out.write(padding, header.kvdByteLength - 4 - entryLength);
+        for (uint32_t i = levelCount; i-- > 0;) {
+            out.write(padding, index[i].byteOffset - (uint64_t)out.tellp());
+            out.write((const char*)image.levels[i].data.data(), image.levels[i].data.size());
+        }
+        if (!out)
+            return false;
+    }
+
+    std::remove(path.c_str());
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,54 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BlockCompression.h"
+
+class MappedFile;
+
+// Baked compressed textures. Each source image gets a KTX2 file next to it
+// (e.g. diffuse.png -> diffuse.png.ktx2) holding its block-compressed mip
+// chain. Only what the game writes is supported: one 2D image, BC formats,
+// no supercompression. The data format descriptor is left out; the source
+// file's size and modification time are stored as the "TPsource" key/value
+// entry so stale files are ignored, as with the mesh cache, along with a hash
+// of the blocks so loading never has to read them to share identical images.
+
+struct Ktx2Texture {
+    struct Level {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        const uint8_t* data = nullptr; // inside the mapped file
+        size_t size = 0;
+    };
+
+    BlockFormat format = BlockFormat::BC1;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<Level> levels; // level 0 first
+    uint64_t contentHash = 0;  // of every level, computed when baked
+
+    Ktx2Texture();
+    ~Ktx2Texture();
+    Ktx2Texture(const Ktx2Texture&) = delete;
+    Ktx2Texture& operator=(const Ktx2Texture&) = delete;
+
+    // Keeps the level data readable until the texture is destroyed
+    std::unique_ptr<MappedFile> file;
+};
+
+// Path of the compressed file for a source image
+std::string ktx2Path(const std::string& sourcePath);
+
+// Map the compressed file of sourcePath. Fails if it is missing, malformed
+// or older than the source.
+bool readKtx2(const std::string& sourcePath, Ktx2Texture& texture);
+
+// Write the compressed file of sourcePath
+bool writeKtx2(const std::string& sourcePath, const CompressedImage& image);
+
+#endif
@@ -1,22 +1,43 @@
 #include "Light.h"
 
-void PointLight::apply(Shader& shader, const std::string& uniformName) {
-    shader.setVec3(uniformName + ".position", position);
-    shader.setVec3(uniformName + ".color", color * intensity);
-    shader.setFloat(uniformName + ".constant", constant);
-    shader.setFloat(uniformName + ".linear", linear);
-    shader.setFloat(uniformName + ".quadratic", quadratic);
+void PointLight::bind(const Shader& shader, const std::string& uniformName) {
+    positionLoc = shader.uniform<glm::vec3>(uniformName + ".position");
+    colorLoc = shader.uniform<glm::vec3>(uniformName + ".color");
+    constantLoc = shader.uniform<float>(uniformName + ".constant");
+    linearLoc = shader.uniform<float>(uniformName + ".linear");
+    quadraticLoc = shader.uniform<float>(uniformName + ".quadratic");
 }
 
-void DirectionalLight::apply(Shader& shader, const std::string& uniformName) {
-    shader.setVec3(uniformName + ".direction", direction);
-    shader.setVec3(uniformName + ".color", color * intensity);
+void PointLight::apply(const Shader& shader) const {
+    shader.set(positionLoc, position);
+    shader.set(colorLoc, color * intensity);
+    shader.set(constantLoc, constant);
+    shader.set(linearLoc, linear);
+    shader.set(quadraticLoc, quadratic);
 }
 
-void SpotLight::apply(Shader& shader, const std::string& uniformName) {
-    shader.setVec3(uniformName + ".position", position);
-    shader.setVec3(uniformName + ".direction", direction);
-    shader.setVec3(uniformName + ".color", color * intensity);
-    shader.setFloat(uniformName + ".cutOff", glm::cos(glm::radians(cutOff)));
-    shader.setFloat(uniformName + ".outerCutOff", glm::cos(glm::radians(outerCutOff)));
+void DirectionalLight::bind(const Shader& shader, const std::string& uniformName) {
+    directionLoc = shader.uniform<glm::vec3>(uniformName + ".direction");
+    colorLoc = shader.uniform<glm::vec3>(uniformName + ".color");
+}
+
+void DirectionalLight::apply(const Shader& shader) const {
+    shader.set(directionLoc, direction);
+    shader.set(colorLoc, color * intensity);
+}
+
+void SpotLight::bind(const Shader& shader, const std::string& uniformName) {
+    positionLoc = shader.uniform<glm::vec3>(uniformName + ".position");
+    directionLoc = shader.uniform<glm::vec3>(uniformName + ".direction");
+    colorLoc = shader.uniform<glm::vec3>(uniformName + ".color");
+    cutOffLoc = shader.uniform<float>(uniformName + ".cutOff");
+    outerCutOffLoc = shader.uniform<float>(uniformName + ".outerCutOff");
+}
+
+void SpotLight::apply(const Shader& shader) const {
+    shader.set(positionLoc, position);
+    shader.set(directionLoc, direction);
+    shader.set(colorLoc, color * intensity);
+    shader.set(cutOffLoc, glm::cos(glm::radians(cutOff)));
+    shader.set(outerCutOffLoc, glm::cos(glm::radians(outerCutOff)));
 }
@@ -14,7 +14,10 @@ public:
     Light(const glm::vec3& position, const glm::vec3& color, float intensity)
         : position(position), color(color), intensity(intensity) {}
 
-    virtual void apply(Shader& shader, const std::string& uniformName) = 0;
+    // Resolve the uniform handles of the struct named uniformName once
+    virtual void bind(const Shader& shader, const std::string& uniformName) = 0;
+    // Upload the light through the handles resolved by bind()
+    virtual void apply(const Shader& shader) const = 0;
 };
 
 class PointLight : public Light {
@@ -28,7 +31,12 @@ public:
         : Light(position, color, intensity),
         constant(constant), linear(linear), quadratic(quadratic) {}
 
-    void apply(Shader& shader, const std::string& uniformName) override;
+    void bind(const Shader& shader, const std::string& uniformName) override;
+    void apply(const Shader& shader) const override;
+
+private:
+    UniformHandle<glm::vec3> positionLoc, colorLoc;
+    UniformHandle<float> constantLoc, linearLoc, quadraticLoc;
 };
 
 class DirectionalLight : public Light {
@@ -38,7 +46,11 @@ public:
     DirectionalLight(const glm::vec3& direction, const glm::vec3& color, float intensity)
         : Light(glm::vec3(0.0f), color, intensity), direction(direction) {}
 
-    void apply(Shader& shader, const std::string& uniformName) override;
+    void bind(const Shader& shader, const std::string& uniformName) override;
+    void apply(const Shader& shader) const override;
+
+private:
+    UniformHandle<glm::vec3> directionLoc, colorLoc;
 };
 
 class SpotLight : public Light {
@@ -52,7 +64,12 @@ public:
         : Light(position, color, intensity),
         direction(direction), cutOff(cutOff), outerCutOff(outerCutOff) {}
 
-    void apply(Shader& shader, const std::string& uniformName) override;
+    void bind(const Shader& shader, const std::string& uniformName) override;
+    void apply(const Shader& shader) const override;
+
+private:
+    UniformHandle<glm::vec3> positionLoc, directionLoc, colorLoc;
+    UniformHandle<float> cutOffLoc, outerCutOffLoc;
 };
 
 #endif
@@ -0,0 +1,315 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+static_assert(sizeof(Vertex) == 32, "Vertex must be tightly packed to be baked");
+
+static uint64_t alignTo(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+std::string meshCachePath(const std::string& sourcePath) {
+    return sourcePath + ".meshcache";
+}
+
+// The JSON string starting at the quote at pos, with escapes dropped; pos
+// ends past the closing quote
+static std::string readJsonString(const std::string& text, size_t& pos) {
+    std::string value;
+    for (pos++; pos < text.size() && text[pos] != '"'; pos++) {
+        if (text[pos] == '\\' && pos + 1 < text.size())
+            pos++;
+        value += text[pos];
+    }
+    pos++;
+    return value;
+}
+
+// A URI with its %XX escapes decoded, as a file name
+static std::string decodeUri(const std::string& uri) {
+    std::string path;
+    for (size_t i = 0; i < uri.size(); i++) {
+        if (uri[i] == '%' && i + 2 < uri.size()) {
+            path += (char)std::strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16);
+            i += 2;
+        }
+        else {
+            path += uri[i];
+        }
+    }
+    return path;
+}
+
+// Files of the external buffers a .gltf references, relative to it. Buffers
+// embedded as data: URIs and other formats have none.
+static std::vector<std::string> gltfBufferFiles(const std::string& sourcePath) {
+    std::vector<std::string> files;
+    if (sourcePath.size() < 5 || sourcePath.compare(sourcePath.size() - 5, 5, ".gltf") != 0)
+        return files;
+    std::ifstream in(sourcePath, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    // Find the "buffers" array, then the "uri" of each object in it
+    size_t pos = 0;
+    for (;;) {
+        pos = text.find("\"buffers\"", pos);
+        if (pos == std::string::npos)
+            return files;
+        pos = text.find_first_not_of(" \t\r\n", pos + 9);
+        if (pos != std::string::npos && text[pos] == ':')
+            break;
+    }
+    pos = text.find_first_not_of(" \t\r\n", pos + 1);
+    if (pos == std::string::npos || text[pos] != '[')
+        return files;
+
+    std::string directory = sourcePath.substr(0, sourcePath.find_last_of('/') + 1);
+    int depth = 0;
+    while (pos < text.size()) {
+        char c = text[pos];
+        if (c == '"') {
+            std::string key = readJsonString(text, pos);
+            size_t colon = text.find_first_not_of(" \t\r\n", pos);
+            if (depth != 2 || key != "uri" || colon == std::string::npos || text[colon] != ':')
+                continue;
+            pos = text.find_first_not_of(" \t\r\n", colon + 1);
+            if (pos == std::string::npos || text[pos] != '"')
+                return files;
+            std::string uri = readJsonString(text, pos);
+            if (uri.compare(0, 5, "data:") != 0)
+                files.push_back(directory + decodeUri(uri));
+            continue;
+        }
+        if (c == '[' || c == '{')
+            depth++;
+        else if ((c == ']' || c == '}') && --depth == 0)
+            break;
+        pos++;
+    }
+    return files;
+}
+
+// Hash of the size and modification time of every external buffer of
+// sourcePath; false if one is missing
+static bool buffersStamp(const std::string& sourcePath, uint64_t& stamp) {
+    const uint64_t prime = 0x100000001b3ULL;
+    stamp = 0xcbf29ce484222325ULL;
+    for (const std::string& file : gltfBufferFiles(sourcePath)) {
+        uint64_t size;
+        int64_t time;
+        if (!fileStamp(file, size, time))
+            return false;
+        for (char c : file)
+            stamp = (stamp ^ (unsigned char)c) * prime;
+        stamp = (stamp ^ size) * prime;
+        stamp = (stamp ^ (uint64_t)time) * prime;
+    }
+    return true;
+}
+
+bool readMeshCache(const std::string& sourcePath, ModelData& data) {
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceBuffers;
+    if (!fileStamp(sourcePath, sourceSize, sourceTime) || !buffersStamp(sourcePath, sourceBuffers))
+        return false;
+
+    MappedFile file(meshCachePath(sourcePath));
+    if (!file.data || file.size < sizeof(MeshCacheHeader))
+        return false;
+
+    MeshCacheHeader header;
+    std::memcpy(&header, file.data, sizeof(header));
+    if (std::memcmp(header.magic, "TPMC", 4) != 0 || header.version != MESH_CACHE_VERSION ||
+        header.vertexSize != sizeof(Vertex) ||
+        header.sourceSize != sourceSize || header.sourceTime != sourceTime || header.buffersStamp != sourceBuffers)
+        return false;
+
+    // Every table must lie inside the file before anything is read from it
+    uint64_t meshTable = sizeof(MeshCacheHeader);
+    uint64_t lodTable = meshTable + (uint64_t)header.meshCount * sizeof(MeshCacheMesh);
+    uint64_t textureTable = lodTable + (uint64_t)header.lodCount * sizeof(MeshCacheLod);
+    uint64_t imageTable = textureTable + (uint64_t)header.textureCount * sizeof(MeshCacheTexture);
+    uint64_t stringData = imageTable + (uint64_t)header.imageCount * sizeof(MeshCacheImage);
+    if (stringData > file.size)
+        return false;
+
+    const MeshCacheMesh* meshes = (const MeshCacheMesh*)(file.data + meshTable);
+    const MeshCacheLod* lods = (const MeshCacheLod*)(file.data + lodTable);
+    const MeshCacheTexture* textures = (const MeshCacheTexture*)(file.data + textureTable);
+    const MeshCacheImage* images = (const MeshCacheImage*)(file.data + imageTable);
+
+    ModelData result;
+    result.directory = sourcePath.substr(0, sourcePath.find_last_of('/'));
+
+    result.images.resize(header.imageCount);
+    for (uint32_t i = 0; i < header.imageCount; i++) {
+        if (stringData + images[i].pathOffset + images[i].pathLength > file.size)
+            return false;
+        result.images[i].path.assign((const char*)file.data + stringData + images[i].pathOffset, images[i].pathLength);
+    }
+
+    result.meshes.resize(header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+        const MeshCacheMesh& mesh = meshes[i];
+        if (mesh.vertexOffset + (uint64_t)mesh.vertexCount * sizeof(Vertex) > file.size ||
+            mesh.indexOffset + (uint64_t)mesh.indexCount * sizeof(uint32_t) > file.size ||
+            (uint64_t)mesh.firstTexture + mesh.textureCount > header.textureCount ||
+            (uint64_t)mesh.firstLod + mesh.lodCount > header.lodCount)
+            return false;
+
+        // Whole blobs are copied at once; there is no per-vertex work
+        MeshData& meshData = result.meshes[i];
+        const Vertex* vertices = (const Vertex*)(file.data + mesh.vertexOffset);
+        const uint32_t* indices = (const uint32_t*)(file.data + mesh.indexOffset);
+        meshData.vertices.assign(vertices, vertices + mesh.vertexCount);
+        meshData.indices.assign(indices, indices + mesh.indexCount);
+        meshData.boundsMin = glm::vec3(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+        meshData.boundsMax = glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]);
+
+        for (uint32_t l = 0; l < mesh.lodCount; l++) {
+            const MeshCacheLod& lod = lods[mesh.firstLod + l];
+            if (lod.indexOffset + (uint64_t)lod.indexCount * sizeof(uint32_t) > file.size)
+                return false;
+            const uint32_t* lodIndices = (const uint32_t*)(file.data + lod.indexOffset);
+            MeshLod meshLod;
+            meshLod.indices.assign(lodIndices, lodIndices + lod.indexCount);
+            meshLod.error = lod.error;
+            meshData.lods.push_back(std::move(meshLod));
+        }
+
+        for (uint32_t t = 0; t < mesh.textureCount; t++) {
+            const MeshCacheTexture& texture = textures[mesh.firstTexture + t];
+            if (texture.image >= header.imageCount)
+                return false;
+            meshData.textures.push_back({ texture.type == CACHE_TEXTURE_SPECULAR ? "texture_specular" : "texture_diffuse", texture.image });
+        }
+    }
+
+    data = std::move(result);
+    return true;
+}
+
+bool writeMeshCache(const std::string& sourcePath, const ModelData& data) {
+    MeshCacheHeader header;
+    std::memcpy(header.magic, "TPMC", 4);
+    header.version = MESH_CACHE_VERSION;
+    if (!fileStamp(sourcePath, header.sourceSize, header.sourceTime) || !buffersStamp(sourcePath, header.buffersStamp))
+        return false;
+    header.meshCount = (uint32_t)data.meshes.size();
+    header.lodCount = 0;
+    header.textureCount = 0;
+    header.imageCount = (uint32_t)data.images.size();
+    header.vertexSize = sizeof(Vertex);
+
+    std::vector<MeshCacheTexture> textures;
+    for (const MeshData& mesh : data.meshes) {
+        for (const TextureRef& ref : mesh.textures)
+            textures.push_back({ ref.type == "texture_specular" ? (uint32_t)CACHE_TEXTURE_SPECULAR : (uint32_t)CACHE_TEXTURE_DIFFUSE, ref.image });
+    }
+    header.textureCount = (uint32_t)textures.size();
+
+    std::string strings;
+    std::vector<MeshCacheImage> images;
+    for (const ImageData& image : data.images) {
+        images.push_back({ (uint32_t)strings.size(), (uint32_t)image.path.size() });
+        strings += image.path;
+    }
+
+    // Lay out the blobs after the tables
+    for (const MeshData& mesh : data.meshes)
+        header.lodCount += (uint32_t)mesh.lods.size();
+    uint64_t offset = sizeof(MeshCacheHeader) + data.meshes.size() * sizeof(MeshCacheMesh) +
+        header.lodCount * sizeof(MeshCacheLod) + textures.size() * sizeof(MeshCacheTexture) +
+        images.size() * sizeof(MeshCacheImage) + strings.size();
+    std::vector<MeshCacheMesh> meshes;
+    std::vector<MeshCacheLod> lods;
+    uint32_t firstTexture = 0;
+    for (const MeshData& mesh : data.meshes) {
+        MeshCacheMesh entry;
+        entry.vertexOffset = offset = alignTo(offset, 16);
+        offset += mesh.vertices.size() * sizeof(Vertex);
+        entry.indexOffset = offset = alignTo(offset, 16);
+        offset += mesh.indices.size() * sizeof(uint32_t);
+        entry.vertexCount = (uint32_t)mesh.vertices.size();
+        entry.indexCount = (uint32_t)mesh.indices.size();
+        entry.firstTexture = firstTexture;
+        entry.textureCount = (uint32_t)mesh.textures.size();
+        entry.firstLod = (uint32_t)lods.size();
+        entry.lodCount = (uint32_t)mesh.lods.size();
+        for (const MeshLod& lod : mesh.lods) {
+            MeshCacheLod lodEntry;
+            lodEntry.indexOffset = offset = alignTo(offset, 16);
+            offset += lod.indices.size() * sizeof(uint32_t);
+            lodEntry.indexCount = (uint32_t)lod.indices.size();
+            lodEntry.error = lod.error;
+            lods.push_back(lodEntry);
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            entry.boundsMin[axis] = mesh.boundsMin[axis];
+            entry.boundsMax[axis] = mesh.boundsMax[axis];
+        }
+        firstTexture += entry.textureCount;
+        meshes.push_back(entry);
+    }
+
+    // Write to a temporary file first so a crash never leaves a truncated cache
+    std::string path = meshCachePath(sourcePath);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)meshes.data(), meshes.size() * sizeof(MeshCacheMesh));
+        out.write((const char*)lods.data(), lods.size() * sizeof(MeshCacheLod));
+        out.write((const char*)textures.data(), textures.size() * sizeof(MeshCacheTexture));
+        out.write((const char*)images.data(), images.size() * sizeof(MeshCacheImage));
+        out.write(strings.data(), strings.size());
+
+        static const char padding[16] = {};
+        for (size_t i = 0; i < data.meshes.size(); i++) {
+            const MeshData& mesh = data.meshes[i];
+            out.write(padding, meshes[i].vertexOffset - (uint64_t)out.tellp());
+            out.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            out.write(padding, meshes[i].indexOffset - (uint64_t)out.tellp());
+            out.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+            for (uint32_t l = 0; l < meshes[i].lodCount; l++) {
+                const MeshCacheLod& lod = lods[meshes[i].firstLod + l];
+                out.write(padding, lod.indexOffset - (uint64_t)out.tellp());
+                out.write((const char*)mesh.lods[l].indices.data(), lod.indexCount * sizeof(uint32_t));
+            }
+        }
+        if (!out)
+            return false;
+    }
+
+    std::remove(path.c_str());
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+bool loadModelData(const std::string& path, ModelData& data) {
+    if (readMeshCache(path, data))
+        return true;
+
+    if (!parseModel(path, data))
+        return false;
+    optimizeModel(data);
+    generateLods(data);
+
+    if (writeMeshCache(path, data))
+        std::cout << "Baked mesh cache " << meshCachePath(path) << std::endl;
+    else
+        std::cout << "ERROR::MESH_CACHE::WRITE_FAILED: " << meshCachePath(path) << std::endl;
+    return true;
+}
@@ -0,0 +1,90 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include "ModelData.h"
+
+// Baked mesh cache. A model's meshes are stored next to the source file
+// (e.g. scene.gltf -> scene.gltf.meshcache) in a compact binary format that is
+// memory mapped and copied straight into ModelData, skipping Assimp.
+//
+// File layout, all offsets in bytes from the start of the file:
+//   MeshCacheHeader
+//   MeshCacheMesh[meshCount]
+//   MeshCacheLod[lodCount]
+//   MeshCacheTexture[textureCount]
+//   MeshCacheImage[imageCount]
+//   string data (image paths, not terminated)
+//   vertex blobs (Vertex, 16-byte aligned) and index blobs (uint32), each
+//   mesh's level of detail index blobs following its own
+
+// 3: meshes are stored after optimizeModel
+// 4: levels of detail from generateLods
+// 5: stamps of the external buffers of a .gltf
+const uint32_t MESH_CACHE_VERSION = 5;
+
+struct MeshCacheHeader {
+    char magic[4];          // "TPMC"
+    uint32_t version;       // MESH_CACHE_VERSION
+    uint64_t sourceSize;    // size and modification time of the source model,
+    int64_t sourceTime;     // used to detect a stale cache
+    uint64_t buffersStamp;  // hash of the size and time of every external
+                            // buffer a .gltf references, as re-exporting
+                            // the .bin can leave the .gltf unchanged
+    uint32_t meshCount;
+    uint32_t lodCount;
+    uint32_t textureCount;
+    uint32_t imageCount;
+    uint32_t vertexSize;    // sizeof(Vertex) when baked
+};
+
+struct MeshCacheMesh {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;  // into the MeshCacheTexture table
+    uint32_t textureCount;
+    uint32_t firstLod;      // into the MeshCacheLod table
+    uint32_t lodCount;
+    float boundsMin[3];     // model-space AABB
+    float boundsMax[3];
+};
+
+struct MeshCacheLod {
+    uint64_t indexOffset;
+    uint32_t indexCount;
+    float error;            // MeshLod::error
+};
+
+enum MeshCacheTextureType : uint32_t {
+    CACHE_TEXTURE_DIFFUSE = 0,
+    CACHE_TEXTURE_SPECULAR = 1
+};
+
+struct MeshCacheTexture {
+    uint32_t type;          // MeshCacheTextureType
+    uint32_t image;
+};
+
+struct MeshCacheImage {
+    uint32_t pathOffset;    // into the string data
+    uint32_t pathLength;
+};
+
+// Path of the cache file for a source model
+std::string meshCachePath(const std::string& sourcePath);
+
+// Load the cache of sourcePath into data. Fails if the cache is missing,
+// from another version or older than the source or its buffers.
+bool readMeshCache(const std::string& sourcePath, ModelData& data);
+
+// Write the cache of sourcePath from data (images are stored by path only)
+bool writeMeshCache(const std::string& sourcePath, const ModelData& data);
+
+// Load a model's meshes, from the cache when it is fresh, otherwise with
+// Assimp, optimizeModel and generateLods, writing a new cache for the next run
+bool loadModelData(const std::string& path, ModelData& data);
+
+#endif
@@ -0,0 +1,299 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+// Forsyth's scoring: recently used vertices score high, except the last
+// triangle's own, and vertices with few triangles left get a boost so they
+// are finished off instead of being left as stragglers
+static const int SCORE_CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static const unsigned int VALENCE_TABLE_SIZE = 64;
+
+static float computeVertexScore(int cachePosition, unsigned int trianglesLeft) {
+    if (trianglesLeft == 0)
+        return -1.0f; // no triangle needs it any more
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3)
+            score = LAST_TRIANGLE_SCORE;
+        else {
+            float scaled = 1.0f - (float)(cachePosition - 3) / (SCORE_CACHE_SIZE - 3);
+            score = std::pow(scaled, CACHE_DECAY_POWER);
+        }
+    }
+    return score + VALENCE_BOOST_SCALE * std::pow((float)trianglesLeft, -VALENCE_BOOST_POWER);
+}
+
+// Scores for every cache position (and none) and common triangle counts, so
+// the inner loop does no pow calls
+static float vertexScore(int cachePosition, unsigned int trianglesLeft) {
+    struct Table {
+        float scores[SCORE_CACHE_SIZE + 1][VALENCE_TABLE_SIZE];
+        Table() {
+            for (int position = -1; position < SCORE_CACHE_SIZE; position++) {
+                for (unsigned int valence = 0; valence < VALENCE_TABLE_SIZE; valence++)
+                    scores[position + 1][valence] = computeVertexScore(position, valence);
+            }
+        }
+    };
+    static const Table table;
+    if (trianglesLeft < VALENCE_TABLE_SIZE)
+        return table.scores[cachePosition + 1][trianglesLeft];
+    return computeVertexScore(cachePosition, trianglesLeft);
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize) {
+    VertexCacheStats stats;
+    if (indices.empty() || vertexCount == 0)
+        return stats;
+
+    // A vertex is in the FIFO if it entered within the last cacheSize misses
+    std::vector<unsigned int> enteredAt(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    unsigned int misses = 0, usedCount = 0;
+    for (unsigned int index : indices) {
+        if (!used[index]) {
+            used[index] = true;
+            usedCount++;
+        }
+        if (enteredAt[index] == 0 || misses - enteredAt[index] + 1 > cacheSize) {
+            misses++;
+            enteredAt[index] = misses;
+        }
+    }
+    stats.acmr = (float)misses / (indices.size() / 3);
+    stats.atvr = (float)misses / usedCount;
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Triangles of each vertex, as offsets into one array
+    std::vector<unsigned int> trianglesLeft(vertexCount, 0);
+    for (unsigned int index : indices)
+        trianglesLeft[index]++;
+    std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] = firstTriangle[v] + trianglesLeft[v];
+    std::vector<unsigned int> vertexTriangles(indices.size());
+    std::vector<unsigned int> filled(vertexCount, 0);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[t * 3 + k];
+            vertexTriangles[firstTriangle[v] + filled[v]++] = (unsigned int)t;
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, trianglesLeft[v]);
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(SCORE_CACHE_SIZE + 3);
+    nextCache.reserve(SCORE_CACHE_SIZE + 3);
+    size_t scanFrom = 0;
+
+    auto rescore = [&](unsigned int v) {
+        float updated = vertexScore(cachePosition[v], trianglesLeft[v]);
+        float change = updated - score[v];
+        score[v] = updated;
+        for (unsigned int i = 0; i < trianglesLeft[v]; i++)
+            triangleScore[vertexTriangles[firstTriangle[v] + i]] += change;
+    };
+
+    int best = -1;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        // Nothing in the cache to continue from: take the first triangle left
+        // in input order rather than searching them all
+        if (best < 0) {
+            while (emitted[scanFrom])
+                scanFrom++;
+            best = (int)scanFrom;
+        }
+
+        emitted[best] = true;
+        const unsigned int* triangle = &indices[best * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+
+        // Its vertices move to the front of the cache, and it leaves their lists
+        nextCache.assign(triangle, triangle + 3);
+        for (unsigned int v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        }
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = triangle[k];
+            unsigned int* list = &vertexTriangles[firstTriangle[v]];
+            for (unsigned int i = 0; i < trianglesLeft[v]; i++) {
+                if (list[i] == (unsigned int)best) {
+                    list[i] = list[trianglesLeft[v] - 1];
+                    break;
+                }
+            }
+            trianglesLeft[v]--;
+        }
+
+        // Rescore the cached and pushed out vertices and their triangles; the
+        // best triangle of a cached vertex comes next
+        for (size_t i = SCORE_CACHE_SIZE; i < nextCache.size(); i++)
+            cachePosition[nextCache[i]] = -1;
+        for (size_t i = 0; i < nextCache.size() && i < (size_t)SCORE_CACHE_SIZE; i++)
+            cachePosition[nextCache[i]] = (int)i;
+        if (nextCache.size() > (size_t)SCORE_CACHE_SIZE) {
+            cache.assign(nextCache.begin(), nextCache.begin() + SCORE_CACHE_SIZE);
+            nextCache.erase(nextCache.begin(), nextCache.begin() + SCORE_CACHE_SIZE);
+        }
+        else {
+            cache.swap(nextCache);
+            nextCache.clear();
+        }
+
+        for (unsigned int v : nextCache) // the pushed out ones still in the old list
+            rescore(v);
+        for (unsigned int v : cache)
+            rescore(v);
+
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : cache) {
+            for (unsigned int i = 0; i < trianglesLeft[v]; i++) {
+                unsigned int t = vertexTriangles[firstTriangle[v] + i];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = (int)t;
+                }
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Cluster boundaries: before a triangle whose vertices would all miss the
+    // cache (a cold start that costs nothing to move), or once the cluster so
+    // far, simulated from a cold cache, stays within threshold of the whole
+    // list's ACMR. Each cluster then keeps its ACMR wherever it is drawn.
+    const unsigned int cacheSize = 16;
+    float limit = analyzeVertexCache(indices, vertices.size(), cacheSize).acmr * threshold;
+    std::vector<unsigned int> enteredAt(vertices.size(), 0);
+    std::vector<size_t> clusterStarts(1, 0);
+    unsigned int misses = 0, clusterBase = 0;
+    auto cached = [&](unsigned int v) {
+        return enteredAt[v] > clusterBase && misses - enteredAt[v] + 1 <= cacheSize;
+    };
+    for (size_t t = 0; t < triangleCount; t++) {
+        const unsigned int* triangle = &indices[t * 3];
+        size_t clusterTriangles = t - clusterStarts.back();
+        if (clusterTriangles > 0) {
+            bool cold = !cached(triangle[0]) && !cached(triangle[1]) && !cached(triangle[2]);
+            if (cold || (float)(misses - clusterBase) / clusterTriangles <= limit) {
+                clusterStarts.push_back(t);
+                clusterBase = misses;
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            if (!cached(triangle[k])) {
+                misses++;
+                enteredAt[triangle[k]] = misses;
+            }
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+    size_t clusterCount = clusterStarts.size() - 1;
+    if (clusterCount < 2)
+        return;
+
+    // Area-weighted centroid and normal of each cluster and of the mesh
+    std::vector<glm::vec3> centroids(clusterCount), normals(clusterCount);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++) {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+            const glm::vec3& a = vertices[indices[t * 3]].Position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& p = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 cross = glm::cross(b - a, p - a);
+            float triangleArea = glm::length(cross) * 0.5f;
+            centroid += (a + b + p) / 3.0f * triangleArea;
+            normal += cross;
+            area += triangleArea;
+        }
+        centroids[c] = area > 0.0f ? centroid / area : vertices[indices[clusterStarts[c] * 3]].Position;
+        normals[c] = normal;
+        meshCentroid += centroid;
+        meshArea += area;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Clusters facing furthest out are drawn first
+    std::vector<float> facing(clusterCount);
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        float length = glm::length(normals[c]);
+        facing[c] = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&facing](size_t a, size_t b) { return facing[a] > facing[b]; });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (size_t c : order)
+        output.insert(output.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+    indices.swap(output);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    const unsigned int unassigned = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unassigned);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int& index : indices) {
+        if (remap[index] == unassigned) {
+            remap[index] = (unsigned int)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+MeshOptimizeStats optimizeMesh(MeshData& mesh, bool reduceOverdraw) {
+    MeshOptimizeStats stats;
+    stats.before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    if (reduceOverdraw)
+        optimizeOverdraw(mesh.indices, mesh.vertices);
+    optimizeVertexFetch(mesh.vertices, mesh.indices);
+    stats.after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    return stats;
+}
+
+std::vector<MeshOptimizeStats> optimizeModel(ModelData& data, bool reduceOverdraw) {
+    std::vector<MeshOptimizeStats> stats;
+    for (MeshData& mesh : data.meshes)
+        stats.push_back(optimizeMesh(mesh, reduceOverdraw));
+    return stats;
+}
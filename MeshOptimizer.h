@@ -0,0 +1,47 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include "ModelData.h"
+
+// Index and vertex reordering that makes meshes cheaper to draw without
+// changing what is drawn. Runs on the CPU with no GL, at bake time or when a
+// model is loaded without a mesh cache.
+
+// Efficiency of a triangle order with a FIFO post-transform vertex cache
+struct VertexCacheStats {
+    float acmr = 0.0f; // average cache miss ratio: vertices transformed per triangle, 0.5-3
+    float atvr = 0.0f; // average transform to vertex ratio: vertices transformed per vertex, 1 at best
+};
+
+// Statistics of one mesh before and after optimizeMesh
+struct MeshOptimizeStats {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// Simulate a FIFO cache of cacheSize vertices over the triangle list
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16);
+
+// Reorder triangles so vertices are reused while still in the cache, after
+// Forsyth's "Linear-Speed Vertex Cache Optimisation"
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+// Split a cache-optimized triangle list into clusters and put the clusters
+// facing furthest out from the mesh center first, so outer surfaces tend to
+// be drawn before what they hide (after Sander et al.'s Tipsy). Clusters only
+// end where the cache would have been cold anyway, or where their ACMR stays
+// within threshold times the original.
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+// Store vertices in the order the triangles first use them, dropping unused
+// ones, so vertex fetches walk memory forward
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+// All of the above on one mesh; overdraw sorting is optional
+MeshOptimizeStats optimizeMesh(MeshData& mesh, bool reduceOverdraw = true);
+
+// Every mesh of a model, one entry of stats per mesh
+std::vector<MeshOptimizeStats> optimizeModel(ModelData& data, bool reduceOverdraw = true);
+
+#endif
@@ -0,0 +1,265 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Sum of squared distances to a set of planes, weighted by triangle area
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    double weight = 0;
+
+    void addPlane(const glm::dvec3& n, double d, double w) {
+        a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+        a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+        b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+        weight += q.weight;
+    }
+
+    // Mean squared distance of p to the planes
+    double error(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+            + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+    }
+};
+
+struct Collapse {
+    unsigned int from; // attribute vertex that goes away
+    unsigned int to;   // attribute vertex that takes its place
+    double cost;
+};
+
+struct FloatKey {
+    size_t operator()(const glm::vec3& p) const {
+        uint32_t bits[3];
+        std::memcpy(bits, &p, sizeof(bits));
+        return (size_t)bits[0] * 73856093u ^ (size_t)bits[1] * 19349663u ^ (size_t)bits[2] * 83492791u;
+    }
+};
+
+struct VertexKey {
+    size_t operator()(const Vertex& v) const {
+        return FloatKey()(v.Position) ^ FloatKey()(v.Normal) * 31u ^ (size_t)(v.TexCoords.x * 4096.0f) * 7u;
+    }
+};
+
+struct VertexEqual {
+    bool operator()(const Vertex& a, const Vertex& b) const {
+        return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+    }
+};
+
+uint64_t edgeKey(unsigned int a, unsigned int b) {
+    return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+}
+
+}
+
+std::vector<unsigned int> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    size_t targetIndexCount, float& error) {
+    error = 0.0f;
+    size_t vertexCount = vertices.size();
+
+    // Identical vertices become one, and every vertex gets the first vertex
+    // at its position as its place in the topology
+    std::unordered_map<Vertex, unsigned int, VertexKey, VertexEqual> byVertex;
+    std::unordered_map<glm::vec3, unsigned int, FloatKey> byPosition;
+    std::vector<unsigned int> representative(vertexCount), position(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        representative[v] = byVertex.emplace(vertices[v], v).first->second;
+        position[v] = byPosition.emplace(vertices[v].Position, v).first->second;
+    }
+    std::vector<unsigned int> result(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+        result[i] = representative[indices[i]];
+
+    // Locked positions: ends of open or non-manifold edges, and seams, where
+    // one position has several vertices with different normals or UVs
+    std::vector<bool> locked(vertexCount, false);
+    std::vector<unsigned int> vertexAt(vertexCount, ~0u);
+    for (unsigned int v : result) {
+        unsigned int p = position[v];
+        if (vertexAt[p] == ~0u)
+            vertexAt[p] = v;
+        else if (vertexAt[p] != v)
+            locked[p] = true;
+    }
+    std::unordered_map<uint64_t, unsigned int> edgeUses;
+    for (size_t i = 0; i < result.size(); i += 3) {
+        for (int k = 0; k < 3; k++)
+            edgeUses[edgeKey(position[result[i + k]], position[result[i + (k + 1) % 3]])]++;
+    }
+    for (const auto& edge : edgeUses) {
+        if (edge.second != 2) {
+            locked[edge.first >> 32] = true;
+            locked[edge.first & 0xffffffffu] = true;
+        }
+    }
+
+    // Plane quadric of every triangle, summed at its corners
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3) {
+        glm::dvec3 a = vertices[position[result[i]]].Position;
+        glm::dvec3 b = vertices[position[result[i + 1]]].Position;
+        glm::dvec3 c = vertices[position[result[i + 2]]].Position;
+        glm::dvec3 normal = glm::cross(b - a, c - a);
+        double area = glm::length(normal) * 0.5;
+        if (area <= 0.0)
+            continue;
+        normal /= area * 2.0;
+        for (int k = 0; k < 3; k++)
+            quadrics[position[result[i + k]]].addPlane(normal, -glm::dot(normal, a), area);
+    }
+
+    // Passes of independent collapses, cheapest first, until the target is met
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<unsigned int> firstTriangle(vertexCount + 1), vertexTriangles;
+    std::vector<Collapse> collapses;
+    // How far the surface around each position may be from the original: the
+    // largest distance a collapse moved a vertex off the planes of the
+    // triangles it moved, added up along the collapses that led there
+    std::vector<double> deviation(vertexCount, 0.0);
+    double maxDeviation = 0.0;
+    while (result.size() > targetIndexCount) {
+        // Triangles around each position, for the flip test
+        std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+        for (unsigned int v : result)
+            firstTriangle[position[v] + 1]++;
+        for (size_t p = 0; p < vertexCount; p++)
+            firstTriangle[p + 1] += firstTriangle[p];
+        vertexTriangles.assign(result.size(), 0);
+        std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+            vertexTriangles[filled[position[result[i]]]++] = (unsigned int)(i / 3);
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                unsigned int pa = position[a], pb = position[b];
+                Quadric q = quadrics[pa];
+                q.add(quadrics[pb]);
+                if (!locked[pa])
+                    collapses.push_back({ a, b, q.error(vertices[pb].Position) });
+                if (!locked[pb])
+                    collapses.push_back({ b, a, q.error(vertices[pa].Position) });
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        for (unsigned int v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+        size_t removed = 0, needed = (result.size() - targetIndexCount) / 3 + 1;
+        for (const Collapse& collapse : collapses) {
+            if (removed >= needed)
+                break;
+            unsigned int pa = position[collapse.from], pb = position[collapse.to];
+            if (touched[pa] || touched[pb])
+                continue;
+
+            // Moving pa onto pb must not fold any of its other triangles over
+            const glm::vec3& target = vertices[pb].Position;
+            bool flips = false;
+            unsigned int shared = 0;
+            double distance = 0.0;
+            for (unsigned int t = firstTriangle[pa]; t < firstTriangle[pa + 1] && !flips; t++) {
+                const unsigned int* triangle = &result[vertexTriangles[t] * 3];
+                glm::vec3 corners[3], moved[3];
+                bool hasB = false;
+                for (int k = 0; k < 3; k++) {
+                    unsigned int p = position[triangle[k]];
+                    hasB |= p == pb;
+                    corners[k] = moved[k] = vertices[p].Position;
+                    if (p == pa)
+                        moved[k] = target;
+                }
+                if (hasB) {
+                    shared++;
+                    continue;
+                }
+                glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                double length = glm::length(glm::dvec3(before));
+                if (length > 0.0)
+                    distance = std::max(distance, std::abs(glm::dot(glm::dvec3(before), glm::dvec3(target - corners[0]))) / length);
+                glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            // pa is no seam, so collapse.from is its only vertex
+            remap[collapse.from] = collapse.to;
+            quadrics[pb].add(quadrics[pa]);
+            for (unsigned int t = firstTriangle[pa]; t < firstTriangle[pa + 1]; t++) {
+                const unsigned int* triangle = &result[vertexTriangles[t] * 3];
+                for (int k = 0; k < 3; k++)
+                    touched[position[triangle[k]]] = true;
+            }
+            deviation[pb] = std::max(deviation[pa], deviation[pb]) + distance;
+            maxDeviation = std::max(maxDeviation, deviation[pb]);
+            removed += shared;
+        }
+        if (removed == 0)
+            break; // nothing left that can go
+
+        // Apply the collapses and drop the triangles that became degenerate
+        size_t kept = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (position[a] == position[b] || position[b] == position[c] || position[a] == position[c])
+                continue;
+            result[kept++] = a;
+            result[kept++] = b;
+            result[kept++] = c;
+        }
+        result.resize(kept);
+    }
+
+    error = (float)maxDeviation;
+    return result;
+}
+
+void generateLods(MeshData& mesh, unsigned int lodCount) {
+    mesh.lods.clear();
+    const std::vector<unsigned int>* source = &mesh.indices;
+    float error = 0.0f;
+    for (unsigned int level = 0; level < lodCount; level++) {
+        size_t target = source->size() / 6 * 3;
+        if (target < 3)
+            break;
+
+        // Each level starts from the one before; their errors add up at worst
+        float levelError;
+        MeshLod lod;
+        lod.indices = simplifyMesh(mesh.vertices, *source, target, levelError);
+        if (lod.indices.empty() || lod.indices.size() > source->size() * 9 / 10)
+            break;
+        optimizeVertexCache(lod.indices, mesh.vertices.size());
+        error += levelError;
+        lod.error = error;
+        mesh.lods.push_back(std::move(lod));
+        source = &mesh.lods.back().indices;
+    }
+}
+
+void generateLods(ModelData& data, unsigned int lodCount) {
+    for (MeshData& mesh : data.meshes)
+        generateLods(mesh, lodCount);
+}
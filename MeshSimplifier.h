@@ -0,0 +1,29 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+#include "ModelData.h"
+
+// Level of detail generation by edge collapse with quadric error metrics
+// (Garland and Heckbert). Like MeshOptimizer it runs without GL, at bake time
+// or when a model is loaded without a mesh cache. Every level reuses the
+// mesh's vertices and only has its own indices.
+
+// Collapse edges of the triangle list, cheapest quadric error first, until at
+// most targetIndexCount indices are left or nothing more can be collapsed.
+// Vertices on open borders and UV or normal seams never move, so levels never
+// crack or smear textures. error is set to a bound, in model units, on how
+// far the result is from the surface: each collapse adds the largest distance
+// it moved a vertex off the planes of the triangles around it.
+std::vector<unsigned int> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    size_t targetIndexCount, float& error);
+
+// Replace mesh.lods with up to lodCount levels, each aiming for half the
+// triangles of the one before. The chain stops early when a level would not
+// remove at least a tenth of the triangles.
+void generateLods(MeshData& mesh, unsigned int lodCount = 3);
+
+// Every mesh of a model
+void generateLods(ModelData& data, unsigned int lodCount = 3);
+
+#endif
@@ -5,18 +5,25 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-#include "stb_image.h"
+#include "Shader.h"
+#include "ModelData.h"
+#include "MeshCache.h"
+#include "BVH.h"
+#include "Frustum.h"
+#include "TextureManager.h"
+#include "VertexFormat.h"
+#include "GeometryArena.h"
+#include "GLState.h"
+#include <algorithm>
+#include <map>
 #include <vector>
 #include <string>
 #include <iostream>
 
-struct Vertex {
-    glm::vec3 Position;
-    glm::vec3 Normal;
-    glm::vec2 TexCoords;
+// Per-instance vertex data of instanced draws
+struct InstanceData {
+    glm::mat4 model;
+    glm::mat3 normal; // inverse transpose of the model matrix
 };
 
 struct Texture {
@@ -30,242 +37,455 @@ public:
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
-    unsigned int VAO;
+    unsigned int VAO; // the geometry pool's, shared with the other meshes in it
+    glm::vec3 boundsMin, boundsMax; // model-space AABB, for culling
+
+    // lods are the coarser index lists of MeshData, drawn from the same vertices
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+        const glm::vec3& boundsMin, const glm::vec3& boundsMax, const std::vector<MeshLod>& lods = std::vector<MeshLod>())
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)),
+        boundsMin(boundsMin), boundsMax(boundsMax) {
+        setupMesh(lods);
+        setupSamplerNames();
+    }
+
+    // Draw level of detail lod, 0 being full detail; levels past the last
+    // draw the coarsest one
+    void Draw(const Shader& shader, unsigned int lod = 0) const {
+        bindTextures(shader);
 
-    Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures)
-        : vertices(vertices), indices(indices), textures(textures) {
-        setupMesh();
+        GLState::instance().bindVertexArray(VAO);
+        drawElements(lod);
+        drawCounters().vertexArrayBinds++;
     }
 
-    void Draw(unsigned int shaderProgram) {
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
+    // Draw level of detail lod with VAO already bound and the textures and
+    // uniforms already set
+    void drawElements(unsigned int lod = 0) const {
+        const LodRange& range = lodRanges[std::min(lod, getLodCount() - 1)];
+        glDrawElementsBaseVertex(GL_TRIANGLES, range.count, indexType, (void*)(range.firstIndex * indexSize()), baseVertex);
+        drawCounters().drawCalls++;
+    }
 
-        for (unsigned int i = 0; i < textures.size(); i++) {
-            glActiveTexture(GL_TEXTURE0 + i);
-            std::string number;
-            std::string name = textures[i].type;
-            if (name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular")
-                number = std::to_string(specularNr++);
+    // Draw count copies with a VAO made by createInstancedVAO
+    void DrawInstanced(const Shader& shader, unsigned int instancedVAO, GLsizei count, unsigned int lod = 0) const {
+        bindTextures(shader);
 
-            glUniform1i(glGetUniformLocation(shaderProgram, (name + number).c_str()), i);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
+        const LodRange& range = lodRanges[std::min(lod, getLodCount() - 1)];
+        GLState::instance().bindVertexArray(instancedVAO);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.count, indexType, (void*)(range.firstIndex * indexSize()), count, baseVertex);
+        drawCounters().vertexArrayBinds++;
+        drawCounters().drawCalls++;
+    }
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // Levels of detail including full detail, at least 1
+    unsigned int getLodCount() const {
+        return (unsigned int)lodRanges.size();
+    }
 
-        glActiveTexture(GL_TEXTURE0);
+    // Model-space distance level lod may be off from full detail
+    float getLodError(unsigned int lod) const {
+        return lodRanges[std::min(lod, getLodCount() - 1)].error;
     }
 
-private:
-    unsigned int VBO, EBO;
+    // Triangles drawn at level lod
+    unsigned int getTriangleCount(unsigned int lod) const {
+        return (unsigned int)lodRanges[std::min(lod, getLodCount() - 1)].count / 3;
+    }
 
-    void setupMesh() {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+    // Indices of level lod in the geometry pool's index buffer, for draws
+    // made outside the mesh; they are relative to getBaseVertex()
+    void getLodIndices(unsigned int lod, GLuint& firstIndex, GLsizei& count) const {
+        const LodRange& range = lodRanges[std::min(lod, getLodCount() - 1)];
+        firstIndex = range.firstIndex;
+        count = range.count;
+    }
 
-        glBindVertexArray(VAO);
+    unsigned int getPool() const {
+        return pool;
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    GLint getBaseVertex() const {
+        return baseVertex;
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    // Packed positions are 0-1 within the bounds; float ones pass through
+    glm::vec3 getPositionOffset() const {
+        return packed ? boundsMin : glm::vec3(0.0f);
+    }
 
-        // vertex positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    glm::vec3 getPositionScale() const {
+        return packed ? boundsMax - boundsMin : glm::vec3(1.0f);
+    }
 
-        glBindVertexArray(0);
+    // Meshes with the same textures of the same types share a material id
+    unsigned int getMaterial() const {
+        return material;
     }
-};
 
-class Model {
-public:
-    Model(const char* path) {
-        loadModel(path);
+    // A second VAO over this mesh's buffers that also reads one InstanceData
+    // per instance from instanceBuffer: the model matrix at attribute
+    // locations 3-6 and the normal matrix at 7-9
+    unsigned int createInstancedVAO(unsigned int instanceBuffer) const {
+        const GeometryPool& geometry = GeometryArena::instance().pool(pool);
+        unsigned int instancedVAO;
+        glGenVertexArrays(1, &instancedVAO);
+        GLState::instance().bindVertexArray(instancedVAO);
+
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, geometry.VBO);
+        GLState::instance().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry.EBO);
+        GeometryArena::setupVertexAttributes(packed);
+
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (unsigned int column = 0; column < 4; column++) {
+            glEnableVertexAttribArray(3 + column);
+            glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(3 + column, 1);
+        }
+        for (unsigned int column = 0; column < 3; column++) {
+            glEnableVertexAttribArray(7 + column);
+            glVertexAttribPointer(7 + column, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                (void*)(offsetof(InstanceData, normal) + column * sizeof(glm::vec3)));
+            glVertexAttribDivisor(7 + column, 1);
+        }
+
+        GLState::instance().bindVertexArray(0);
+        return instancedVAO;
     }
 
-    void Draw(unsigned int shaderProgram) {
-        for (unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shaderProgram);
+    // Whether the vertices were uploaded as PackedVertex
+    bool isPacked() const {
+        return packed;
     }
 
-    // Transform the model
-    void setTransform(const glm::mat4& transform) {
-        modelMatrix = transform;
+    // Size of the vertices and indices in the geometry arena
+    size_t gpuBytes() const {
+        return bufferBytes;
     }
 
-    void translate(const glm::vec3& translation) {
-        modelMatrix = glm::translate(modelMatrix, translation);
+    // Bind the textures to units 0 and up and set the sampler and position
+    // uniforms of shader for them
+    void bindTextures(const Shader& shader) const {
+        bindMaterial(shader);
+        setPositionUniforms(shader);
     }
 
-    void rotate(float angle, const glm::vec3& axis) {
-        modelMatrix = glm::rotate(modelMatrix, glm::radians(angle), axis);
+    // The textures and sampler uniforms alone, which every mesh with the
+    // same material shares
+    void bindMaterial(const Shader& shader) const {
+        // Handles are resolved once per program rather than per draw
+        if (samplerProgram != shader.ID)
+            resolveUniforms(shader);
+
+        for (unsigned int i = 0; i < textures.size(); i++) {
+            shader.set(samplerHandles[i], (int)i);
+            GLState::instance().bindTexture(i, GL_TEXTURE_2D, textures[i].id);
+        }
+        drawCounters().textureBinds += (unsigned int)textures.size();
+        drawCounters().uniformUploads += (unsigned int)textures.size();
     }
 
-    void scale(const glm::vec3& scaling) {
-        modelMatrix = glm::scale(modelMatrix, scaling);
+    // The position decoding uniforms alone, which are the mesh's own
+    void setPositionUniforms(const Shader& shader) const {
+        if (samplerProgram != shader.ID)
+            resolveUniforms(shader);
+
+        shader.set(positionOffsetHandle, getPositionOffset());
+        shader.set(positionScaleHandle, getPositionScale());
+        drawCounters().uniformUploads += 2;
     }
 
-    glm::mat4 getModelMatrix() const {
-        return modelMatrix;
+    unsigned int getTextureCount() const {
+        return (unsigned int)textures.size();
     }
 
 private:
-    std::vector<Mesh> meshes;
-    std::string directory;
-    std::vector<Texture> textures_loaded;
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    // Where a level of detail lies in the pool's index buffer
+    struct LodRange {
+        GLuint firstIndex;
+        GLsizei count;
+        float error;
+    };
+
+    std::vector<LodRange> lodRanges;
+    unsigned int pool = 0;
+    GLint baseVertex = 0;
+    bool packed = false;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t bufferBytes = 0;
+    unsigned int material = 0;
+
+    // Sampler uniform name for each texture, e.g. "texture_diffuse1"
+    std::vector<std::string> samplerNames;
+    mutable unsigned int samplerProgram = 0;
+    mutable std::vector<UniformHandle<int>> samplerHandles;
+    mutable UniformHandle<glm::vec3> positionOffsetHandle;
+    mutable UniformHandle<glm::vec3> positionScaleHandle;
+
+    size_t indexSize() const {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    }
 
-    void loadModel(std::string path) {
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    void setupSamplerNames() {
+        unsigned int diffuseNr = 1;
+        unsigned int specularNr = 1;
 
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-            std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-            return;
+        for (unsigned int i = 0; i < textures.size(); i++) {
+            std::string number;
+            std::string name = textures[i].type;
+            if (name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if (name == "texture_specular")
+                number = std::to_string(specularNr++);
+            samplerNames.push_back(name + number);
         }
-        directory = path.substr(0, path.find_last_of('/'));
 
-        processNode(scene->mRootNode, scene);
+        // Ids are handed out on the GL thread, where meshes are made
+        static std::map<std::vector<std::pair<std::string, unsigned int>>, unsigned int> materials;
+        std::vector<std::pair<std::string, unsigned int>> key;
+        for (unsigned int i = 0; i < textures.size(); i++)
+            key.push_back(std::make_pair(samplerNames[i], textures[i].id));
+        material = materials.emplace(key, (unsigned int)materials.size()).first->second;
     }
 
-    void processNode(aiNode* node, const aiScene* scene) {
-        for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+    void resolveUniforms(const Shader& shader) const {
+        samplerHandles.clear();
+        for (const std::string& name : samplerNames) {
+            // model_fragment.glsl keeps its samplers inside the material struct
+            UniformHandle<int> handle = shader.uniform<int>(name);
+            if (!handle.valid())
+                handle = shader.uniform<int>("material." + name);
+            samplerHandles.push_back(handle);
         }
+        positionOffsetHandle = shader.uniform<glm::vec3>("positionOffset");
+        positionScaleHandle = shader.uniform<glm::vec3>("positionScale");
+        samplerProgram = shader.ID;
+    }
 
-        for (unsigned int i = 0; i < node->mNumChildren; i++) {
-            processNode(node->mChildren[i], scene);
+    void setupMesh(const std::vector<MeshLod>& lods) {
+        // Every level of detail goes after full detail in the index buffer
+        std::vector<unsigned int> allIndices(indices);
+        lodRanges.push_back({ 0, (GLsizei)indices.size(), 0.0f });
+        for (const MeshLod& lod : lods) {
+            lodRanges.push_back({ (GLuint)allIndices.size(), (GLsizei)lod.indices.size(), lod.error });
+            allIndices.insert(allIndices.end(), lod.indices.begin(), lod.indices.end());
         }
-    }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene) {
-        std::vector<Vertex> vertices;
-        std::vector<unsigned int> indices;
-        std::vector<Texture> textures;
-
-        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-            Vertex vertex;
-            // Position
-            vertex.Position = glm::vec3(
-                mesh->mVertices[i].x,
-                mesh->mVertices[i].y,
-                mesh->mVertices[i].z
-            );
-            // Normal
-            vertex.Normal = glm::vec3(
-                mesh->mNormals[i].x,
-                mesh->mNormals[i].y,
-                mesh->mNormals[i].z
-            );
-            // TexCoords
-            if (mesh->mTextureCoords[0]) {
-                vertex.TexCoords = glm::vec2(
-                    mesh->mTextureCoords[0][i].x,
-                    mesh->mTextureCoords[0][i].y
-                );
-            }
-            else {
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-            }
-            vertices.push_back(vertex);
+        // Packed vertices and 16-bit indices when allowed, full floats otherwise
+        std::vector<PackedVertex> packedVertices;
+        packed = vertexCompression() && packVertices(vertices, boundsMin, boundsMax, packedVertices);
+        const void* vertexData = packed ? (const void*)packedVertices.data() : (const void*)vertices.data();
+        GeometryRange range;
+        if (vertexCompression() && vertices.size() < 65536) {
+            std::vector<uint16_t> shortIndices(allIndices.begin(), allIndices.end());
+            indexType = GL_UNSIGNED_SHORT;
+            range = GeometryArena::instance().allocate(packed, indexType, vertexData, vertices.size(), shortIndices.data(), shortIndices.size());
+        }
+        else {
+            indexType = GL_UNSIGNED_INT;
+            range = GeometryArena::instance().allocate(packed, indexType, vertexData, vertices.size(), allIndices.data(), allIndices.size());
         }
+        bufferBytes = vertices.size() * (packed ? sizeof(PackedVertex) : sizeof(Vertex)) + allIndices.size() * indexSize();
 
-        for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-            aiFace face = mesh->mFaces[i];
-            for (unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+        pool = range.pool;
+        baseVertex = range.baseVertex;
+        for (LodRange& lod : lodRanges)
+            lod.firstIndex += range.firstIndex;
+        VAO = GeometryArena::instance().pool(pool).VAO;
+    }
+};
+
+// What the camera sees, for choosing levels of detail
+struct LodView {
+    glm::vec3 eye = glm::vec3(0.0f);
+    float pixelsPerUnit = 0.0f;  // pixels a length of 1 covers at distance 1
+    float maxErrorPixels = 1.0f; // the coarsest level whose error stays under this is drawn
+    float hysteresis = 0.75f;    // a coarser level must stay under maxErrorPixels times this,
+                                 // so levels do not flicker at the threshold
+
+    static LodView perspective(const glm::vec3& eye, float fieldOfViewRadians, float screenHeight) {
+        LodView view;
+        view.eye = eye;
+        view.pixelsPerUnit = screenHeight / (2.0f * glm::tan(fieldOfViewRadians * 0.5f));
+        return view;
+    }
+};
+
+// A loaded model asset. It owns the mesh data and GPU buffers and is shared
+// by every ModelInstance that places it in the scene, so it is not copyable.
+class Model {
+public:
+    // Load synchronously on the calling (GL) thread
+    Model(const char* path) {
+        ModelData data;
+        if (!loadModelData(path, data))
+            return;
+        bvh.build(data.meshes);
+        upload(data, decodeImages(data));
+    }
+
+    // Upload data that was parsed elsewhere, e.g. by AssetLoader, along with
+    // the BVH built from it and the decoded TextureManager entry of each of
+    // its images. Mesh vectors are moved out of data.
+    Model(ModelData& data, BVH&& bvh, const std::vector<std::shared_ptr<TextureEntry>>& images) : bvh(std::move(bvh)) {
+        upload(data, images);
+    }
+
+    ~Model() {
+        for (const Texture& texture : textures_loaded)
+            TextureManager::instance().release(texture.id);
+    }
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // Request every image of data from the TextureManager, decoding on this
+    // thread the ones nobody has decoded yet
+    static std::vector<std::shared_ptr<TextureEntry>> decodeImages(const ModelData& data) {
+        TextureManager& textureManager = TextureManager::instance();
+        std::vector<std::shared_ptr<TextureEntry>> images;
+        for (const ImageData& image : data.images) {
+            bool decode;
+            images.push_back(textureManager.request(data.directory, image.path, decode));
+            if (decode)
+                textureManager.decode(*images.back());
+            else
+                textureManager.waitDecoded(*images.back());
         }
+        return images;
+    }
 
-        if (mesh->mMaterialIndex >= 0) {
-            aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-            std::vector<Texture> diffuseMaps = loadMaterialTextures(material,
-                aiTextureType_DIFFUSE, "texture_diffuse");
-            textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+    void Draw(const Shader& shader) const {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(shader);
+    }
 
-            std::vector<Texture> specularMaps = loadMaterialTextures(material,
-                aiTextureType_SPECULAR, "texture_specular");
-            textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    // Draw only the meshes whose bounds, placed by modelMatrix, touch the
+    // frustum, at level of detail lod
+    void Draw(const Shader& shader, const Frustum& frustum, const glm::mat4& modelMatrix, CullStats& stats, unsigned int lod = 0) const {
+        // Skip every mesh at once when the whole model is outside
+        if (!frustum.isBoxVisible(boundsMin, boundsMax, modelMatrix)) {
+            stats.culled += (unsigned int)meshes.size();
+            return;
         }
 
-        return Mesh(vertices, indices, textures);
-    }
-
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
-        std::vector<Texture> textures;
-        for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            bool skip = false;
-            for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true;
-                    break;
-                }
+        for (unsigned int i = 0; i < meshes.size(); i++) {
+            if (frustum.isBoxVisible(meshes[i].boundsMin, meshes[i].boundsMax, modelMatrix)) {
+                meshes[i].Draw(shader, lod);
+                stats.drawn++;
+                stats.triangles += meshes[i].getTriangleCount(lod);
             }
-            if (!skip) {
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);
+            else {
+                stats.culled++;
             }
         }
-        return textures;
     }
 
-    unsigned int TextureFromFile(const char* path, const std::string& directory) {
-        std::string filename = std::string(path);
-        filename = directory + '/' + filename;
+    // Ask for enough texture detail to cover pixels pixels across the screen
+    void requestTextureDetail(float pixels) const {
+        for (const Texture& texture : textures_loaded)
+            TextureManager::instance().requestDetail(texture.id, pixels);
+    }
 
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
+    // Level of detail for the model placed by modelMatrix, starting from the
+    // level drawn last. Each level's error, projected at the distance of the
+    // model's bounding sphere, is compared with the view's threshold.
+    unsigned int selectLod(const glm::mat4& modelMatrix, const LodView& view, unsigned int current) const {
+        if (getLodCount() == 1)
+            return 0;
+        unsigned int lod = std::min(current, getLodCount() - 1);
+
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        float scale = glm::max(glm::length(glm::vec3(modelMatrix[0])),
+            glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+        float radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+        float distance = glm::max(glm::length(center - view.eye) - radius, 0.1f);
+        float pixelsPerError = scale * view.pixelsPerUnit / distance;
+
+        while (lod > 0 && lodErrors[lod] * pixelsPerError > view.maxErrorPixels)
+            lod--;
+        while (lod + 1 < getLodCount() && lodErrors[lod + 1] * pixelsPerError <= view.maxErrorPixels * view.hysteresis)
+            lod++;
+        return lod;
+    }
 
-        int width, height, nrComponents;
-        unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-        if (data) {
-            GLenum format;
-            if (nrComponents == 1)
-                format = GL_RED;
-            else if (nrComponents == 3)
-                format = GL_RGB;
-            else if (nrComponents == 4)
-                format = GL_RGBA;
+    // Levels of detail of the meshes, including full detail
+    unsigned int getLodCount() const {
+        return (unsigned int)lodErrors.size();
+    }
 
-            glBindTexture(GL_TEXTURE_2D, textureID);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
+    // Largest model-space error of any mesh at level lod
+    float getLodError(unsigned int lod) const {
+        return lodErrors[std::min(lod, getLodCount() - 1)];
+    }
 
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    const std::vector<Mesh>& getMeshes() const {
+        return meshes;
+    }
+
+    // Model-space bounds of all meshes
+    const glm::vec3& getBoundsMin() const {
+        return boundsMin;
+    }
+
+    const glm::vec3& getBoundsMax() const {
+        return boundsMax;
+    }
+
+    // Triangle hierarchy in model space, for ray hit tests
+    const BVH& getBVH() const {
+        return bvh;
+    }
+
+    const std::string& getDirectory() const {
+        return directory;
+    }
 
-            stbi_image_free(data);
+private:
+    BVH bvh;
+    std::vector<Mesh> meshes;
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f); // union of the mesh bounds
+    std::vector<float> lodErrors = std::vector<float>(1, 0.0f);
+    std::string directory;
+    std::vector<Texture> textures_loaded; // one per image, shared through the TextureManager
+
+    void upload(ModelData& data, const std::vector<std::shared_ptr<TextureEntry>>& images) {
+        directory = data.directory;
+
+        for (unsigned int i = 0; i < data.images.size(); i++) {
+            Texture texture;
+            texture.id = TextureManager::instance().acquire(*images[i]);
+            texture.path = data.images[i].path;
+            textures_loaded.push_back(texture);
         }
-        else {
-            std::cout << "Texture failed to load at path: " << path << std::endl;
-            stbi_image_free(data);
+
+        meshes.reserve(data.meshes.size());
+        for (MeshData& mesh : data.meshes) {
+            if (meshes.empty()) {
+                boundsMin = mesh.boundsMin;
+                boundsMax = mesh.boundsMax;
+            }
+            boundsMin = glm::min(boundsMin, mesh.boundsMin);
+            boundsMax = glm::max(boundsMax, mesh.boundsMax);
+
+            std::vector<Texture> textures;
+            for (const TextureRef& ref : mesh.textures) {
+                Texture texture = textures_loaded[ref.image];
+                texture.type = ref.type;
+                textures.push_back(texture);
+            }
+            meshes.push_back(Mesh(std::move(mesh.vertices), std::move(mesh.indices), std::move(textures), mesh.boundsMin, mesh.boundsMax, mesh.lods));
         }
 
-        return textureID;
+        // Meshes with fewer levels keep drawing their coarsest one
+        for (const Mesh& mesh : meshes)
+            lodErrors.resize(std::max((unsigned int)lodErrors.size(), mesh.getLodCount()), 0.0f);
+        for (unsigned int lod = 0; lod < lodErrors.size(); lod++) {
+            for (const Mesh& mesh : meshes)
+                lodErrors[lod] = std::max(lodErrors[lod], mesh.getLodError(lod));
+        }
     }
 };
 
-#endif
\ No newline at end of file
+#endif
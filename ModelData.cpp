@@ -0,0 +1,132 @@
+#include "ModelData.h"
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include <iostream>
+#include <unordered_map>
+
+// Index into ModelData::images of each image path seen so far
+using ImageIndex = std::unordered_map<std::string, unsigned int>;
+
+void ImageDeleter::operator()(unsigned char* pixels) const {
+    stbi_image_free(pixels);
+}
+
+static void loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName,
+    ModelData& data, ImageIndex& imageIndex, MeshData& mesh) {
+    for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
+        aiString str;
+        mat->GetTexture(type, i, &str);
+
+        // Images shared between meshes are only listed once
+        auto found = imageIndex.find(str.C_Str());
+        unsigned int image;
+        if (found != imageIndex.end()) {
+            image = found->second;
+        }
+        else {
+            image = (unsigned int)data.images.size();
+            imageIndex[str.C_Str()] = image;
+            ImageData imageData;
+            imageData.path = str.C_Str();
+            data.images.push_back(std::move(imageData));
+        }
+
+        mesh.textures.push_back({ typeName, image });
+    }
+}
+
+static MeshData processMesh(aiMesh* mesh, const aiScene* scene, ModelData& data, ImageIndex& imageIndex) {
+    MeshData meshData;
+    meshData.vertices.reserve(mesh->mNumVertices);
+    meshData.indices.reserve(mesh->mNumFaces * 3);
+    if (mesh->mNumVertices > 0)
+        meshData.boundsMin = meshData.boundsMax = glm::vec3(mesh->mVertices[0].x, mesh->mVertices[0].y, mesh->mVertices[0].z);
+
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+        Vertex vertex;
+        // Position
+        vertex.Position = glm::vec3(
+            mesh->mVertices[i].x,
+            mesh->mVertices[i].y,
+            mesh->mVertices[i].z
+        );
+        meshData.boundsMin = glm::min(meshData.boundsMin, vertex.Position);
+        meshData.boundsMax = glm::max(meshData.boundsMax, vertex.Position);
+        // Normal
+        if (mesh->mNormals) {
+            vertex.Normal = glm::vec3(
+                mesh->mNormals[i].x,
+                mesh->mNormals[i].y,
+                mesh->mNormals[i].z
+            );
+        }
+        else {
+            vertex.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+        // TexCoords
+        if (mesh->mTextureCoords[0]) {
+            vertex.TexCoords = glm::vec2(
+                mesh->mTextureCoords[0][i].x,
+                mesh->mTextureCoords[0][i].y
+            );
+        }
+        else {
+            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+        }
+        meshData.vertices.push_back(vertex);
+    }
+
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        const aiFace& face = mesh->mFaces[i];
+        for (unsigned int j = 0; j < face.mNumIndices; j++)
+            meshData.indices.push_back(face.mIndices[j]);
+    }
+
+    if (mesh->mMaterialIndex < scene->mNumMaterials) {
+        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data, imageIndex, meshData);
+        loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data, imageIndex, meshData);
+    }
+
+    return meshData;
+}
+
+static void processNode(aiNode* node, const aiScene* scene, ModelData& data, ImageIndex& imageIndex) {
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        data.meshes.push_back(processMesh(mesh, scene, data, imageIndex));
+    }
+
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+        processNode(node->mChildren[i], scene, data, imageIndex);
+    }
+}
+
+bool parseModel(const std::string& path, ModelData& data) {
+    // Each call owns its importer, so parsing is safe on any thread
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+        return false;
+    }
+    data.directory = path.substr(0, path.find_last_of('/'));
+
+    ImageIndex imageIndex;
+    processNode(scene->mRootNode, scene, data, imageIndex);
+    return true;
+}
+
+void decodeImage(const std::string& directory, ImageData& image) {
+    decodeImageFile(directory + '/' + image.path, image);
+}
+
+void decodeImageFile(const std::string& filename, ImageData& image) {
+    image.pixels.reset(stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0));
+    if (!image.pixels)
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
+}
@@ -0,0 +1,68 @@
+#ifndef MODEL_DATA_H
+#define MODEL_DATA_H
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+// CPU-side model data. Everything here is produced without touching GL, so it
+// can be built on worker threads and handed to the GL thread for upload.
+
+struct Vertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+};
+
+// A texture used by a mesh, referring to one of the model's images
+struct TextureRef {
+    std::string type;   // "texture_diffuse" or "texture_specular"
+    unsigned int image; // index into ModelData::images
+};
+
+// A coarser version of a mesh, over the same vertices
+struct MeshLod {
+    std::vector<unsigned int> indices;
+    float error = 0.0f; // model-space distance the surface may have moved from full detail
+};
+
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices; // full detail
+    std::vector<MeshLod> lods;         // coarser levels, finest first
+    std::vector<TextureRef> textures;
+    glm::vec3 boundsMin = glm::vec3(0.0f); // model-space AABB of the vertices
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// Frees pixels returned by stb_image
+struct ImageDeleter {
+    void operator()(unsigned char* pixels) const;
+};
+
+struct ImageData {
+    std::string path; // as written in the material, relative to the model
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    std::unique_ptr<unsigned char, ImageDeleter> pixels; // null if decoding failed
+};
+
+struct ModelData {
+    std::string directory;
+    std::vector<MeshData> meshes;
+    std::vector<ImageData> images; // unique per path, not decoded by parseModel
+};
+
+// Read a model file with Assimp and collect its meshes and the images they
+// reference. Returns false if the file could not be imported.
+bool parseModel(const std::string& path, ModelData& data);
+
+// Decode one image of a model from disk into image.pixels
+void decodeImage(const std::string& directory, ImageData& image);
+
+// Decode the image at filename into image.pixels
+void decodeImageFile(const std::string& filename, ImageData& image);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef MODEL_INSTANCE_H
+#define MODEL_INSTANCE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "Model.h"
+
+// One placement of a Model in the scene. The Model itself is shared and never
+// copied; an instance only carries its own transform and level of detail.
+class ModelInstance {
+public:
+    ModelInstance(const Model& model) : model(&model) {}
+
+    // Transform the instance
+    void setTransform(const glm::mat4& transform) {
+        modelMatrix = transform;
+        updateNormalMatrix();
+    }
+
+    void translate(const glm::vec3& translation) {
+        modelMatrix = glm::translate(modelMatrix, translation);
+    }
+
+    void rotate(float angle, const glm::vec3& axis) {
+        modelMatrix = glm::rotate(modelMatrix, glm::radians(angle), axis);
+        updateNormalMatrix();
+    }
+
+    void scale(const glm::vec3& scaling) {
+        modelMatrix = glm::scale(modelMatrix, scaling);
+        updateNormalMatrix();
+    }
+
+    const glm::mat4& getModelMatrix() const {
+        return modelMatrix;
+    }
+
+    // Inverse transpose of the model matrix, computed when the transform
+    // changes instead of per vertex in the shader
+    const glm::mat3& getNormalMatrix() const {
+        return normalMatrix;
+    }
+
+    const Model& getModel() const {
+        return *model;
+    }
+
+    // Pick the level of detail for this frame's view
+    void updateLod(const LodView& view) {
+        lod = model->selectLod(modelMatrix, view, lod);
+    }
+
+    // Level of detail to draw, 0 being full detail
+    unsigned int getLod() const {
+        return lod;
+    }
+
+private:
+    const Model* model;
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    glm::mat3 normalMatrix = glm::mat3(1.0f);
+    unsigned int lod = 0;
+
+    // Translation does not affect normals, so translate() skips this
+    void updateNormalMatrix() {
+        normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+    }
+};
+
+#endif
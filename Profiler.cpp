@@ -0,0 +1,144 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::beginFrame() {
+    if (!enabled)
+        return;
+    frameStart = Clock::now();
+    frameCpu.clear();
+}
+
+void Profiler::endFrame() {
+    if (!enabled)
+        return;
+    lastFrame = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+    lastCpu.swap(frameCpu);
+    frameNumber++;
+    collectQueries();
+}
+
+void Profiler::beginCpu(const char* name) {
+    OpenScope scope = { name, nowUs(), events.size() < MAX_EVENTS ? events.size() : MAX_EVENTS };
+    openScopes.push_back(scope);
+    record({ name, 'X', CPU_TRACK, scope.startUs, 0.0 });
+}
+
+void Profiler::endCpu() {
+    if (openScopes.empty())
+        return;
+    OpenScope scope = openScopes.back();
+    openScopes.pop_back();
+
+    double durationUs = nowUs() - scope.startUs;
+    if (scope.event < events.size())
+        events[scope.event].value = durationUs;
+    if (openScopes.empty())
+        frameCpu.push_back({ scope.name, durationUs / 1000.0 });
+}
+
+void Profiler::beginGpu(const char* name) {
+    if (openQuery.name)
+        return; // GL_TIME_ELAPSED queries do not nest
+    if (freeQueries.empty()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        freeQueries.push_back(query);
+    }
+    openQuery = { freeQueries.back(), name, nowUs(), frameNumber };
+    freeQueries.pop_back();
+    glBeginQuery(GL_TIME_ELAPSED, openQuery.query);
+}
+
+void Profiler::endGpu() {
+    if (!openQuery.name)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    pendingQueries.push_back(openQuery);
+    openQuery.name = nullptr;
+}
+
+void Profiler::counter(const char* name, double value) {
+    if (enabled)
+        record({ name, 'C', CPU_TRACK, nowUs(), value });
+}
+
+void Profiler::collectQueries() {
+    // Queries finish in issue order; stop at the first one still running
+    size_t done = 0;
+    for (; done < pendingQueries.size(); done++) {
+        const GpuQuery& pending = pendingQueries[done];
+        GLint available = 0;
+        glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &ns);
+
+        // The GPU runs sections one after another, no earlier than issued
+        double startUs = std::max(pending.issuedUs, gpuCursorUs);
+        record({ pending.name, 'X', GPU_TRACK, startUs, ns / 1000.0 });
+        gpuCursorUs = startUs + ns / 1000.0;
+        freeQueries.push_back(pending.query);
+
+        // A query of a later frame means every one of gpuFrame's is in
+        if (pending.frame != gpuFrame) {
+            if (!frameGpu.empty())
+                lastGpu.swap(frameGpu);
+            frameGpu.clear();
+            gpuFrame = pending.frame;
+        }
+        frameGpu.push_back({ pending.name, ns / 1e6 });
+    }
+    pendingQueries.erase(pendingQueries.begin(), pendingQueries.begin() + done);
+
+    // So is an ended frame with none of its queries still running
+    bool frameDone = gpuFrame < frameNumber && (pendingQueries.empty() || pendingQueries.front().frame != gpuFrame);
+    if (frameDone && !frameGpu.empty()) {
+        lastGpu.swap(frameGpu);
+        frameGpu.clear();
+    }
+}
+
+bool Profiler::writeTrace(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) {
+        std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN: " << path << std::endl;
+        return false;
+    }
+
+    // Microseconds from the start of the session, to the nanosecond
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << CPU_TRACK << ",\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_TRACK << ",\"args\":{\"name\":\"GPU\"}}";
+    for (const Event& event : events) {
+        file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":" << event.track
+            << ",\"ts\":" << event.startUs;
+        if (event.phase == 'X')
+            file << ",\"dur\":" << event.value << "}";
+        else
+            file << ",\"args\":{\"value\":" << event.value << "}}";
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    std::cout << "Wrote " << events.size() << " trace events to " << path
+        << (events.size() >= MAX_EVENTS ? " (recording stopped at the event limit)" : "") << std::endl;
+    return true;
+}
+
+void Profiler::release() {
+    for (const GpuQuery& pending : pendingQueries)
+        glDeleteQueries(1, &pending.query);
+    pendingQueries.clear();
+    frameGpu.clear();
+    if (!freeQueries.empty())
+        glDeleteQueries((GLsizei)freeQueries.size(), &freeQueries[0]);
+    freeQueries.clear();
+}
@@ -0,0 +1,162 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Where the frames go: nested CPU scopes, GPU sections timed with
+// GL_TIME_ELAPSED queries, and per-frame counters, kept as trace events that
+// can be written as Chrome trace-event JSON (chrome://tracing, Perfetto).
+// GPU results are collected once they are available, a few frames late, so
+// the CPU never waits on a query, and a frame's sections are shown only once
+// all of them are in. With enabled off every call returns at
+// once. Event and counter names must outlive the profiler, e.g. literals.
+// GL thread only.
+class Profiler {
+public:
+    static Profiler& instance();
+
+    bool enabled = false;
+
+    // A section of the last frame with results, for the overlay
+    struct Section {
+        const char* name;
+        double ms;
+    };
+
+    // Frame boundaries; endFrame also collects the finished GPU queries
+    void beginFrame();
+    void endFrame();
+
+    // CPU scopes nest; ProfileScope pairs the calls
+    void beginCpu(const char* name);
+    void endCpu();
+
+    // GPU sections cannot nest or overlap, as GL_TIME_ELAPSED queries cannot
+    void beginGpu(const char* name);
+    void endGpu();
+
+    // Value of a named counter for the current frame
+    void counter(const char* name, double value);
+
+    // Top-level CPU scopes of the last frame and the GPU sections of the
+    // latest frame whose queries have all finished
+    const std::vector<Section>& cpuSections() const {
+        return lastCpu;
+    }
+
+    const std::vector<Section>& gpuSections() const {
+        return lastGpu;
+    }
+
+    double lastFrameMs() const {
+        return lastFrame;
+    }
+
+    // Write every event recorded so far; false if path cannot be written
+    bool writeTrace(const std::string& path) const;
+
+    // GL thread: delete the queries, before the context goes away
+    void release();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Chrome trace threads the events are shown on
+    static const int CPU_TRACK = 1;
+    static const int GPU_TRACK = 2;
+    // Recording stops past this many events, so a long session stays bounded
+    static const size_t MAX_EVENTS = 1u << 20;
+
+    struct Event {
+        const char* name;
+        char phase;         // 'X' complete event or 'C' counter
+        int track;
+        double startUs;
+        double value;       // duration in us, or the counter value
+    };
+
+    struct OpenScope {
+        const char* name;
+        double startUs;
+        size_t event;       // index in events, or MAX_EVENTS when not recorded
+    };
+
+    struct GpuQuery {
+        GLuint query;
+        const char* name;
+        double issuedUs;    // CPU time the section began
+        unsigned long long frame;
+    };
+
+    Clock::time_point origin = Clock::now();
+    Clock::time_point frameStart;
+    std::vector<Event> events;
+    std::vector<OpenScope> openScopes;   // CPU scopes begun and not yet ended
+    std::vector<GpuQuery> pendingQueries; // in issue order
+    std::vector<GLuint> freeQueries;
+    GpuQuery openQuery = { 0, nullptr, 0.0, 0 };
+    double gpuCursorUs = 0.0;            // end of the last GPU event placed
+    unsigned long long frameNumber = 0;  // frames ended so far
+    std::vector<Section> frameCpu, lastCpu, lastGpu;
+    std::vector<Section> frameGpu;       // collected sections of gpuFrame
+    unsigned long long gpuFrame = 0;
+    double lastFrame = 0.0;
+
+    Profiler() = default;
+
+    double nowUs() const {
+        return std::chrono::duration<double, std::micro>(Clock::now() - origin).count();
+    }
+
+    void record(const Event& event) {
+        if (events.size() < MAX_EVENTS)
+            events.push_back(event);
+    }
+
+    void collectQueries();
+};
+
+// Times the enclosing block on the CPU
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : active(Profiler::instance().enabled) {
+        if (active)
+            Profiler::instance().beginCpu(name);
+    }
+
+    ~ProfileScope() {
+        if (active)
+            Profiler::instance().endCpu();
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    bool active;
+};
+
+// Times the GL commands issued in the enclosing block on the GPU
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char* name) : active(Profiler::instance().enabled) {
+        if (active)
+            Profiler::instance().beginGpu(name);
+    }
+
+    ~GpuProfileScope() {
+        if (active)
+            Profiler::instance().endGpu();
+    }
+
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    bool active;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef PROFILER_OVERLAY_H
+#define PROFILER_OVERLAY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <vector>
+#include "GLState.h"
+#include "Profiler.h"
+
+// Live view of the profiler in the top left corner of the screen: one bar of
+// the last frame's top-level CPU scopes and one of the latest GPU sections,
+// each section a colored segment as long as its time, against ticks at 16.7
+// and 33.3 ms. Draw it last, with depth testing that always passes.
+class ProfilerOverlay {
+public:
+    ProfilerOverlay() {
+        createProgram();
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        GLState::instance().bindVertexArray(VAO);
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+    }
+
+    ~ProfilerOverlay() {
+        GLState::instance().deleteVertexArrays(1, &VAO);
+        GLState::instance().deleteBuffers(1, &VBO);
+        GLState::instance().deleteProgram(program);
+    }
+
+    ProfilerOverlay(const ProfilerOverlay&) = delete;
+    ProfilerOverlay& operator=(const ProfilerOverlay&) = delete;
+
+    unsigned int getProgram() const {
+        return program;
+    }
+
+    void Draw() {
+        const Profiler& profiler = Profiler::instance();
+        vertices.clear();
+
+        // Background, then the two bars, then the ticks over them
+        quad(LEFT - 0.01f, TOP + 0.01f, LEFT + WIDTH + 0.01f, TOP - 2.0f * ROW - 0.01f, glm::vec3(0.05f));
+        bar(profiler.cpuSections(), TOP);
+        bar(profiler.gpuSections(), TOP - ROW);
+        for (float ms : { 1000.0f / 60.0f, 1000.0f / 30.0f }) {
+            float x = LEFT + WIDTH * ms / FULL_SCALE_MS;
+            quad(x - 0.001f, TOP + 0.01f, x + 0.001f, TOP - 2.0f * ROW - 0.01f, glm::vec3(1.0f));
+        }
+
+        GLState& state = GLState::instance();
+        state.useProgram(program);
+        state.bindVertexArray(VAO);
+        state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STREAM_DRAW);
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+    }
+
+private:
+    struct Vertex {
+        glm::vec2 position;
+        glm::vec3 color;
+    };
+
+    // In normalized device coordinates; the bars span FULL_SCALE_MS
+    static constexpr float LEFT = -0.98f;
+    static constexpr float TOP = 0.98f;
+    static constexpr float WIDTH = 0.8f;
+    static constexpr float ROW = 0.04f;
+    static constexpr float FULL_SCALE_MS = 40.0f;
+
+    unsigned int VAO, VBO, program;
+    std::vector<Vertex> vertices;
+
+    void quad(float left, float top, float right, float bottom, const glm::vec3& color) {
+        Vertex corners[4] = { { { left, top }, color }, { { right, top }, color },
+            { { right, bottom }, color }, { { left, bottom }, color } };
+        vertices.insert(vertices.end(), { corners[0], corners[1], corners[2], corners[0], corners[2], corners[3] });
+    }
+
+    // Sections side by side, each in its own color, clipped at full scale
+    void bar(const std::vector<Profiler::Section>& sections, float top) {
+        static const glm::vec3 palette[] = {
+            { 0.9f, 0.3f, 0.3f }, { 0.3f, 0.8f, 0.3f }, { 0.3f, 0.5f, 0.9f }, { 0.9f, 0.8f, 0.2f },
+            { 0.8f, 0.4f, 0.9f }, { 0.2f, 0.8f, 0.8f }, { 0.9f, 0.6f, 0.3f }, { 0.6f, 0.6f, 0.6f } };
+        float ms = 0.0f;
+        for (size_t i = 0; i < sections.size() && ms < FULL_SCALE_MS; i++) {
+            float end = glm::min(ms + (float)sections[i].ms, FULL_SCALE_MS);
+            quad(LEFT + WIDTH * ms / FULL_SCALE_MS, top, LEFT + WIDTH * end / FULL_SCALE_MS, top - ROW * 0.8f,
+                palette[i % (sizeof(palette) / sizeof(palette[0]))]);
+            ms = end;
+        }
+    }
+
+    void createProgram() {
+        const char* vertexSource = "#version 330 core\n"
+            "layout (location = 0) in vec2 aPos;\n"
+            "layout (location = 1) in vec3 aColor;\n"
+            "out vec3 color;\n"
+            "void main()\n"
+            "{\n"
+            "   color = aColor;\n"
+            "   gl_Position = vec4(aPos, 0.0, 1.0);\n"
+            "}\0";
+        const char* fragmentSource = "#version 330 core\n"
+            "in vec3 color;\n"
+            "out vec4 FragColor;\n"
+            "void main()\n"
+            "{\n"
+            "   FragColor = vec4(color, 1.0);\n"
+            "}\0";
+
+        unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertexShader, 1, &vertexSource, NULL);
+        glCompileShader(vertexShader);
+        unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+        glCompileShader(fragmentShader);
+
+        program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glLinkProgram(program);
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cout << "ERROR::PROFILER_OVERLAY::LINKING_FAILED\n" << infoLog << std::endl;
+        }
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+    }
+};
+
+#endif
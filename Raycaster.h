@@ -4,12 +4,18 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "Camera.h" // Ensure this is included to access the camera object
+#include "BVH.h"
+#include <cmath>
+#include <vector>
 
 class Raycaster {
 public:
     glm::vec3 origin;
     glm::vec3 direction;
 
+    // Rays of the last burst (e.g. shotgun pellets), all starting at origin
+    std::vector<Ray> burst;
+
     Raycaster() : origin(glm::vec3(0.0f)), direction(glm::vec3(0.0f)) {}
 
     void shootFromCamera(const Camera& camera) {
@@ -20,6 +26,48 @@ public:
         origin = camera.Position;
     }
 
+    // Test the current ray against a model's BVH placed in the world by
+    // modelMatrix. hit is only replaced by a closer hit; distances are in
+    // world units along the (normalized) direction.
+    bool intersect(const BVH& bvh, const glm::mat4& modelMatrix, RayHit& hit) const {
+        // Transform the ray into model space instead of every triangle into world space.
+        // The affine transform keeps the ray parameter, so distances stay comparable.
+        glm::mat4 worldToModel = glm::inverse(modelMatrix);
+        Ray ray;
+        ray.origin = glm::vec3(worldToModel * glm::vec4(origin, 1.0f));
+        ray.direction = glm::vec3(worldToModel * glm::vec4(direction, 0.0f));
+        return bvh.intersect(ray, hit);
+    }
+
+    // Fire pellets rays at once, spread evenly over a cone of spreadDegrees
+    // around the camera's front vector
+    void shootBurstFromCamera(const Camera& camera, unsigned int pellets, float spreadDegrees) {
+        shootFromCamera(camera);
+
+        burst.clear();
+        float spread = std::tan(glm::radians(spreadDegrees));
+        for (unsigned int i = 0; i < pellets; i++) {
+            // Golden-angle spiral gives an even pattern without randomness
+            float radius = spread * std::sqrt((i + 0.5f) / pellets);
+            float angle = i * 2.39996323f;
+            glm::vec3 offset = (camera.Right * std::cos(angle) + camera.Up * std::sin(angle)) * radius;
+            burst.push_back({ origin, glm::normalize(direction + offset) });
+        }
+    }
+
+    // Test every ray of the burst against a model's BVH placed by modelMatrix.
+    // hits must have one entry per burst ray; like intersect(), entries are
+    // only replaced by closer hits. The rays are traced together in SIMD packets.
+    void intersectBurst(const BVH& bvh, const glm::mat4& modelMatrix, std::vector<RayHit>& hits) const {
+        glm::mat4 worldToModel = glm::inverse(modelMatrix);
+        std::vector<Ray> rays(burst.size());
+        for (size_t i = 0; i < burst.size(); i++) {
+            rays[i].origin = glm::vec3(worldToModel * glm::vec4(burst[i].origin, 1.0f));
+            rays[i].direction = glm::vec3(worldToModel * glm::vec4(burst[i].direction, 0.0f));
+        }
+        bvh.intersectPackets(rays.data(), hits.data(), rays.size(), 8);
+    }
+
 };
 
 #endif
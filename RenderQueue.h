@@ -0,0 +1,230 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "Model.h"
+#include "ModelInstance.h"
+#include "GeometryArena.h"
+#include "GLState.h"
+#include "Frustum.h"
+#include "Shader.h"
+#include "Profiler.h"
+
+// Passes in the order they are drawn, the top bits of a sort key
+enum RenderPass {
+    RENDER_PASS_BACKGROUND = 0, // without depth writes, under everything drawn later
+    RENDER_PASS_OPAQUE = 1,
+    RENDER_PASS_SKY = 2,        // at the far plane with GL_LEQUAL, where nothing was drawn
+    RENDER_PASS_OVERLAY = 3     // over everything, depth test always passes
+};
+
+// Packet sort key, most significant bits first: pass (4), program (12),
+// material (24) and depth (24). In key order each pass is drawn program by
+// program, material by material, and near to far within those.
+inline uint64_t renderSortKey(RenderPass pass, unsigned int program, unsigned int material, float depth) {
+    uint64_t depthBits = (uint64_t)(glm::clamp(depth, 0.0f, 1.0f) * 0xFFFFFF);
+    return ((uint64_t)pass << 60) | ((uint64_t)(program & 0xFFF) << 48) | ((uint64_t)(material & 0xFFFFFF) << 24) | depthBits;
+}
+
+// The draws of a frame, collected in any order and submitted sorted by key.
+// Each pass sets the depth state it draws with and, while the profiler is
+// enabled, is timed as a GPU section. Submission remembers the
+// program, VAO, material and transform it left bound and skips binding them
+// again for the next packet; the binds it skipped are counted in
+// drawCounters().bindsAvoided.
+class RenderQueue {
+public:
+    // Start a frame. Depths are distances from eye over farDistance.
+    void begin(const glm::vec3& eye, float farDistance) {
+        packets.clear();
+        transforms.clear();
+        callbacks.clear();
+        this->eye = eye;
+        this->farDistance = farDistance;
+    }
+
+    // Queue the meshes of model whose bounds, placed by modelMatrix, touch the
+    // frustum, drawn with shader at level of detail lod
+    void add(const Shader& shader, const Model& model, const glm::mat4& modelMatrix, const glm::mat3& normalMatrix,
+        const Frustum& frustum, CullStats& stats, unsigned int lod = 0) {
+        const std::vector<Mesh>& meshes = model.getMeshes();
+        if (!frustum.isBoxVisible(model.getBoundsMin(), model.getBoundsMax(), modelMatrix)) {
+            stats.culled += (unsigned int)meshes.size();
+            return;
+        }
+
+        unsigned int transform = (unsigned int)transforms.size();
+        transforms.push_back({ modelMatrix, normalMatrix });
+        for (const Mesh& mesh : meshes) {
+            if (!frustum.isBoxVisible(mesh.boundsMin, mesh.boundsMax, modelMatrix)) {
+                stats.culled++;
+                continue;
+            }
+
+            glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+            Packet packet;
+            // Material 0 is left to callbacks
+            packet.key = renderSortKey(RENDER_PASS_OPAQUE, shader.ID, mesh.getMaterial() + 1, glm::length(center - eye) / farDistance);
+            packet.program = shader.ID;
+            packet.shader = &shader;
+            packet.mesh = &mesh;
+            packet.transform = transform;
+            packet.lod = lod;
+            packets.push_back(packet);
+            stats.drawn++;
+            stats.triangles += mesh.getTriangleCount(lod);
+        }
+    }
+
+    void add(const Shader& shader, const ModelInstance& instance, const Frustum& frustum, CullStats& stats) {
+        add(shader, instance.getModel(), instance.getModelMatrix(), instance.getNormalMatrix(), frustum, stats, instance.getLod());
+    }
+
+    // Queue a draw made by draw, which finds program in use and may leave
+    // anything else bound. Callbacks with equal keys keep the order they were
+    // added in.
+    void add(RenderPass pass, unsigned int program, float depth, std::function<void()> draw) {
+        Packet packet;
+        packet.key = renderSortKey(pass, program, 0, depth);
+        packet.program = program;
+        packet.callback = (unsigned int)callbacks.size();
+        packets.push_back(packet);
+        callbacks.push_back(std::move(draw));
+    }
+
+    // Draw everything queued, in key order
+    void submit() {
+        std::stable_sort(packets.begin(), packets.end(), [](const Packet& a, const Packet& b) {
+            return a.key < b.key;
+        });
+
+        static const char* const passNames[] = { "background pass", "opaque pass", "sky pass", "overlay pass" };
+        GLState& state = GLState::instance();
+        Profiler& profiler = Profiler::instance();
+        BoundState bound;
+        unsigned int pass = NONE;
+        for (const Packet& packet : packets) {
+            if (packet.key >> 60 != pass) {
+                pass = (unsigned int)(packet.key >> 60);
+                bool opaque = pass == RENDER_PASS_OPAQUE;
+                state.depthMask(opaque);
+                state.depthFunc(opaque ? GL_LESS : pass == RENDER_PASS_OVERLAY ? GL_ALWAYS : GL_LEQUAL);
+                if (profiler.enabled) {
+                    profiler.endGpu();
+                    profiler.beginGpu(passNames[pass]);
+                }
+            }
+
+            if (packet.program != bound.program) {
+                state.useProgram(packet.program);
+                bound = BoundState();
+                bound.program = packet.program;
+            }
+            else {
+                drawCounters().bindsAvoided++;
+            }
+
+            if (!packet.mesh) {
+                // Nothing is known about what the callback binds
+                callbacks[packet.callback]();
+                bound = BoundState();
+                bound.program = packet.program;
+                continue;
+            }
+
+            const Mesh& mesh = *packet.mesh;
+            const Shader& shader = *packet.shader;
+            if (mesh.VAO != bound.vertexArray) {
+                state.bindVertexArray(mesh.VAO);
+                drawCounters().vertexArrayBinds++;
+                bound.vertexArray = mesh.VAO;
+            }
+            else {
+                drawCounters().bindsAvoided++;
+            }
+
+            // Sampler uniforms are per program, and the program is unchanged
+            if (mesh.getMaterial() + 1 != bound.material) {
+                mesh.bindMaterial(shader);
+                bound.material = mesh.getMaterial() + 1;
+            }
+            else {
+                drawCounters().bindsAvoided += mesh.getTextureCount();
+            }
+            mesh.setPositionUniforms(shader);
+
+            if (packet.transform != bound.transform) {
+                const TransformHandles& handles = transformHandles(shader);
+                shader.set(handles.model, transforms[packet.transform].model);
+                shader.set(handles.normal, transforms[packet.transform].normal);
+                drawCounters().uniformUploads += 2;
+                bound.transform = packet.transform;
+            }
+
+            mesh.drawElements(packet.lod);
+        }
+        if (profiler.enabled)
+            profiler.endGpu();
+    }
+
+    size_t size() const {
+        return packets.size();
+    }
+
+private:
+    static const unsigned int NONE = ~0u;
+
+    struct Packet {
+        uint64_t key;
+        unsigned int program;
+        const Shader* shader = nullptr;
+        const Mesh* mesh = nullptr;  // null for callbacks
+        unsigned int transform = NONE;
+        unsigned int lod = 0;
+        unsigned int callback = NONE;
+    };
+
+    struct Transform {
+        glm::mat4 model;
+        glm::mat3 normal;
+    };
+
+    // Model and normal matrix uniforms of one program
+    struct TransformHandles {
+        unsigned int program;
+        UniformHandle<glm::mat4> model;
+        UniformHandle<glm::mat3> normal;
+    };
+
+    // What the packets so far left bound; 0 and NONE are unknown
+    struct BoundState {
+        unsigned int program = 0;
+        unsigned int vertexArray = 0;
+        unsigned int material = 0;
+        unsigned int transform = NONE;
+    };
+
+    std::vector<Packet> packets;
+    std::vector<Transform> transforms;
+    std::vector<std::function<void()>> callbacks;
+    std::vector<TransformHandles> handles;
+    glm::vec3 eye = glm::vec3(0.0f);
+    float farDistance = 1.0f;
+
+    // Handles are looked up once per program
+    const TransformHandles& transformHandles(const Shader& shader) {
+        for (const TransformHandles& entry : handles) {
+            if (entry.program == shader.ID)
+                return entry;
+        }
+        handles.push_back({ shader.ID, shader.uniform<glm::mat4>("model"), shader.uniform<glm::mat3>("normalMatrix") });
+        return handles.back();
+    }
+};
+
+#endif
@@ -6,15 +6,45 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 #include <glm/glm.hpp>
+#include "UniformBuffer.h"
+#include "GLState.h"
+
+// A resolved uniform location. The type parameter ties the handle to the
+// matching Shader::set overload, so hot paths never look up names or build
+// strings. Resolve handles once with Shader::uniform<T>(name).
+template <typename T>
+struct UniformHandle {
+    GLint location = -1;
+
+    bool valid() const { return location != -1; }
+};
+
+// GL type reported by glGetActiveUniform for each handle type
+template <typename T> struct UniformGLType;
+template <> struct UniformGLType<bool> { static bool matches(GLenum t) { return t == GL_BOOL; } };
+template <> struct UniformGLType<int> {
+    // Samplers are set through glUniform1i as well
+    static bool matches(GLenum t) {
+        return t == GL_INT || t == GL_BOOL || t == GL_SAMPLER_2D || t == GL_SAMPLER_CUBE || t == GL_SAMPLER_BUFFER;
+    }
+};
+template <> struct UniformGLType<float> { static bool matches(GLenum t) { return t == GL_FLOAT; } };
+template <> struct UniformGLType<glm::vec3> { static bool matches(GLenum t) { return t == GL_FLOAT_VEC3; } };
+template <> struct UniformGLType<glm::vec4> { static bool matches(GLenum t) { return t == GL_FLOAT_VEC4; } };
+template <> struct UniformGLType<glm::mat3> { static bool matches(GLenum t) { return t == GL_FLOAT_MAT3; } };
+template <> struct UniformGLType<glm::mat4> { static bool matches(GLenum t) { return t == GL_FLOAT_MAT4; } };
 
 class Shader {
 public:
     // Program ID
     unsigned int ID;
 
-    // Constructor reads and builds the shader
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) {
+    // Constructor reads and builds the shader. Optional defines, e.g.
+    // "#define NAME\n", are inserted after each stage's #version line.
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const char* defines = nullptr) {
         // 1. Retrieve the vertex/fragment/geometry source code from filePath
         std::string vertexCode, fragmentCode, geometryCode;
         std::ifstream vShaderFile, fShaderFile, gShaderFile;
@@ -56,6 +86,12 @@ public:
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
         }
 
+        if (defines) {
+            insertDefines(vertexCode, defines);
+            insertDefines(fragmentCode, defines);
+            insertDefines(geometryCode, defines);
+        }
+
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
 
@@ -93,6 +129,8 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        cacheUniforms();
+        bindUniformBlocks(ID);
 
         // Delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
@@ -103,35 +141,144 @@ public:
 
     // Use the shader
     void use() const {
-        glUseProgram(ID);
+        GLState::instance().useProgram(ID);
+    }
+
+    // Resolve a uniform handle from the cache built at link time. Missing
+    // uniforms (e.g. optimized out) give an invalid handle, which GL ignores.
+    template <typename T>
+    UniformHandle<T> uniform(const std::string& name) const {
+        UniformHandle<T> handle;
+        auto it = findUniform(name);
+        if (it != uniforms.end()) {
+            if (!UniformGLType<T>::matches(it->second.type))
+                std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH: " << name << std::endl;
+            handle.location = it->second.location;
+        }
+        return handle;
     }
 
-    // Utility uniform functions
+    // Typed uniform functions, used on hot paths
+    void set(UniformHandle<bool> handle, bool value) const {
+        glUniform1i(handle.location, (int)value);
+    }
+
+    void set(UniformHandle<int> handle, int value) const {
+        glUniform1i(handle.location, value);
+    }
+
+    void set(UniformHandle<float> handle, float value) const {
+        glUniform1f(handle.location, value);
+    }
+
+    void set(UniformHandle<glm::vec3> handle, const glm::vec3& value) const {
+        glUniform3fv(handle.location, 1, &value[0]);
+    }
+
+    void set(UniformHandle<glm::vec4> handle, const glm::vec4& value) const {
+        glUniform4fv(handle.location, 1, &value[0]);
+    }
+
+    void set(UniformHandle<glm::mat3> handle, const glm::mat3& mat) const {
+        glUniformMatrix3fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void set(UniformHandle<glm::mat4> handle, const glm::mat4& mat) const {
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // Utility uniform functions. These look the name up in the cache every
+    // call; prefer handles for anything that runs per frame.
     void setBool(const std::string& name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(getUniformLocation(name), (int)value);
     }
 
     void setInt(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(getUniformLocation(name), value);
     }
 
     void setFloat(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(getUniformLocation(name), value);
     }
 
     void setVec3(const std::string& name, const glm::vec3& value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(getUniformLocation(name), 1, &value[0]);
     }
 
     void setVec3(const std::string& name, float x, float y, float z) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(getUniformLocation(name), x, y, z);
     }
 
     void setMat4(const std::string& name, const glm::mat4& mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // Print every active uniform found at link time
+    void printActiveUniforms() const {
+        for (const auto& entry : uniforms)
+            std::cout << "Active uniform " << entry.first << " (location " << entry.second.location << ")" << std::endl;
+    }
+
+    // Number of by-name uniform lookups across all shaders since the last
+    // reset. Hot paths use handles, so this should stay at zero per frame.
+    static unsigned int& nameLookups() {
+        static unsigned int count = 0;
+        return count;
     }
 
 private:
+    struct UniformInfo {
+        GLint location;
+        GLenum type;
+    };
+
+    std::unordered_map<std::string, UniformInfo> uniforms;
+
+    // Introspect the active uniforms once so names never reach the driver again
+    void cacheUniforms() {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+
+        for (GLint i = 0; i < count; ++i) {
+            GLint size; GLenum type; GLsizei length;
+            glGetActiveUniform(ID, i, (GLsizei)name.size(), &length, &size, &type, name.data());
+            std::string uniformName(name.data(), length);
+            GLint location = glGetUniformLocation(ID, uniformName.c_str());
+            if (location == -1)
+                continue; // uniform block member
+
+            uniforms[uniformName] = { location, type };
+            // Arrays are reported as "name[0]"; also allow plain "name"
+            if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+                uniforms[uniformName.substr(0, uniformName.size() - 3)] = { location, type };
+        }
+    }
+
+    std::unordered_map<std::string, UniformInfo>::const_iterator findUniform(const std::string& name) const {
+        nameLookups()++;
+        return uniforms.find(name);
+    }
+
+    GLint getUniformLocation(const std::string& name) const {
+        auto it = findUniform(name);
+        return it != uniforms.end() ? it->second.location : -1;
+    }
+
+    // GLSL requires #version first, so defines go on the line after it
+    static void insertDefines(std::string& code, const char* defines) {
+        size_t version = code.find("#version");
+        if (version == std::string::npos)
+            return;
+        size_t lineEnd = code.find('\n', version);
+        if (lineEnd == std::string::npos) {
+            code += '\n';
+            lineEnd = code.size() - 1;
+        }
+        code.insert(lineEnd + 1, defines);
+    }
+
     // Utility function for checking shader compilation/linking errors
     void checkCompileErrors(unsigned int shader, const std::string& type) const {
         int success;
@@ -1,5 +1,6 @@
-#include "skybox.h"
-#define STB_IMAGE_IMPLEMENTATION
+#include "Skybox.h"
+#include "UniformBuffer.h"
+#include "GLState.h"
 #include "stb_image.h"
 #include <iostream>
 
@@ -10,10 +11,10 @@ Skybox::Skybox(const std::vector<std::string>& faces) {
 }
 
 Skybox::~Skybox() {
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteProgram(shaderProgram);
-    glDeleteTextures(1, &textureID);
+    GLState::instance().deleteVertexArrays(1, &VAO);
+    GLState::instance().deleteBuffers(1, &VBO);
+    GLState::instance().deleteProgram(shaderProgram);
+    GLState::instance().deleteTextures(1, &textureID);
 }
 
 void Skybox::setupSkybox() {
@@ -69,12 +70,12 @@ void Skybox::setupSkybox() {
 
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLState::instance().bindVertexArray(VAO);
+    GLState::instance().bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glBindVertexArray(0);
+    GLState::instance().bindVertexArray(0);
 }
 
 void Skybox::createShader() {
@@ -83,12 +84,16 @@ void Skybox::createShader() {
     const char* vertexShaderSource = "#version 330 core\n"
         "layout (location = 0) in vec3 aPos;\n"
         "out vec3 TexCoords;\n"
-        "uniform mat4 projection;\n"
-        "uniform mat4 view;\n"
+        "layout (std140) uniform FrameData {\n"
+        "    mat4 view;\n"
+        "    mat4 projection;\n"
+        "    vec3 viewPos;\n"
+        "};\n"
         "void main()\n"
         "{\n"
         "   TexCoords = aPos;\n"
-        "   vec4 pos = projection * view * vec4(aPos, 1.0);\n"
+        "   // Remove translation from view matrix\n"
+        "   vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);\n"
         "   gl_Position = pos.xyww;\n"
         "}\0";
     glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
@@ -125,12 +130,17 @@ void Skybox::createShader() {
     // Clean up shaders
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
+
+    // The sampler always reads texture unit 0
+    bindUniformBlocks(shaderProgram);
+    GLState::instance().useProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "skybox"), 0);
 }
 
 unsigned int Skybox::loadCubemap(const std::vector<std::string>& faces) {
     unsigned int textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    GLState::instance().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
     int width, height, nrChannels;
     for (unsigned int i = 0; i < faces.size(); i++) {
@@ -160,32 +170,15 @@ unsigned int Skybox::loadCubemap(const std::vector<std::string>& faces) {
     return textureID;
 }
 
-void Skybox::Draw(const glm::mat4& view, const glm::mat4& projection) {
-    // Disable depth writing
-    glDepthMask(GL_FALSE);
-    glDepthFunc(GL_LEQUAL);
-
-    // Use skybox shader
-    glUseProgram(shaderProgram);
-
-    // Remove translation from view matrix
-    glm::mat4 viewNoTranslation = glm::mat4(glm::mat3(view));
+void Skybox::Draw() {
+    GLState& state = GLState::instance();
 
-    // Set uniforms
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(viewNoTranslation));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    // Behind everything: no depth writes, and passes at the far plane
+    state.depthMask(false);
+    state.depthFunc(GL_LEQUAL);
 
-    // Bind cubemap
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-    glUniform1i(glGetUniformLocation(shaderProgram, "skybox"), 0);
-
-    // Render skybox
-    glBindVertexArray(VAO);
+    state.useProgram(shaderProgram);
+    state.bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
+    state.bindVertexArray(VAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-
-    // Restore depth settings
-    glDepthMask(GL_TRUE);
-    glDepthFunc(GL_LESS);
-}
\ No newline at end of file
+}
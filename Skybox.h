@@ -14,7 +14,13 @@ public:
     Skybox(const std::vector<std::string>& faces);
     ~Skybox();
 
-    void Draw(const glm::mat4& view, const glm::mat4& projection);
+    // View and projection come from the shared FrameData uniform block
+    void Draw();
+
+    // The program Draw uses
+    unsigned int getProgram() const {
+        return shaderProgram;
+    }
 
 private:
     unsigned int VAO, VBO;
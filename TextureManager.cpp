@@ -0,0 +1,593 @@
+#include "TextureManager.h"
+#include <glad/glad.h>
+#include "GLState.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// Extension formats, not in the GL 3.3 core headers
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+static GLenum glBlockFormat(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+    case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+    case BlockFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return GL_NONE;
+}
+
+// Grey images live in red, and grey + alpha in red and green; sample them as grey
+static void setGreySwizzle(int components) {
+    if (components == 1) {
+        GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    else if (components == 2) {
+        GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+}
+
+// Pixel format of a decoded image with components channels
+static GLenum imageFormat(int components) {
+    if (components == 1)
+        return GL_RED;
+    if (components == 2)
+        return GL_RG;
+    if (components == 4)
+        return GL_RGBA;
+    return GL_RGB;
+}
+
+// 64-bit multiply-xor hash of the image size and data, eight bytes at a time
+static uint64_t hashImage(uint32_t format, uint32_t width, uint32_t height, const unsigned char* data, size_t size) {
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = (hash ^ format) * prime;
+    hash = (hash ^ width) * prime;
+    hash = (hash ^ height) * prime;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ data[i]) * prime;
+    return hash;
+}
+
+// A second 64-bit hash of image data, multiply-rotate rather than
+// multiply-xor, that confirms a hashImage match
+static uint64_t checkImage(const unsigned char* data, size_t size) {
+    const uint64_t prime = 0xc4ceb9fe1a85ec53ULL;
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ size;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash += word * 0xff51afd7ed558ccdULL;
+        hash = (hash << 31 | hash >> 33) * prime;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ data[i]) * prime;
+    return hash ^ hash >> 33;
+}
+
+// Bytes of levels [first, last) of a baked mip chain
+static size_t levelBytes(const Ktx2Texture& texture, unsigned int first, unsigned int last) {
+    size_t bytes = 0;
+    for (unsigned int i = first; i < last; i++)
+        bytes += texture.levels[i].size;
+    return bytes;
+}
+
+TextureManager& TextureManager::instance() {
+    static TextureManager manager;
+    return manager;
+}
+
+TextureManager::~TextureManager() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopStreaming = true;
+    }
+    loadCondition.notify_all();
+    if (streamThread.joinable())
+        streamThread.join();
+}
+
+void TextureManager::detectCompressedFormats() {
+    GLint major = 0, minor = 0, extensions = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+
+    rgtc = major >= 3; // core since 3.0
+    bptc = major > 4 || (major == 4 && minor >= 2);
+    for (GLint i = 0; i < extensions; i++) {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+            s3tc = true;
+        else if (std::strcmp(name, "GL_ARB_texture_compression_bptc") == 0)
+            bptc = true;
+    }
+}
+
+bool TextureManager::supportsFormat(BlockFormat format) const {
+    switch (format) {
+    case BlockFormat::BC1:
+    case BlockFormat::BC3:
+        return s3tc;
+    case BlockFormat::BC4:
+    case BlockFormat::BC5:
+        return rgtc;
+    case BlockFormat::BC7:
+        return bptc;
+    }
+    return false;
+}
+
+std::string TextureManager::canonicalPath(const std::string& directory, const std::string& path) {
+    std::string full = directory.empty() ? path : directory + '/' + path;
+    for (char& c : full) {
+        if (c == '\\')
+            c = '/';
+    }
+
+    // Resolve "." and ".." segments and repeated separators
+    std::vector<std::string> segments;
+    size_t start = 0;
+    while (start <= full.size()) {
+        size_t end = full.find('/', start);
+        if (end == std::string::npos)
+            end = full.size();
+        std::string segment = full.substr(start, end - start);
+        if (segment == "..") {
+            if (!segments.empty() && segments.back() != "..")
+                segments.pop_back();
+            else
+                segments.push_back(segment);
+        }
+        else if (!segment.empty() && segment != ".") {
+            segments.push_back(segment);
+        }
+        start = end + 1;
+    }
+
+    std::string canonical = !full.empty() && full[0] == '/' ? "/" : "";
+    for (size_t i = 0; i < segments.size(); i++) {
+        if (i > 0)
+            canonical += '/';
+        canonical += segments[i];
+    }
+    return canonical;
+}
+
+std::shared_ptr<TextureEntry> TextureManager::request(const std::string& directory, const std::string& path, bool& decode) {
+    std::string key = canonicalPath(directory, path);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+        decode = false;
+        return found->second;
+    }
+
+    std::shared_ptr<TextureEntry> entry(new TextureEntry());
+    entry->key = key;
+    entry->image.path = path;
+    entries[key] = entry;
+    decode = true;
+    return entry;
+}
+
+void TextureManager::decode(TextureEntry& entry) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // A baked file the GPU can sample is only mapped, never decoded or even
+    // read: its hash was stored when it was baked
+    std::unique_ptr<Ktx2Texture> compressed(new Ktx2Texture());
+    if (readKtx2(entry.key, *compressed) && supportsFormat(compressed->format)) {
+        entry.contentHash = compressed->contentHash;
+        entry.compressed = std::move(compressed);
+    }
+    else {
+        decodeImageFile(entry.key, entry.image);
+        const ImageData& image = entry.image;
+        if (image.pixels) {
+            size_t size = (size_t)image.width * image.height * image.components;
+            entry.contentHash = hashImage((uint32_t)image.components, (uint32_t)image.width, (uint32_t)image.height,
+                image.pixels.get(), size);
+            entry.checkHash = checkImage(image.pixels.get(), size);
+        }
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entry.decoded = true;
+        if (entry.compressed)
+            compressedLoads++;
+        else
+            decodes++;
+        decodeMs += ms;
+        ready.swap(entry.waiters);
+    }
+    decodedCondition.notify_all();
+    for (std::function<void()>& callback : ready)
+        callback();
+}
+
+void TextureManager::whenDecoded(TextureEntry& entry, std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!entry.decoded) {
+            entry.waiters.push_back(std::move(callback));
+            return;
+        }
+    }
+    callback();
+}
+
+void TextureManager::waitDecoded(TextureEntry& entry) {
+    std::unique_lock<std::mutex> lock(mutex);
+    decodedCondition.wait(lock, [&entry] { return entry.decoded; });
+}
+
+unsigned int TextureManager::acquire(TextureEntry& entry) {
+    std::unique_lock<std::mutex> lock(mutex);
+    size_t bytes = (size_t)entry.image.width * entry.image.height * entry.image.components * 4 / 3; // with mipmaps
+
+    // Already uploaded for this path
+    if (entry.id != 0) {
+        GpuTexture& texture = textures[entry.id];
+        texture.refs++;
+        sharedByPath++;
+        bytesSaved += texture.bytes;
+        return entry.id;
+    }
+
+    // The same pixels were uploaded under another path
+    if (entry.image.pixels || entry.compressed) {
+        auto found = byContent.find(entry.contentHash);
+        bool same = false;
+        if (found != byContent.end()) {
+            // Only the GL thread changes the textures, so the candidate stays
+            // put while decode workers get the lock
+            lock.unlock();
+            same = sameContent(entry, textures[found->second]);
+            lock.lock();
+        }
+        if (same) {
+            GpuTexture& texture = textures[found->second];
+            texture.refs++;
+            texture.keys.push_back(entry.key);
+            entry.id = found->second;
+            entry.image.pixels.reset();
+            entry.compressed.reset();
+            sharedByContent++;
+            bytesSaved += texture.bytes;
+            return entry.id;
+        }
+    }
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    unsigned int startupLevel = 0;
+    if (entry.compressed) {
+        // Only the small levels for now, finer ones are streamed when wanted.
+        // The driver just copies the blocks.
+        const Ktx2Texture& compressed = *entry.compressed;
+        startupLevel = (unsigned int)compressed.levels.size() - 1;
+        while (startupLevel > 0 &&
+            std::max(compressed.levels[startupLevel - 1].width, compressed.levels[startupLevel - 1].height) <= streaming.startupSize)
+            startupLevel--;
+
+        bytes = 0;
+        GLState::instance().bindTexture(GL_TEXTURE_2D, textureID);
+        for (unsigned int i = startupLevel; i < compressed.levels.size(); i++) {
+            const Ktx2Texture::Level& level = compressed.levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, glBlockFormat(compressed.format), level.width, level.height, 0,
+                (GLsizei)level.size, level.data);
+            bytes += level.size;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)startupLevel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)compressed.levels.size() - 1);
+        if (compressed.format == BlockFormat::BC4)
+            setGreySwizzle(1);
+        else if (compressed.format == BlockFormat::BC5)
+            setGreySwizzle(2);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        byContent[entry.contentHash] = textureID;
+        uploads++;
+        compressedUploads++;
+    }
+    else if (entry.image.pixels) {
+        const ImageData& image = entry.image;
+        GLenum format = imageFormat(image.components);
+
+        // Rows of 1-3 component images need not be 4-byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        GLState::instance().bindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        setGreySwizzle(image.components);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        byContent[entry.contentHash] = textureID;
+        uploads++;
+    }
+
+    GpuTexture& texture = textures[textureID];
+    texture.refs = 1;
+    texture.bytes = entry.image.pixels || entry.compressed ? bytes : 0;
+    texture.contentHash = entry.contentHash;
+    texture.keys.push_back(entry.key);
+    if (entry.image.pixels) {
+        texture.width = entry.image.width;
+        texture.height = entry.image.height;
+        texture.components = entry.image.components;
+        texture.checkHash = entry.checkHash;
+    }
+    if (entry.compressed) {
+        // Keep the file mapped to stream the rest from
+        texture.source = std::move(entry.compressed);
+        texture.serial = nextSerial++;
+        texture.startupLevel = texture.residentLevel = texture.wantedLevel = texture.targetLevel = startupLevel;
+    }
+
+    // The GPU has the pixels now
+    entry.id = textureID;
+    entry.image.pixels.reset();
+    entry.compressed.reset();
+    return textureID;
+}
+
+void TextureManager::release(unsigned int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = textures.find(id);
+    if (found == textures.end() || --found->second.refs > 0)
+        return;
+
+    // Last user gone: forget every path and the content that led here
+    for (const std::string& key : found->second.keys)
+        entries.erase(key);
+    auto content = byContent.find(found->second.contentHash);
+    if (content != byContent.end() && content->second == id)
+        byContent.erase(content);
+    textures.erase(found);
+    GLState::instance().deleteTextures(1, &id);
+}
+
+void TextureManager::report() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t bytesInUse = 0;
+    unsigned int refs = 0;
+    for (const auto& texture : textures) {
+        bytesInUse += texture.second.bytes;
+        refs += texture.second.refs;
+    }
+
+    std::cout << "Textures: " << textures.size() << " on the GPU (" << bytesInUse / (1024.0 * 1024.0) << " MB) for "
+        << refs << " references; " << decodes << " decoded and " << compressedLoads << " compressed images loaded in "
+        << decodeMs << " ms; " << uploads << " uploads (" << compressedUploads << " compressed), "
+        << sharedByPath << " shared by path, " << sharedByContent << " by content, "
+        << bytesSaved / (1024.0 * 1024.0) << " MB saved" << std::endl;
+}
+
+void TextureManager::configureStreaming(const StreamingSettings& settings) {
+    std::lock_guard<std::mutex> lock(mutex);
+    streaming = settings;
+}
+
+void TextureManager::requestDetail(unsigned int id, float pixels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = textures.find(id);
+    if (found != textures.end())
+        found->second.pixels = std::max(found->second.pixels, pixels);
+}
+
+void TextureManager::updateStreaming() {
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Startup levels and decoded images are always resident; what is left
+        // of the budget goes to the most visible textures first
+        size_t granted = 0;
+        std::vector<std::pair<float, GpuTexture*>> byVisibility;
+        for (auto& pair : textures) {
+            GpuTexture& texture = pair.second;
+            if (!texture.source) {
+                granted += texture.bytes;
+                continue;
+            }
+            const Ktx2Texture& source = *texture.source;
+            granted += levelBytes(source, texture.startupLevel, (unsigned int)source.levels.size());
+
+            // One texel per pixel: each halving of the screen size drops a level
+            float size = (float)std::max(source.width, source.height);
+            texture.wantedLevel = texture.startupLevel;
+            if (texture.pixels > 0.0f) {
+                float level = std::log2(size / texture.pixels);
+                texture.wantedLevel = level <= 0.0f ? 0 : std::min((unsigned int)level, texture.startupLevel);
+            }
+            byVisibility.push_back(std::make_pair(texture.pixels / size, &texture));
+            texture.pixels = 0.0f;
+        }
+        std::sort(byVisibility.begin(), byVisibility.end(),
+            [](const std::pair<float, GpuTexture*>& a, const std::pair<float, GpuTexture*>& b) { return a.first > b.first; });
+        for (auto& pair : byVisibility) {
+            GpuTexture& texture = *pair.second;
+            unsigned int level = texture.startupLevel;
+            while (level > texture.wantedLevel && granted + texture.source->levels[level - 1].size <= streaming.budgetBytes) {
+                level--;
+                granted += texture.source->levels[level].size;
+            }
+            texture.targetLevel = level;
+        }
+
+        // Evict what is no longer wanted, then ask for the next finer level
+        for (auto& pair : textures) {
+            GpuTexture& texture = pair.second;
+            if (!texture.source)
+                continue;
+            while (texture.residentLevel < texture.targetLevel)
+                evictLevel(pair.first, texture);
+            if (!texture.loading && texture.residentLevel > texture.targetLevel) {
+                LevelLoad load;
+                load.id = pair.first;
+                load.serial = texture.serial;
+                load.level = texture.residentLevel - 1;
+                load.source = texture.source;
+                texture.loading = true;
+                if (streaming.synchronous) {
+                    const Ktx2Texture::Level& level = load.source->levels[load.level];
+                    load.data.assign(level.data, level.data + level.size);
+                    loadedQueue.push_back(std::move(load));
+                }
+                else {
+                    loadQueue.push_back(std::move(load));
+                    queued = true;
+                }
+            }
+        }
+
+        // Upload what was read, at least one level per frame
+        size_t uploaded = 0;
+        while (!loadedQueue.empty() && (uploaded == 0 || uploaded + loadedQueue.front().data.size() <= streaming.uploadBytesPerFrame)) {
+            LevelLoad load = std::move(loadedQueue.front());
+            loadedQueue.pop_front();
+            auto found = textures.find(load.id);
+            if (found == textures.end() || found->second.serial != load.serial)
+                continue; // released meanwhile
+
+            GpuTexture& texture = found->second;
+            texture.loading = false;
+            if (load.level + 1 != texture.residentLevel || load.level < texture.targetLevel)
+                continue; // no longer wanted
+            uploadLevel(load.id, texture, load.level, load.data.data(), load.data.size());
+            uploaded += load.data.size();
+        }
+
+        if (queued && !streamThread.joinable())
+            streamThread = std::thread(&TextureManager::streamLoop, this);
+    }
+    if (queued)
+        loadCondition.notify_one();
+}
+
+// A hash hit is only a likely match: compare the baked levels, or the size
+// and second hash of decoded images, before sharing
+bool TextureManager::sameContent(const TextureEntry& entry, const GpuTexture& texture) {
+    if (entry.compressed) {
+        const Ktx2Texture& a = *entry.compressed;
+        if (!texture.source)
+            return false;
+        const Ktx2Texture& b = *texture.source;
+        if (a.format != b.format || a.width != b.width || a.height != b.height || a.levels.size() != b.levels.size())
+            return false;
+        for (size_t i = 0; i < a.levels.size(); i++) {
+            if (a.levels[i].size != b.levels[i].size || std::memcmp(a.levels[i].data, b.levels[i].data, a.levels[i].size) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    const ImageData& image = entry.image;
+    return !texture.source && image.width == texture.width && image.height == texture.height &&
+        image.components == texture.components && entry.checkHash == texture.checkHash;
+}
+
+void TextureManager::uploadLevel(unsigned int id, GpuTexture& texture, unsigned int level, const uint8_t* data, size_t size) {
+    const Ktx2Texture::Level& info = texture.source->levels[level];
+    GLState::instance().bindTexture(GL_TEXTURE_2D, id);
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, glBlockFormat(texture.source->format), info.width, info.height, 0,
+        (GLsizei)size, data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)level);
+    texture.residentLevel = level;
+    texture.bytes += size;
+    levelsStreamed++;
+}
+
+void TextureManager::evictLevel(unsigned int id, GpuTexture& texture) {
+    // Stop sampling the level, then free it by redefining it as empty
+    unsigned int level = texture.residentLevel;
+    GLState::instance().bindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)level + 1);
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, glBlockFormat(texture.source->format), 0, 0, 0, 0, nullptr);
+    texture.residentLevel = level + 1;
+    texture.bytes -= texture.source->levels[level].size;
+    levelsEvicted++;
+}
+
+// Background thread: read each queued level out of its mapped file so page
+// faults and disk reads never stall the GL thread
+void TextureManager::streamLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        loadCondition.wait(lock, [this] { return stopStreaming || !loadQueue.empty(); });
+        if (stopStreaming)
+            return;
+        LevelLoad load = std::move(loadQueue.front());
+        loadQueue.pop_front();
+        lock.unlock();
+
+        const Ktx2Texture::Level& level = load.source->levels[load.level];
+        load.data.assign(level.data, level.data + level.size);
+
+        lock.lock();
+        loadedQueue.push_back(std::move(load));
+    }
+}
+
+TextureResidency TextureManager::residency() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    TextureResidency residency;
+    residency.budgetBytes = streaming.budgetBytes;
+    residency.pendingLoads = (unsigned int)(loadQueue.size() + loadedQueue.size());
+    residency.levelsStreamed = levelsStreamed;
+    residency.levelsEvicted = levelsEvicted;
+    for (const auto& pair : textures) {
+        const GpuTexture& texture = pair.second;
+        residency.textures++;
+        residency.residentBytes += texture.bytes;
+        if (!texture.source) {
+            residency.wantedBytes += texture.bytes;
+            continue;
+        }
+        residency.streamed++;
+        residency.wantedBytes += levelBytes(*texture.source, texture.wantedLevel, (unsigned int)texture.source->levels.size());
+        if (texture.residentLevel <= texture.wantedLevel)
+            residency.atWantedDetail++;
+    }
+    return residency;
+}
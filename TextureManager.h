@@ -0,0 +1,185 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ModelData.h"
+#include "Ktx2.h"
+
+// One image file known to the TextureManager. Workers either map its baked
+// KTX2 file or decode it into image; the GL thread uploads it and frees the
+// CPU copy.
+struct TextureEntry {
+    std::string key;           // canonical path of the file
+    ImageData image;           // decoded pixels, until uploaded
+    std::unique_ptr<Ktx2Texture> compressed; // baked mip chain, used instead of image
+    uint64_t contentHash = 0;  // hash of the pixels or compressed data
+    uint64_t checkHash = 0;    // second hash of decoded pixels
+    unsigned int id = 0;       // GL texture, 0 until uploaded
+
+    // Guarded by the manager's mutex
+    bool decoded = false;
+    std::vector<std::function<void()>> waiters;
+};
+
+// Texture streaming limits, see TextureManager::configureStreaming
+struct StreamingSettings {
+    size_t budgetBytes = 256u << 20;        // GPU memory for all textures
+    unsigned int startupSize = 64;          // levels this large or smaller are uploaded at once
+    size_t uploadBytesPerFrame = 4u << 20;  // streamed level data uploaded per frame
+    bool synchronous = false;               // read levels on the GL thread, so every run streams alike
+};
+
+// Residency of every texture, see TextureManager::residency
+struct TextureResidency {
+    unsigned int textures = 0;       // on the GPU
+    unsigned int streamed = 0;       // of which have a baked mip chain to stream
+    unsigned int atWantedDetail = 0; // streamed textures with every level they want
+    size_t residentBytes = 0;        // GPU memory in use
+    size_t wantedBytes = 0;          // GPU memory if every texture had the levels it wants
+    size_t budgetBytes = 0;
+    unsigned int pendingLoads = 0;   // levels being read in the background
+    unsigned int levelsStreamed = 0; // since startup
+    unsigned int levelsEvicted = 0;
+};
+
+// Process-wide texture cache shared by every Model. Image files are keyed by
+// canonical path, so each file is decoded and uploaded once however many
+// models use it; files with identical pixels under different paths share one
+// GL texture, found through a content hash and confirmed by comparing the
+// baked levels byte for byte, or decoded pixels by a second hash.
+// Textures are reference counted and deleted when the last model releases
+// them. Images with a fresh baked KTX2 file in a format the GPU supports are
+// uploaded compressed, without decoding.
+//
+// Compressed textures are streamed: only their smallest levels are uploaded
+// at first, and finer ones are read on a background thread as the scene asks
+// for them through requestDetail, coarse to fine. Levels nobody wants any
+// more, or that do not fit the budget, are evicted, least visible first.
+// Decoded images have no mip chain on disk and are always fully resident.
+class TextureManager {
+public:
+    static TextureManager& instance();
+    ~TextureManager();
+
+    // GL thread, once before any loading: find which block formats the GPU
+    // can sample. Until then only uncompressed images are used.
+    void detectCompressedFormats();
+    bool supportsFormat(BlockFormat format) const;
+
+    // "dir/./a/../b.png" and "dir\b.png" both become "dir/b.png"
+    static std::string canonicalPath(const std::string& directory, const std::string& path);
+
+    // Any thread: the entry of an image file, created on first request. The
+    // first requester gets decode set and must call decode() for it.
+    std::shared_ptr<TextureEntry> request(const std::string& directory, const std::string& path, bool& decode);
+
+    // Any thread: decode the entry's file, then run whoever waits for it
+    void decode(TextureEntry& entry);
+
+    // Any thread: run callback once entry is decoded (right away if it is)
+    void whenDecoded(TextureEntry& entry, std::function<void()> callback);
+
+    // Block until entry is decoded
+    void waitDecoded(TextureEntry& entry);
+
+    // GL thread: the texture of a decoded entry, uploaded on first use.
+    // Every acquire must be matched by a release.
+    unsigned int acquire(TextureEntry& entry);
+    void release(unsigned int id);
+
+    // Print the texture count, GPU memory in use and memory saved by sharing
+    void report() const;
+
+    // Before loading: the streaming budget and startup levels
+    void configureStreaming(const StreamingSettings& settings);
+
+    // GL thread, every frame: texture id is drawn covering about pixels
+    // pixels across the screen. The largest request of the frame counts.
+    void requestDetail(unsigned int id, float pixels);
+
+    // GL thread, once per frame after the requests: choose the levels each
+    // texture should have within the budget, evict the extra ones, queue
+    // loads and upload the levels read since the last frame
+    void updateStreaming();
+
+    TextureResidency residency() const;
+
+private:
+    TextureManager() = default;
+
+    struct GpuTexture {
+        unsigned int refs = 0;
+        size_t bytes = 0;              // of the resident levels
+        uint64_t contentHash = 0;
+        std::vector<std::string> keys; // paths that resolved to this texture
+        int width = 0, height = 0, components = 0; // of a decoded image
+        uint64_t checkHash = 0;
+
+        // Streaming, for compressed textures only
+        std::shared_ptr<Ktx2Texture> source; // mapped mip chain, null if not streamed
+        uint64_t serial = 0;            // tells loads of a reused GL id apart
+        unsigned int startupLevel = 0;  // coarser levels are always resident
+        unsigned int residentLevel = 0; // finest level on the GPU
+        unsigned int wantedLevel = 0;   // finest level the requests call for
+        unsigned int targetLevel = 0;   // the same, within the budget
+        bool loading = false;           // residentLevel - 1 is being read
+        float pixels = 0.0f;            // largest request this frame
+    };
+
+    // A level read in the background, waiting for upload
+    struct LevelLoad {
+        unsigned int id = 0;
+        uint64_t serial = 0;
+        unsigned int level = 0;
+        std::shared_ptr<Ktx2Texture> source;
+        std::vector<uint8_t> data;
+    };
+
+    static bool sameContent(const TextureEntry& entry, const GpuTexture& texture);
+    void uploadLevel(unsigned int id, GpuTexture& texture, unsigned int level, const uint8_t* data, size_t size);
+    void evictLevel(unsigned int id, GpuTexture& texture);
+    void streamLoop();
+
+    mutable std::mutex mutex;
+    std::condition_variable decodedCondition;
+    std::unordered_map<std::string, std::shared_ptr<TextureEntry>> entries; // by canonical path
+    std::unordered_map<uint64_t, unsigned int> byContent;                   // content hash to texture
+    std::unordered_map<unsigned int, GpuTexture> textures;                  // by GL id
+
+    // Written by detectCompressedFormats before loading starts, then read only
+    bool s3tc = false;  // BC1, BC3
+    bool rgtc = false;  // BC4, BC5
+    bool bptc = false;  // BC7
+
+    // Streaming state; the loads are guarded by the mutex
+    StreamingSettings streaming;
+    std::thread streamThread;
+    std::condition_variable loadCondition;
+    std::deque<LevelLoad> loadQueue;  // for the thread to read
+    std::deque<LevelLoad> loadedQueue; // read, for the GL thread to upload
+    bool stopStreaming = false;
+    uint64_t nextSerial = 1;
+    unsigned int levelsStreamed = 0;
+    unsigned int levelsEvicted = 0;
+
+    // Totals for report()
+    unsigned int decodes = 0;
+    unsigned int compressedLoads = 0;
+    double decodeMs = 0.0; // decoding or mapping, summed over all workers
+    unsigned int uploads = 0;
+    unsigned int compressedUploads = 0;
+    unsigned int sharedByPath = 0;
+    unsigned int sharedByContent = 0;
+    size_t bytesSaved = 0;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "GLState.h"
+
+// Binding points of the uniform blocks shared by every program. Shaders
+// declare the blocks by name and are bound to these points after linking.
+enum UniformBlockBinding {
+    FRAME_DATA_BINDING = 0,
+    LIGHT_DATA_BINDING = 1
+};
+
+// std140 mirror of the FrameData block (updated once per frame)
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 viewPos;    // xyz = camera position
+};
+
+// std140 mirror of the LightData block (updated only when the light changes)
+struct LightData {
+    glm::vec4 position;   // xyz used, vec3 members are padded to 16 bytes
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+};
+
+// Attach the program's FrameData/LightData blocks, if it declares them, to
+// the shared binding points
+inline void bindUniformBlocks(unsigned int program) {
+    GLuint frameIndex = glGetUniformBlockIndex(program, "FrameData");
+    if (frameIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, frameIndex, FRAME_DATA_BINDING);
+
+    GLuint lightIndex = glGetUniformBlockIndex(program, "LightData");
+    if (lightIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, lightIndex, LIGHT_DATA_BINDING);
+}
+
+// A uniform buffer holding one std140 struct, bound to a fixed binding point
+template <typename T>
+class UniformBuffer {
+public:
+    UniformBuffer(unsigned int binding) {
+        glGenBuffers(1, &UBO);
+        GLState::instance().bindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        GLState::instance().bindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+        GLState::instance().bindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    ~UniformBuffer() {
+        GLState::instance().deleteBuffers(1, &UBO);
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    // Upload the whole block in a single write
+    void update(const T& data) {
+        GLState::instance().bindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+    }
+
+private:
+    unsigned int UBO;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <cstdint>
+#include <vector>
+#include "ModelData.h"
+
+// Compressed vertex, half the size of Vertex. The position is 16-bit unsigned
+// normalized within the mesh AABB, which the vertex shader maps back with
+// positionOffset and positionScale; the normal is signed normalized 10-10-10-2
+// and the texture coordinates are half floats.
+struct PackedVertex {
+    uint16_t position[4]; // w unused, keeps the normal 4-byte aligned
+    uint32_t normal;
+    uint16_t texCoords[2];
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must be 16 bytes");
+
+// Half floats step by 1/1024 between 1 and 2, about a texel of a 1024 texture;
+// meshes with coordinates beyond this keep full floats
+const float PACKED_TEXCOORD_LIMIT = 2.0f;
+
+// Whether meshes uploaded from now on are packed, with 16-bit indices when
+// they have fewer than 65536 vertices. Set before loading.
+inline bool& vertexCompression() {
+    static bool enabled = true;
+    return enabled;
+}
+
+// Pack vertices within boundsMin-boundsMax. Fails, leaving packed empty, when
+// the texture coordinates would lose too much precision as half floats.
+inline bool packVertices(const std::vector<Vertex>& vertices, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+    std::vector<PackedVertex>& packed) {
+    packed.clear();
+    for (const Vertex& vertex : vertices) {
+        if (glm::any(glm::greaterThan(glm::abs(vertex.TexCoords), glm::vec2(PACKED_TEXCOORD_LIMIT))))
+            return false;
+    }
+
+    glm::vec3 extent = boundsMax - boundsMin;
+    glm::vec3 toUnit = glm::vec3(
+        extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+        extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+        extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+    packed.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex& vertex = vertices[i];
+        PackedVertex& out = packed[i];
+        glm::vec3 unit = glm::clamp((vertex.Position - boundsMin) * toUnit, 0.0f, 1.0f);
+        out.position[0] = (uint16_t)(unit.x * 65535.0f + 0.5f);
+        out.position[1] = (uint16_t)(unit.y * 65535.0f + 0.5f);
+        out.position[2] = (uint16_t)(unit.z * 65535.0f + 0.5f);
+        out.position[3] = 0;
+        out.normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f));
+        out.texCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+        out.texCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+    }
+    return true;
+}
+
+#endif
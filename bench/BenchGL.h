@@ -0,0 +1,62 @@
+#ifndef BENCH_GL_H
+#define BENCH_GL_H
+
+// The hidden GL context the drawing benchmarks run in; they draw into an
+// OffscreenTarget. Run them from the repository root, where the shaders and
+// assets are.
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include "OffscreenTarget.h"
+
+namespace bench {
+
+// A GL 3.3 core context on a hidden window, current until destruction. GL
+// objects must be released before it is destroyed, so benchmarks keep them
+// in a scope of their own.
+class HiddenContext {
+public:
+    explicit HiddenContext(const char* title) {
+        if (!glfwInit()) {
+            std::cout << "Failed to initialize GLFW" << std::endl;
+            return;
+        }
+        initialized = true;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        GLFWwindow* window = glfwCreateWindow(64, 64, title, NULL, NULL);
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            return;
+        }
+        glfwMakeContextCurrent(window);
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return;
+        }
+        loaded = true;
+    }
+
+    ~HiddenContext() {
+        if (initialized)
+            glfwTerminate();
+    }
+
+    HiddenContext(const HiddenContext&) = delete;
+    HiddenContext& operator=(const HiddenContext&) = delete;
+
+    bool ok() const {
+        return loaded;
+    }
+
+private:
+    bool initialized = false;
+    bool loaded = false;
+};
+
+}
+
+#endif
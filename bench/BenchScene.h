@@ -0,0 +1,95 @@
+#ifndef BENCH_SCENE_H
+#define BENCH_SCENE_H
+
+// Helpers shared by the CPU-only benchmarks: loading model data without a GL
+// context (with a procedural stand-in when the asset is not on disk) and timing.
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "ModelData.h"
+#include "MeshCache.h"
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Tessellated sphere, used when a model file is missing
+inline MeshData makeSphere(unsigned int stacks, unsigned int slices, float radius, const glm::vec3& center) {
+    MeshData mesh;
+    const float pi = 3.14159265358979f;
+    for (unsigned int i = 0; i <= stacks; i++) {
+        float phi = pi * i / stacks;
+        for (unsigned int j = 0; j <= slices; j++) {
+            float theta = 2.0f * pi * j / slices;
+            glm::vec3 n(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+            mesh.vertices.push_back({ center + n * radius, n, glm::vec2((float)j / slices, (float)i / stacks) });
+        }
+    }
+    for (unsigned int i = 0; i < stacks; i++) {
+        for (unsigned int j = 0; j < slices; j++) {
+            unsigned int a = i * (slices + 1) + j, b = a + slices + 1;
+            mesh.indices.insert(mesh.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    return mesh;
+}
+
+// Open cylinder along +Y, used when a model file is missing
+inline MeshData makeCylinder(unsigned int rings, unsigned int segments, float radius, float height, const glm::vec3& base) {
+    MeshData mesh;
+    const float pi = 3.14159265358979f;
+    for (unsigned int i = 0; i <= rings; i++) {
+        float y = height * i / rings;
+        for (unsigned int j = 0; j <= segments; j++) {
+            float theta = 2.0f * pi * j / segments;
+            glm::vec3 n(std::cos(theta), 0.0f, std::sin(theta));
+            mesh.vertices.push_back({ base + glm::vec3(n.x * radius, y, n.z * radius), n, glm::vec2((float)j / segments, (float)i / rings) });
+        }
+    }
+    for (unsigned int i = 0; i < rings; i++) {
+        for (unsigned int j = 0; j < segments; j++) {
+            unsigned int a = i * (segments + 1) + j, b = a + segments + 1;
+            mesh.indices.insert(mesh.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    return mesh;
+}
+
+// Load a model's meshes through the mesh cache / Assimp. When the file does not
+// exist, fall back to the given stand-in so the benchmark still runs.
+inline ModelData loadBenchModel(const std::string& path, MeshData (*standIn)()) {
+    ModelData data;
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && loadModelData(path, data))
+        return data;
+
+    std::cout << path << " not found, using a procedural stand-in" << std::endl;
+    data = ModelData();
+    data.meshes.push_back(standIn());
+    MeshData& mesh = data.meshes.back();
+    mesh.boundsMin = mesh.boundsMax = mesh.vertices[0].Position;
+    for (const Vertex& vertex : mesh.vertices) {
+        mesh.boundsMin = glm::min(mesh.boundsMin, vertex.Position);
+        mesh.boundsMax = glm::max(mesh.boundsMax, vertex.Position);
+    }
+    return data;
+}
+
+inline size_t triangleCount(const ModelData& data) {
+    size_t count = 0;
+    for (const MeshData& mesh : data.meshes)
+        count += mesh.indices.size() / 3;
+    return count;
+}
+
+}
+
+#endif
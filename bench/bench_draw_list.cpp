@@ -0,0 +1,204 @@
+// Draw list benchmark: a grid of targets, foliage and towers drawn one mesh
+// at a time with per-draw uniforms and VAO binds, as the game did, against
+// DrawList with multi-draw indirect and with its base-vertex fallback, each
+// also split into submissions of SPLIT_DRAWS draws as when the draws outgrow
+// the buffer texture. Each
+// path reports its draw calls, state changes (VAO binds, texture binds and
+// uniform or draw id uploads) and wall time per frame. The run fails if
+// either draw list path changes state as often as the per-mesh one, or if
+// its image differs from the per-mesh image in more than 0.1% of the covered
+// pixels. Multi-draw is measured only when the driver has it.
+//
+// Usage: bench_draw_list [frames]   (default 100)
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdlib>
+#include "BenchScene.h"
+#include "BenchGL.h"
+#include "Model.h"
+#include "ModelInstance.h"
+#include "InstanceBatch.h"
+#include "DrawList.h"
+#include "UniformBuffer.h"
+
+namespace {
+
+const unsigned int IMAGE_SIZE = 256;
+const unsigned int GRID_SIZE = 30;
+const size_t SPLIT_DRAWS = 100;
+
+MeshData targetStandIn() { return bench::makeCylinder(2, 24, 0.5f, 0.1f, glm::vec3(0.0f)); }
+MeshData foliageStandIn() { return bench::makeSphere(8, 12, 0.4f, glm::vec3(0.0f, 0.4f, 0.0f)); }
+MeshData towerStandIn() { return bench::makeCylinder(4, 16, 0.3f, 2.0f, glm::vec3(0.0f)); }
+
+struct FrameResult {
+    DrawCounters counters;
+    double msPerFrame = 0.0;
+    std::vector<unsigned char> image;
+};
+
+// Draw the scene frames times with drawScene and read back the last frame
+template <typename DrawScene>
+FrameResult run(DrawScene drawScene, unsigned int frames) {
+    FrameResult result;
+    bench::Clock::time_point start;
+    for (unsigned int frame = 0; frame <= frames; frame++) {
+        if (frame == 1)
+            start = bench::Clock::now(); // the first frame warms up
+        drawCounters() = DrawCounters();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawScene();
+        glFinish();
+    }
+    result.msPerFrame = frames ? bench::elapsedMs(start) / frames : 0.0;
+    result.counters = drawCounters();
+    result.image.resize(IMAGE_SIZE * IMAGE_SIZE * 4);
+    glReadPixels(0, 0, IMAGE_SIZE, IMAGE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, result.image.data());
+    return result;
+}
+
+// Share of the pixels covered in either image that differ by more than 8/255
+double differingShare(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, size_t& covered) {
+    size_t differing = 0;
+    for (size_t i = 0; i < a.size(); i += 4) {
+        if (a[i + 3] == 0 && b[i + 3] == 0)
+            continue;
+        covered++;
+        int difference = 0;
+        for (int c = 0; c < 4; c++)
+            difference = std::max(difference, std::abs((int)a[i + c] - (int)b[i + c]));
+        differing += difference > 8;
+    }
+    return covered ? (double)differing / covered : 0.0;
+}
+
+void report(const char* name, const FrameResult& result) {
+    std::cout << "  " << name << result.counters.drawCalls << " draw calls, " << result.counters.stateChanges()
+        << " state changes (" << result.counters.vertexArrayBinds << " VAO binds, " << result.counters.textureBinds
+        << " texture binds, " << result.counters.uniformUploads << " uploads), " << result.msPerFrame << " ms per frame" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)std::strtoul(argv[1], nullptr, 10) : 100;
+
+    bench::HiddenContext context("bench_draw_list");
+    if (!context.ok())
+        return 1;
+    bool multiDraw = loadMultiDrawIndirect((GLADloadproc)glfwGetProcAddress);
+
+    bool passed = true;
+    {
+        resetInstanceAttributes();
+        glEnable(GL_DEPTH_TEST);
+
+        ModelData targetData = bench::loadBenchModel("Resources/Models/Target/scene.gltf", targetStandIn);
+        Model target(targetData, BVH(), Model::decodeImages(targetData));
+        ModelData foliageData = bench::loadBenchModel("Resources/Models/Plants1/scene.gltf", foliageStandIn);
+        Model foliage(foliageData, BVH(), Model::decodeImages(foliageData));
+        ModelData towerData = bench::loadBenchModel("Resources/Models/Tower/scene.gltf", towerStandIn);
+        Model tower(towerData, BVH(), Model::decodeImages(towerData));
+
+        // Each model scaled to about a unit, in a grid
+        const Model* models[] = { &target, &foliage, &tower };
+        std::vector<ModelInstance> scene;
+        for (unsigned int i = 0; i < GRID_SIZE * GRID_SIZE; i++) {
+            const Model& model = *models[i % 3];
+            float size = glm::max(glm::length(model.getBoundsMax() - model.getBoundsMin()), 1e-3f);
+            ModelInstance instance(model);
+            instance.translate(glm::vec3((float)(i % GRID_SIZE) - GRID_SIZE * 0.5f, 0.0f, -(float)(i / GRID_SIZE)));
+            instance.scale(glm::vec3(0.8f / size));
+            instance.translate(-(model.getBoundsMin() + model.getBoundsMax()) * 0.5f);
+            scene.push_back(instance);
+        }
+        unsigned int meshes = 0;
+        for (const ModelInstance& instance : scene)
+            meshes += (unsigned int)instance.getModel().getMeshes().size();
+        std::cout << scene.size() << " instances, " << meshes << " meshes in " << GeometryArena::instance().poolCount()
+            << " geometry pools, " << GeometryArena::instance().usedBytes() / 1024 << " KB of "
+            << GeometryArena::instance().capacityBytes() / 1024 << " KB allocated" << std::endl;
+
+        // Looking down the rows
+        glm::vec3 eye(0.0f, 6.0f, 6.0f);
+        FrameData frame;
+        frame.view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, GRID_SIZE * -0.4f), glm::vec3(0.0f, 1.0f, 0.0f));
+        frame.projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+        frame.viewPos = glm::vec4(eye, 1.0f);
+        Frustum frustum(frame.projection * frame.view);
+        UniformBuffer<FrameData> frameData(FRAME_DATA_BINDING);
+        UniformBuffer<LightData> lightData(LIGHT_DATA_BINDING);
+        frameData.update(frame);
+        LightData light;
+        light.position = glm::vec4(-1000.0f, 1000.0f, -250.0f, 1.0f);
+        light.ambient = glm::vec4(0.2f);
+        light.diffuse = glm::vec4(0.8f);
+        light.specular = glm::vec4(0.4f);
+        lightData.update(light);
+
+        // Normals make the image independent of the textures, which stand-ins lack
+        Shader perMeshShader("model_vertex.glsl", "model_fragment.glsl", nullptr, "#define SHOW_NORMALS\n");
+        Shader drawListShader("model_vertex.glsl", "model_fragment.glsl", nullptr, "#define DRAW_ID\n#define SHOW_NORMALS\n");
+        UniformHandle<glm::mat4> modelLoc = perMeshShader.uniform<glm::mat4>("model");
+        UniformHandle<glm::mat3> normalMatrixLoc = perMeshShader.uniform<glm::mat3>("normalMatrix");
+
+        OffscreenTarget framebuffer(IMAGE_SIZE, IMAGE_SIZE);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+        FrameResult perMesh = run([&]() {
+            perMeshShader.use();
+            CullStats stats;
+            for (const ModelInstance& instance : scene) {
+                perMeshShader.set(modelLoc, instance.getModelMatrix());
+                perMeshShader.set(normalMatrixLoc, instance.getNormalMatrix());
+                drawCounters().uniformUploads += 2;
+                instance.getModel().Draw(perMeshShader, frustum, instance.getModelMatrix(), stats);
+            }
+        }, frames);
+        report("per mesh:             ", perMesh);
+
+        DrawList drawList;
+        auto drawListPath = [&]() {
+            drawListShader.use();
+            CullStats stats;
+            drawList.clear();
+            for (const ModelInstance& instance : scene)
+                drawList.add(instance, frustum, stats);
+            drawList.Draw(drawListShader);
+        };
+        std::vector<std::pair<const char*, FrameResult>> results;
+        size_t maxDraws = drawList.maxDrawsPerSubmission;
+        drawList.useMultiDraw = false;
+        results.push_back(std::make_pair("base-vertex fallback: ", run(drawListPath, frames)));
+        drawList.maxDrawsPerSubmission = SPLIT_DRAWS;
+        results.push_back(std::make_pair("split base-vertex:    ", run(drawListPath, frames)));
+        drawList.maxDrawsPerSubmission = maxDraws;
+        if (multiDraw) {
+            drawList.useMultiDraw = true;
+            results.push_back(std::make_pair("multi-draw indirect:  ", run(drawListPath, frames)));
+            drawList.maxDrawsPerSubmission = SPLIT_DRAWS;
+            results.push_back(std::make_pair("split multi-draw:     ", run(drawListPath, frames)));
+        }
+        else {
+            std::cout << "  (no multi-draw indirect on this driver)" << std::endl;
+        }
+
+        for (const auto& result : results) {
+            report(result.first, result.second);
+            size_t covered = 0;
+            double share = differingShare(perMesh.image, result.second.image, covered);
+            bool sameImage = covered > 0 && share <= 0.001;
+            bool fewerChanges = result.second.counters.stateChanges() < perMesh.counters.stateChanges();
+            passed &= sameImage && fewerChanges;
+            std::cout << "    " << share * 100.0 << "% of " << covered << " pixels differ from per mesh"
+                << (covered == 0 ? " (nothing drawn)" : sameImage ? "" : " (over 0.1%)")
+                << (fewerChanges ? "" : " (no fewer state changes)") << std::endl;
+        }
+
+    }
+    GeometryArena::instance().release();
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+// Job system scaling benchmark: the CPU work of a stress-scene frame run as
+// jobs at 1, 2, 4 and 8 workers. There are 10k targets and plants. Each
+// frame moves every instance (a new transform and normal matrix), picks its
+// level of detail, culls it into per-job draws that are joined into a
+// DrawList, culls two InstanceBatches of the same scene, and traces a
+// shotgun burst against the targets. The camera flies down the rows.
+// Nothing is drawn: GL submission stays on the main thread and is not what
+// scales. The run fails if any worker count gives different draws, stats or
+// hits than one worker in any frame. Speedups are reported, not judged, since
+// they depend on the machine's cores. The meshes' buffers still need a GL
+// context.
+//
+// Usage: bench_jobs [frames]   (default 60)
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+#include "BenchScene.h"
+#include "BenchGL.h"
+#include "Model.h"
+#include "ModelInstance.h"
+#include "InstanceBatch.h"
+#include "DrawList.h"
+#include "JobSystem.h"
+#include "MeshSimplifier.h"
+#include "Raycaster.h"
+
+namespace {
+
+const unsigned int TARGETS = 5000;
+const unsigned int PLANTS = 5000;
+const size_t INSTANCES_PER_JOB = 256;
+const float SCREEN_HEIGHT = 1080.0f;
+const float FIELD_OF_VIEW = 45.0f;
+
+MeshData targetStandIn() { return bench::makeCylinder(40, 120, 0.5f, 0.1f, glm::vec3(0.0f)); }
+MeshData foliageStandIn() { return bench::makeSphere(80, 80, 0.5f, glm::vec3(0.0f, 0.5f, 0.0f)); }
+
+ModelData loadWithLods(const std::string& path, MeshData (*standIn)()) {
+    ModelData data = bench::loadBenchModel(path, standIn);
+    for (MeshData& mesh : data.meshes) {
+        if (mesh.lods.empty())
+            generateLods(mesh);
+    }
+    return data;
+}
+
+// Everything a frame's jobs produce, to compare between worker counts
+struct FrameResult {
+    CullStats stats;
+    size_t draws = 0;
+    unsigned int pelletHits = 0;
+    double hitDistance = 0.0;
+
+    bool operator==(const FrameResult& other) const {
+        return stats.drawn == other.stats.drawn && stats.culled == other.stats.culled &&
+            stats.triangles == other.stats.triangles && draws == other.draws &&
+            pelletHits == other.pelletHits && hitDistance == other.hitDistance;
+    }
+};
+
+struct Scene {
+    std::vector<ModelInstance> instances; // targets first
+    std::vector<glm::vec3> positions;
+    std::vector<std::unique_ptr<InstanceBatch>> batches;
+};
+
+// frames frames of the flythrough on jobs; the results of every frame
+std::vector<FrameResult> run(JobSystem& jobs, Scene& scene, DrawList& drawList, unsigned int frames, double& msPerFrame) {
+    TaskGraph tasks;
+    std::vector<CulledDraws> rangeDraws((scene.instances.size() + INSTANCES_PER_JOB - 1) / INSTANCES_PER_JOB);
+    std::vector<CullStats> rangeStats;
+    std::vector<CullStats> batchStats;
+    std::vector<std::vector<RayHit>> rangeHits;
+    std::vector<FrameResult> results(frames);
+
+    bench::Clock::time_point start = bench::Clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        float t = (float)frame / frames;
+        glm::vec3 eye(2.0f * std::sin(t * 6.0f), 1.5f, 10.0f - 150.0f * t);
+        glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(0.0f, -0.1f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(FIELD_OF_VIEW), 1350.0f / 1080.0f, 0.1f, 100.0f);
+        Frustum frustum(projection * view);
+        LodView lodView = LodView::perspective(eye, glm::radians(FIELD_OF_VIEW), SCREEN_HEIGHT);
+        Raycaster raycaster;
+        raycaster.shootBurstFromCamera(Camera(eye, glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, -5.0f), 16, 4.0f);
+
+        rangeStats.assign(rangeDraws.size(), CullStats());
+        batchStats.assign(scene.batches.size(), CullStats());
+        rangeHits.assign(rangeDraws.size(), std::vector<RayHit>(raycaster.burst.size()));
+        tasks.clear();
+
+        // Move, pick levels and cull, then join; the batches and the hit
+        // tests run alongside
+        float angle = frame * 2.0f;
+        TaskGraph::TaskId culled = tasks.parallelFor(scene.instances.size(), INSTANCES_PER_JOB, [&](size_t begin, size_t end) {
+            size_t range = begin / INSTANCES_PER_JOB;
+            rangeDraws[range].clear();
+            for (size_t i = begin; i < end; i++) {
+                ModelInstance& instance = scene.instances[i];
+                glm::mat4 transform = glm::translate(glm::mat4(1.0f), scene.positions[i]);
+                instance.setTransform(glm::rotate(transform, glm::radians(angle + i), glm::vec3(0.0f, 1.0f, 0.0f)));
+                instance.updateLod(lodView);
+                rangeDraws[range].add(instance, frustum, rangeStats[range]);
+            }
+        });
+        tasks.add([&]() {
+            drawList.clear();
+            for (const CulledDraws& draws : rangeDraws)
+                drawList.append(draws);
+        }, { culled });
+        for (size_t i = 0; i < scene.batches.size(); i++) {
+            tasks.add([&, i]() {
+                scene.batches[i]->cull(frustum, batchStats[i], &lodView);
+            });
+        }
+        tasks.parallelFor(TARGETS, INSTANCES_PER_JOB, [&](size_t begin, size_t end) {
+            std::vector<RayHit>& hits = rangeHits[begin / INSTANCES_PER_JOB];
+            for (size_t i = begin; i < end; i++)
+                raycaster.intersectBurst(scene.instances[i].getModel().getBVH(), scene.instances[i].getModelMatrix(), hits);
+        }, { culled });
+        jobs.run(tasks);
+
+        FrameResult& result = results[frame];
+        for (const CullStats& stats : rangeStats)
+            result.stats.add(stats);
+        for (const CullStats& stats : batchStats)
+            result.stats.add(stats);
+        result.draws = drawList.size();
+        std::vector<RayHit> hits(raycaster.burst.size());
+        for (const std::vector<RayHit>& range : rangeHits) {
+            for (size_t pellet = 0; pellet < hits.size(); pellet++) {
+                if (range[pellet].distance < hits[pellet].distance)
+                    hits[pellet] = range[pellet];
+            }
+        }
+        for (const RayHit& hit : hits) {
+            result.pelletHits += hit.hit();
+            result.hitDistance += hit.hit() ? hit.distance : 0.0;
+        }
+    }
+    msPerFrame = frames ? bench::elapsedMs(start) / frames : 0.0;
+    return results;
+}
+
+}
+
+int main(int argc, char** argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)std::strtoul(argv[1], nullptr, 10) : 60;
+
+    bench::HiddenContext context("bench_jobs");
+    if (!context.ok())
+        return 1;
+
+    bool passed = true;
+    {
+        resetInstanceAttributes();
+        ModelData targetData = loadWithLods("Resources/Models/Target/scene.gltf", targetStandIn);
+        ModelData foliageData = loadWithLods("Resources/Models/Plants1/scene.gltf", foliageStandIn);
+        BVH targetBVH, foliageBVH;
+        targetBVH.build(targetData.meshes);
+        foliageBVH.build(foliageData.meshes);
+        Model target(targetData, std::move(targetBVH), Model::decodeImages(targetData));
+        Model foliage(foliageData, std::move(foliageBVH), Model::decodeImages(foliageData));
+
+        // Rows of targets standing in a field of foliage, like the stress scene
+        Scene scene;
+        scene.batches.emplace_back(new InstanceBatch(target));
+        scene.batches.emplace_back(new InstanceBatch(foliage));
+        for (unsigned int i = 0; i < TARGETS + PLANTS; i++) {
+            bool isTarget = i < TARGETS;
+            unsigned int n = isTarget ? i : i - TARGETS;
+            glm::vec3 position = isTarget ? glm::vec3(-50.0f + (n % 50) * 2.0f, 0.0f, -20.0f - (n / 50) * 4.0f)
+                : glm::vec3(-50.0f + (n % 50) * 2.0f + 1.0f, 0.0f, -18.0f - (n / 50) * 4.0f);
+            scene.instances.push_back(ModelInstance(isTarget ? target : foliage));
+            scene.instances.back().translate(position);
+            scene.positions.push_back(position);
+            scene.batches[isTarget ? 0 : 1]->add(glm::translate(glm::mat4(1.0f), position));
+        }
+        DrawList drawList;
+
+        std::cout << scene.instances.size() << " instances, " << frames << " frames, "
+            << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+        std::vector<FrameResult> reference;
+        double serialMs = 0.0;
+        for (unsigned int workers : { 1u, 2u, 4u, 8u }) {
+            JobSystem jobs(workers);
+            // Levels carry over between frames, so every run starts from full detail
+            LodView fullDetail;
+            fullDetail.pixelsPerUnit = std::numeric_limits<float>::max();
+            for (ModelInstance& instance : scene.instances)
+                instance.updateLod(fullDetail);
+            for (std::unique_ptr<InstanceBatch>& batch : scene.batches) {
+                CullStats ignored;
+                batch->cull(Frustum(glm::mat4(1.0f)), ignored, &fullDetail);
+            }
+            double ms = 0.0;
+            std::vector<FrameResult> results = run(jobs, scene, drawList, frames, ms);
+            if (workers == 1) {
+                reference = results;
+                serialMs = ms;
+            }
+            bool same = results == reference;
+            passed &= same;
+            std::cout << "  " << workers << " worker" << (workers > 1 ? "s: " : ":  ") << ms << " ms per frame, "
+                << serialMs / ms << "x, " << jobs.steals() << " steals" << (same ? "" : " (results differ from 1 worker)")
+                << std::endl;
+        }
+        if (!reference.empty()) {
+            const FrameResult& last = reference.back();
+            std::cout << "  last frame: " << last.draws << " meshes in the draw list, " << last.stats.drawn
+                << " drawn and " << last.stats.culled << " culled by both paths, " << last.pelletHits
+                << " of 16 pellets hit" << std::endl;
+        }
+    }
+    GeometryArena::instance().release();
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+// Level of detail benchmark: a camera flythrough over rows of targets and
+// foliage, drawn one instance at a time as the game does, with levels of
+// detail off, on, and on without hysteresis. Each run reports the triangles
+// and wall time per frame and how often instances changed level. Levels are
+// picked for the game's 1080-pixel-high screen while the frames render into a
+// small offscreen framebuffer. The run fails if any model's levels do not get
+// coarser with growing error, if levels of detail do not cut the triangles
+// drawn, if hysteresis does not cut the level changes, or if InstanceBatch
+// draws a different number of triangles than the instances it batches.
+//
+// Usage: bench_lod [frames]   (default 240)
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <cstdlib>
+#include "BenchScene.h"
+#include "BenchGL.h"
+#include "Model.h"
+#include "ModelInstance.h"
+#include "InstanceBatch.h"
+#include "MeshSimplifier.h"
+#include "UniformBuffer.h"
+
+namespace {
+
+const unsigned int IMAGE_SIZE = 256;
+const float SCREEN_HEIGHT = 1080.0f;
+const float FIELD_OF_VIEW = 45.0f;
+
+MeshData targetStandIn() { return bench::makeCylinder(40, 120, 0.5f, 0.1f, glm::vec3(0.0f)); }
+MeshData foliageStandIn() { return bench::makeSphere(80, 80, 0.5f, glm::vec3(0.0f, 0.5f, 0.0f)); }
+
+// Stand-ins come without levels; cached models already have theirs
+ModelData loadWithLods(const std::string& path, MeshData (*standIn)()) {
+    ModelData data = bench::loadBenchModel(path, standIn);
+    for (MeshData& mesh : data.meshes) {
+        if (mesh.lods.empty())
+            generateLods(mesh);
+    }
+    return data;
+}
+
+// Every level of every mesh has fewer triangles and at least the error of the one before
+bool checkLevels(const char* name, const Model& model) {
+    bool good = true;
+    for (const Mesh& mesh : model.getMeshes()) {
+        for (unsigned int lod = 1; lod < mesh.getLodCount(); lod++)
+            good &= mesh.getTriangleCount(lod) < mesh.getTriangleCount(lod - 1) && mesh.getLodError(lod) >= mesh.getLodError(lod - 1);
+    }
+    std::cout << name << ": " << model.getMeshes().size() << " meshes, " << model.getLodCount() << " levels, triangles";
+    for (unsigned int lod = 0; lod < model.getLodCount(); lod++) {
+        unsigned long long triangles = 0;
+        for (const Mesh& mesh : model.getMeshes())
+            triangles += mesh.getTriangleCount(lod);
+        std::cout << (lod ? " -> " : " ") << triangles << " (error " << model.getLodError(lod) << ")";
+    }
+    std::cout << (good ? "" : " (levels out of order)") << std::endl;
+    return good;
+}
+
+// Camera position at time t of the flythrough: down the rows while swaying
+// back and forth, as a player does
+glm::vec3 flythroughEye(float t) {
+    return glm::vec3(2.0f * std::sin(t * 6.0f), 1.5f + 0.5f * std::sin(t * 20.0f), 10.0f - 150.0f * t + 3.0f * std::sin(t * 60.0f));
+}
+
+struct RunResult {
+    double trianglesPerFrame = 0.0;
+    double msPerFrame = 0.0;
+    unsigned long long switches = 0; // after the first frame
+};
+
+// One flythrough over the scene, at full detail when lodSettings is null
+RunResult flythrough(const Shader& shader, std::vector<ModelInstance> scene, UniformBuffer<FrameData>& frameData,
+    unsigned int frames, const LodView* lodSettings) {
+    UniformHandle<glm::mat4> modelLoc = shader.uniform<glm::mat4>("model");
+    UniformHandle<glm::mat3> normalMatrixLoc = shader.uniform<glm::mat3>("normalMatrix");
+    glm::mat4 projection = glm::perspective(glm::radians(FIELD_OF_VIEW), 1.0f, 0.1f, 200.0f);
+
+    RunResult result;
+    unsigned long long triangles = 0;
+    bench::Clock::time_point start = bench::Clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        float t = (float)frame / frames;
+        glm::vec3 eye = flythroughEye(t);
+        FrameData data;
+        data.view = glm::lookAt(eye, eye + glm::vec3(0.0f, -0.2f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        data.projection = projection;
+        data.viewPos = glm::vec4(eye, 1.0f);
+        frameData.update(data);
+        Frustum frustum(data.projection * data.view);
+
+        if (lodSettings) {
+            LodView view = *lodSettings;
+            view.eye = eye;
+            for (ModelInstance& instance : scene) {
+                unsigned int before = instance.getLod();
+                instance.updateLod(view);
+                result.switches += frame > 0 && instance.getLod() != before;
+            }
+        }
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        CullStats stats;
+        for (const ModelInstance& instance : scene) {
+            shader.set(modelLoc, instance.getModelMatrix());
+            shader.set(normalMatrixLoc, instance.getNormalMatrix());
+            instance.getModel().Draw(shader, frustum, instance.getModelMatrix(), stats, instance.getLod());
+        }
+        glFinish();
+        triangles += stats.triangles;
+    }
+    result.msPerFrame = bench::elapsedMs(start) / frames;
+    result.trianglesPerFrame = (double)triangles / frames;
+    return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)std::strtoul(argv[1], nullptr, 10) : 240;
+
+    bench::HiddenContext context("bench_lod");
+    if (!context.ok())
+        return 1;
+
+    bool passed = true;
+    {
+        resetInstanceAttributes();
+        glEnable(GL_DEPTH_TEST);
+
+        ModelData targetData = loadWithLods("Resources/Models/Target/scene.gltf", targetStandIn);
+        Model target(targetData, BVH(), Model::decodeImages(targetData));
+        ModelData foliageData = loadWithLods("Resources/Models/Plants1/scene.gltf", foliageStandIn);
+        Model foliage(foliageData, BVH(), Model::decodeImages(foliageData));
+        passed &= checkLevels("target", target);
+        passed &= checkLevels("foliage", foliage);
+
+        // Rows of targets standing in a field of foliage, like the stress scene
+        std::vector<ModelInstance> scene;
+        for (unsigned int i = 0; i < 200; i++) {
+            ModelInstance instance(target);
+            instance.translate(glm::vec3(-20.0f + (i % 20) * 2.0f, 1.0f, -(float)(i / 20) * 16.0f));
+            instance.rotate(90.0f, glm::vec3(1.0f, 0.0f, 0.0f));
+            scene.push_back(instance);
+        }
+        for (unsigned int i = 0; i < 400; i++) {
+            ModelInstance instance(foliage);
+            instance.translate(glm::vec3(-21.0f + (i % 20) * 2.0f, 0.0f, -4.0f - (float)(i / 20) * 8.0f));
+            scene.push_back(instance);
+        }
+
+        UniformBuffer<FrameData> frameData(FRAME_DATA_BINDING);
+        UniformBuffer<LightData> lightData(LIGHT_DATA_BINDING);
+        LightData light;
+        light.position = glm::vec4(-1000.0f, 1000.0f, -250.0f, 1.0f);
+        light.ambient = glm::vec4(0.2f);
+        light.diffuse = glm::vec4(0.8f);
+        light.specular = glm::vec4(0.4f);
+        lightData.update(light);
+        Shader shader("model_vertex.glsl", "model_fragment.glsl");
+        shader.use();
+        shader.set(shader.uniform<float>("material.shininess"), 40.0f);
+
+        LodView lodView = LodView::perspective(glm::vec3(0.0f), glm::radians(FIELD_OF_VIEW), SCREEN_HEIGHT);
+        LodView noHysteresis = lodView;
+        noHysteresis.hysteresis = 1.0f;
+
+        RunResult off, on, flicker;
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            OffscreenTarget framebuffer(IMAGE_SIZE, IMAGE_SIZE);
+
+            off = flythrough(shader, scene, frameData, frames, nullptr);
+            on = flythrough(shader, scene, frameData, frames, &lodView);
+            flicker = flythrough(shader, scene, frameData, frames, &noHysteresis);
+        }
+
+        std::cout << "  full detail:          " << off.trianglesPerFrame << " triangles, " << off.msPerFrame << " ms per frame" << std::endl;
+        std::cout << "  levels of detail:     " << on.trianglesPerFrame << " triangles (" << on.trianglesPerFrame / off.trianglesPerFrame
+            << " of full detail), " << on.msPerFrame << " ms per frame, " << on.switches << " level changes" << std::endl;
+        std::cout << "  without hysteresis:   " << flicker.trianglesPerFrame << " triangles, " << flicker.msPerFrame
+            << " ms per frame, " << flicker.switches << " level changes" << std::endl;
+        bool fewerTriangles = on.trianglesPerFrame < off.trianglesPerFrame;
+        bool fewerSwitches = on.switches <= flicker.switches;
+        if (!fewerTriangles)
+            std::cout << "  (levels of detail did not reduce the triangles drawn)" << std::endl;
+        if (!fewerSwitches)
+            std::cout << "  (hysteresis did not reduce level changes)" << std::endl;
+        passed &= fewerTriangles && fewerSwitches;
+
+        // The batched path picks the same levels from the same start
+        glm::vec3 eye = flythroughEye(0.5f);
+        lodView.eye = eye;
+        Frustum frustum(glm::perspective(glm::radians(FIELD_OF_VIEW), 1.0f, 0.1f, 200.0f) *
+            glm::lookAt(eye, eye + glm::vec3(0.0f, -0.2f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+        InstanceBatch targetBatch(target), foliageBatch(foliage);
+        CullStats single, batched;
+        for (ModelInstance& instance : scene) {
+            instance.updateLod(lodView);
+            instance.getModel().Draw(shader, frustum, instance.getModelMatrix(), single, instance.getLod());
+            (&instance.getModel() == &target ? targetBatch : foliageBatch).add(instance.getModelMatrix());
+        }
+        shader.set(shader.uniform<glm::mat4>("model"), glm::mat4(1.0f));
+        shader.set(shader.uniform<glm::mat3>("normalMatrix"), glm::mat3(1.0f));
+        targetBatch.Draw(shader, frustum, batched, &lodView);
+        foliageBatch.Draw(shader, frustum, batched, &lodView);
+        glFinish();
+        bool sameTriangles = single.triangles == batched.triangles;
+        std::cout << "  instanced batches:    " << batched.triangles << " triangles against " << single.triangles
+            << " one at a time" << (sameTriangles ? "" : " (mismatch)") << std::endl;
+        passed &= sameTriangles;
+    }
+
+    return passed ? 0 : 1;
+}
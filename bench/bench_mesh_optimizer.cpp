@@ -0,0 +1,116 @@
+// Mesh optimizer benchmark: ACMR and ATVR of every mesh of the Plants1 and
+// Tower models as Assimp emits them, after vertex cache ordering alone and
+// after the full optimizeMesh pass, with the time each took. The run fails if
+// any mesh loses or gains a triangle, gets a worse ACMR than it started with,
+// or if overdraw sorting costs more than its threshold. Without the assets,
+// stand-ins with their triangles shuffled, as exporters often leave them, are
+// used.
+//
+// Usage: bench_mesh_optimizer
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include "BenchScene.h"
+#include "MeshOptimizer.h"
+
+namespace {
+
+MeshData shuffled(MeshData mesh) {
+    std::vector<std::array<unsigned int, 3>> triangles;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        triangles.push_back({ mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] });
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(42));
+    mesh.indices.clear();
+    for (const std::array<unsigned int, 3>& triangle : triangles)
+        mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+    return mesh;
+}
+
+MeshData foliageStandIn() { return shuffled(bench::makeSphere(300, 300, 0.5f, glm::vec3(0.0f, 0.5f, 0.0f))); }
+MeshData towerStandIn() { return shuffled(bench::makeCylinder(300, 256, 2.0f, 12.0f, glm::vec3(0.0f))); }
+
+// The meshes as Assimp emits them; the mesh cache already holds optimized ones
+ModelData loadUnoptimized(const std::string& path, MeshData (*standIn)()) {
+    ModelData data;
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && parseModel(path, data))
+        return data;
+
+    std::cout << path << " not found, using a procedural stand-in" << std::endl;
+    data = ModelData();
+    data.meshes.push_back(standIn());
+    return data;
+}
+
+// Triangles by vertex position, each rotated to start at its smallest corner
+// and the list sorted, so two index orders of one mesh compare equal
+std::vector<std::array<float, 9>> triangleSet(const MeshData& mesh) {
+    std::vector<std::array<float, 9>> triangles;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        std::array<float, 9> best;
+        for (int r = 0; r < 3; r++) {
+            std::array<float, 9> rotated;
+            for (int k = 0; k < 3; k++) {
+                const glm::vec3& p = mesh.vertices[mesh.indices[i + (r + k) % 3]].Position;
+                rotated[k * 3] = p.x;
+                rotated[k * 3 + 1] = p.y;
+                rotated[k * 3 + 2] = p.z;
+            }
+            if (r == 0 || rotated < best)
+                best = rotated;
+        }
+        triangles.push_back(best);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+}
+
+int main() {
+    struct BenchModel {
+        const char* path;
+        MeshData (*standIn)();
+    };
+    const BenchModel models[] = {
+        { "Resources/Models/Plants1/scene.gltf", foliageStandIn },
+        { "Resources/Models/Tower/scene.gltf", towerStandIn },
+    };
+
+    bool failed = false;
+    for (const BenchModel& model : models) {
+        ModelData data = loadUnoptimized(model.path, model.standIn);
+        std::cout << model.path << ": " << data.meshes.size() << " meshes, " << bench::triangleCount(data) << " triangles" << std::endl;
+
+        for (size_t i = 0; i < data.meshes.size(); i++) {
+            MeshData& mesh = data.meshes[i];
+            if (mesh.indices.size() < 3)
+                continue;
+            std::vector<std::array<float, 9>> original = triangleSet(mesh);
+
+            std::vector<unsigned int> cacheOnly = mesh.indices;
+            bench::Clock::time_point start = bench::Clock::now();
+            optimizeVertexCache(cacheOnly, mesh.vertices.size());
+            double cacheMs = bench::elapsedMs(start);
+            VertexCacheStats cacheStats = analyzeVertexCache(cacheOnly, mesh.vertices.size());
+
+            start = bench::Clock::now();
+            MeshOptimizeStats stats = optimizeMesh(mesh);
+            double fullMs = bench::elapsedMs(start);
+
+            bool sameTriangles = triangleSet(mesh) == original;
+            bool better = stats.after.acmr <= stats.before.acmr;
+            bool withinThreshold = stats.after.acmr <= cacheStats.acmr * 1.05f + 1e-4f;
+            failed |= !sameTriangles || !better || !withinThreshold;
+
+            std::cout << "  mesh " << i << " (" << mesh.indices.size() / 3 << " triangles): ACMR "
+                << stats.before.acmr << " -> " << cacheStats.acmr << " (cache, " << cacheMs << " ms) -> "
+                << stats.after.acmr << " (with overdraw, " << fullMs << " ms), ATVR "
+                << stats.before.atvr << " -> " << stats.after.atvr
+                << (sameTriangles ? "" : " (triangles changed)") << (better ? "" : " (worse than the original)")
+                << (withinThreshold ? "" : " (overdraw sorting over threshold)") << std::endl;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+// Normal matrix benchmark: GPU time of the model vertex stage with the normal
+// matrix inverted per vertex in the shader (INVERSE_NORMAL_MATRIX) against the
+// normal matrix computed on the CPU and passed as per-instance data. Copies of
+// the Plants1 model are drawn instanced into a 1x1 viewport, where almost
+// nothing is rasterized, so the GL_TIME_ELAPSED queries are dominated by the
+// vertex stage.
+//
+// Usage: bench_normal_matrix [instances]   (default 200)
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <cstdlib>
+#include "BenchScene.h"
+#include "BenchGL.h"
+#include "Model.h"
+#include "InstanceBatch.h"
+#include "GpuTimer.h"
+#include "UniformBuffer.h"
+
+namespace {
+
+MeshData foliageStandIn() { return bench::makeSphere(300, 300, 0.5f, glm::vec3(0.0f, 0.5f, 0.0f)); }
+
+// Average GPU time of one instanced draw of the batch over frames frames
+double timeVertexStage(const Shader& shader, InstanceBatch& batch, const Frustum& frustum, unsigned int frames) {
+    shader.use();
+    shader.set(shader.uniform<glm::mat4>("model"), glm::mat4(1.0f));
+    shader.set(shader.uniform<glm::mat3>("normalMatrix"), glm::mat3(1.0f));
+
+    GpuTimer timer;
+    double totalMs = 0.0;
+    unsigned int samples = 0;
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        CullStats stats;
+        timer.begin();
+        batch.Draw(shader, frustum, stats);
+        if (timer.end() && frame >= frames / 4) { // skip warm-up frames
+            totalMs += timer.lastMs();
+            samples++;
+        }
+        glFlush();
+    }
+    glFinish();
+    return samples ? totalMs / samples : 0.0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    unsigned int instanceCount = argc > 1 ? (unsigned int)std::strtoul(argv[1], nullptr, 10) : 200;
+
+    bench::HiddenContext context("bench_normal_matrix");
+    if (!context.ok())
+        return 1;
+
+    bool measured;
+    {
+        resetInstanceAttributes();
+
+        ModelData data = bench::loadBenchModel("Resources/Models/Plants1/scene.gltf", foliageStandIn);
+        size_t triangles = bench::triangleCount(data);
+        Model model(data, BVH(), Model::decodeImages(data));
+
+        // Rotated and non-uniformly scaled copies, so the normal matrix is not trivial
+        InstanceBatch batch(model);
+        for (unsigned int i = 0; i < instanceCount; i++) {
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3((float)(i % 20), 0.0f, -(float)(i / 20)));
+            transform = glm::rotate(transform, glm::radians(i * 37.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            transform = glm::scale(transform, glm::vec3(1.0f, 1.0f + (i % 3) * 0.5f, 1.0f));
+            batch.add(transform);
+        }
+
+        UniformBuffer<FrameData> frameData(FRAME_DATA_BINDING);
+        FrameData frame;
+        frame.view = glm::lookAt(glm::vec3(10.0f, 10.0f, 10.0f), glm::vec3(10.0f, 0.0f, -10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        frame.projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 1000.0f);
+        frame.viewPos = glm::vec4(10.0f, 10.0f, 10.0f, 1.0f);
+        frameData.update(frame);
+        // Everything passes the cull, so both variants draw every instance
+        Frustum frustum(glm::ortho(-1e4f, 1e4f, -1e4f, 1e4f, -1e4f, 1e4f));
+
+        Shader inverseShader("model_vertex.glsl", "model_fragment.glsl", nullptr, "#define INVERSE_NORMAL_MATRIX\n");
+        Shader cpuShader("model_vertex.glsl", "model_fragment.glsl");
+
+        // A small framebuffer of our own, since a hidden window may have none.
+        // Rasterization discard is not used because drivers may then skip the
+        // vertex shader entirely.
+        OffscreenTarget framebuffer(1, 1);
+        glEnable(GL_DEPTH_TEST);
+
+        const unsigned int frames = 200;
+        double inverseMs = timeVertexStage(inverseShader, batch, frustum, frames);
+        double cpuMs = timeVertexStage(cpuShader, batch, frustum, frames);
+
+
+        measured = inverseMs > 0.0 && cpuMs > 0.0;
+        std::cout << instanceCount << " instances of " << triangles << " triangles" << std::endl;
+        std::cout << "  per-vertex inverse: " << inverseMs << " ms" << std::endl;
+        std::cout << "  CPU normal matrix:  " << cpuMs << " ms (" << inverseMs / cpuMs << "x)" << std::endl;
+    }
+    return measured ? 0 : 1;
+}
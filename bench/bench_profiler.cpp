@@ -0,0 +1,202 @@
+// Profiler overhead benchmark: the cost of a CPU scope, a counter and a GPU
+// section (a GL_TIME_ELAPSED query pair) measured in tight loops, and the
+// cost of a frame's worth of them against the wall time of a frame of the
+// skybox benchmark's scene drawn through the render queue at 1350x1080. The
+// frame opens the scopes, sections and counters of the game's frame with
+// --profile at two simulation ticks a frame. The run fails if the profiler
+// adds 1% or more to the frame, or if the last frame does not leave its
+// top-level CPU scopes and every GPU section for the overlay. Frames drawn
+// with and without the profiler are also timed against each other, which is
+// reported but too noisy to judge by.
+//
+// Usage: bench_profiler [frames] [trace.json]   (default 50, no trace)
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <cstdlib>
+#include <string>
+#include "BenchScene.h"
+#include "BenchGL.h"
+#include "Model.h"
+#include "ModelInstance.h"
+#include "InstanceBatch.h"
+#include "Profiler.h"
+#include "RenderQueue.h"
+#include "Skybox.h"
+#include "UniformBuffer.h"
+
+namespace {
+
+const unsigned int IMAGE_WIDTH = 1350;
+const unsigned int IMAGE_HEIGHT = 1080;
+const unsigned int GRID_SIZE = 12;
+const unsigned int CALLS = 100000;
+const unsigned int GPU_CALLS = 2000;
+const unsigned int TICKS = 2;
+
+MeshData towerStandIn() { return bench::makeCylinder(4, 16, 0.3f, 2.0f, glm::vec3(0.0f)); }
+
+// Wall time per frame over frames frames, each finished before the next
+template <typename DrawFrame>
+double frameMs(DrawFrame drawFrame, unsigned int frames) {
+    drawFrame();
+    glFinish();
+    bench::Clock::time_point start = bench::Clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        drawFrame();
+        glFinish();
+    }
+    return frames ? bench::elapsedMs(start) / frames : 0.0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)std::strtoul(argv[1], nullptr, 10) : 50;
+    std::string tracePath = argc > 2 ? argv[2] : "";
+
+    bench::HiddenContext context("bench_profiler");
+    if (!context.ok())
+        return 1;
+
+    bool passed = true;
+    {
+        resetInstanceAttributes();
+        GLState::instance().setEnabled(GL_DEPTH_TEST, true);
+
+        Skybox skybox({
+            "Assets/skybox/px.png", "Assets/skybox/nx.png",
+            "Assets/skybox/py.png", "Assets/skybox/ny.png",
+            "Assets/skybox/pz.png", "Assets/skybox/nz.png" });
+        ModelData towerData = bench::loadBenchModel("Resources/Models/Tower/scene.gltf", towerStandIn);
+        Model tower(towerData, BVH(), Model::decodeImages(towerData));
+
+        std::vector<ModelInstance> scene;
+        float towerSize = glm::max(glm::length(tower.getBoundsMax() - tower.getBoundsMin()), 1e-3f);
+        for (unsigned int i = 0; i < GRID_SIZE * GRID_SIZE; i++) {
+            ModelInstance instance(tower);
+            instance.translate(glm::vec3(((float)(i % GRID_SIZE) - GRID_SIZE * 0.5f) * 1.5f, 0.0f, -(float)(i / GRID_SIZE) * 1.5f));
+            instance.scale(glm::vec3(3.0f / towerSize));
+            scene.push_back(instance);
+        }
+
+        glm::vec3 eye(0.0f, 4.0f, 8.0f);
+        FrameData frame;
+        frame.view = glm::lookAt(eye, glm::vec3(0.0f, 1.0f, -6.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        frame.projection = glm::perspective(glm::radians(45.0f), (float)IMAGE_WIDTH / IMAGE_HEIGHT, 0.1f, 100.0f);
+        frame.viewPos = glm::vec4(eye, 1.0f);
+        Frustum frustum(frame.projection * frame.view);
+        UniformBuffer<FrameData> frameData(FRAME_DATA_BINDING);
+        UniformBuffer<LightData> lightData(LIGHT_DATA_BINDING);
+        frameData.update(frame);
+        lightData.update(LightData());
+        Shader shader("model_vertex.glsl", "model_fragment.glsl", nullptr, "#define SHOW_NORMALS\n");
+
+        OffscreenTarget framebuffer(IMAGE_WIDTH, IMAGE_HEIGHT);
+
+        // The game's frame: seven top-level CPU scopes, input and gravity
+        // nested in simulation every tick and the queued skybox and ray in
+        // submit, a GPU section per pass and four counters
+        const unsigned int FRAME_TOP_LEVEL = 7, FRAME_SCOPES = FRAME_TOP_LEVEL + 2 * TICKS + 2;
+        const unsigned int FRAME_SECTIONS = 2, FRAME_COUNTERS = 4;
+        Profiler& profiler = Profiler::instance();
+        RenderQueue queue;
+        auto drawFrame = [&]() {
+            profiler.beginFrame();
+            {
+                ProfileScope profile("simulation");
+                for (unsigned int tick = 0; tick < TICKS; tick++) {
+                    { ProfileScope profile("input"); }
+                    { ProfileScope profile("gravity"); }
+                }
+            }
+            { ProfileScope profile("streaming"); }
+            GLState::instance().clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            CullStats stats;
+            queue.begin(eye, 100.0f);
+            queue.add(RENDER_PASS_SKY, skybox.getProgram(), 1.0f, [&]() {
+                ProfileScope profile("skybox");
+                skybox.Draw();
+            });
+            queue.add(RENDER_PASS_OPAQUE, shader.ID, 0.0f, [&]() {
+                ProfileScope profile("ray");
+            });
+            { ProfileScope profile("jobs"); }
+            {
+                ProfileScope profile("models");
+                for (const ModelInstance& instance : scene)
+                    queue.add(shader, instance, frustum, stats);
+            }
+            {
+                ProfileScope profile("submit");
+                queue.submit();
+            }
+            profiler.counter("draw calls", drawCounters().drawCalls);
+            profiler.counter("triangles", stats.triangles);
+            profiler.counter("binds", drawCounters().vertexArrayBinds + drawCounters().textureBinds);
+            profiler.counter("binds avoided", drawCounters().bindsAvoided);
+            { ProfileScope profile("swap"); }
+            { ProfileScope profile("events"); }
+            profiler.endFrame();
+        };
+
+        // Frames with and without the profiler, alternating to share the noise
+        double plainMs = 0.0, profiledMs = 0.0;
+        for (int round = 0; round < 2; round++) {
+            profiler.enabled = false;
+            plainMs += frameMs(drawFrame, frames) / 2.0;
+            profiler.enabled = true;
+            profiledMs += frameMs(drawFrame, frames) / 2.0;
+        }
+        size_t cpuSections = profiler.cpuSections().size();
+        size_t gpuSections = profiler.gpuSections().size();
+
+        // Per call costs, in a loop of nothing else
+        bench::Clock::time_point start = bench::Clock::now();
+        for (unsigned int i = 0; i < CALLS; i++) {
+            ProfileScope profile("scope");
+        }
+        double scopeUs = bench::elapsedMs(start) * 1000.0 / CALLS;
+        start = bench::Clock::now();
+        for (unsigned int i = 0; i < CALLS; i++)
+            profiler.counter("counter", (double)i);
+        double counterUs = bench::elapsedMs(start) * 1000.0 / CALLS;
+        start = bench::Clock::now();
+        for (unsigned int i = 0; i < GPU_CALLS; i++) {
+            {
+                GpuProfileScope profile("section");
+            }
+            profiler.endFrame();
+        }
+        double sectionUs = bench::elapsedMs(start) * 1000.0 / GPU_CALLS;
+        glFinish();
+        profiler.endFrame();
+
+        double overheadMs = (FRAME_SCOPES * scopeUs + FRAME_COUNTERS * counterUs + FRAME_SECTIONS * sectionUs) / 1000.0;
+        double share = plainMs > 0.0 ? overheadMs / plainMs : 0.0;
+        std::cout << IMAGE_WIDTH << "x" << IMAGE_HEIGHT << ", " << scene.size() << " instances, " << frames << " frames" << std::endl;
+        std::cout << "  CPU scope:             " << scopeUs * 1000.0 << " ns" << std::endl;
+        std::cout << "  counter:               " << counterUs * 1000.0 << " ns" << std::endl;
+        std::cout << "  GPU section:           " << sectionUs << " us" << std::endl;
+        std::cout << "  frame:                 " << plainMs << " ms, profiler " << overheadMs * 1000.0 << " us ("
+            << share * 100.0 << "%)" << std::endl;
+        std::cout << "  frame, profiled:       " << profiledMs << " ms (" << (profiledMs / plainMs - 1.0) * 100.0
+            << "% measured, noise included)" << std::endl;
+        std::cout << "  last frame:            " << cpuSections << " CPU sections, " << gpuSections << " GPU sections" << std::endl;
+
+        bool cheap = share < 0.01;
+        bool recorded = cpuSections == FRAME_TOP_LEVEL && gpuSections == FRAME_SECTIONS;
+        passed = cheap && recorded;
+        if (!cheap)
+            std::cout << "  the profiler costs 1% of the frame or more" << std::endl;
+        if (!recorded)
+            std::cout << "  the frames left the wrong sections for the overlay" << std::endl;
+        if (!tracePath.empty())
+            passed = profiler.writeTrace(tracePath) && passed;
+
+        profiler.release();
+    }
+    GeometryArena::instance().release();
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+// Ray casting benchmark: builds BVHs for the Target and Tower models and
+// shoots rays at them without a GL context. Every run first checks a sample of
+// rays against a brute-force scan of all triangles and fails on any mismatch.
+//
+// Usage: bench_raycast [rays per model]   (default 2000000)
+
+#include <cstdlib>
+#include <random>
+#include "BenchScene.h"
+#include "BVH.h"
+
+namespace {
+
+struct RaySet {
+    std::vector<Ray> rays;
+};
+
+// Rays from a sphere around the model towards random points inside its bounds
+RaySet makeRays(const BVH& bvh, size_t count, unsigned int seed) {
+    const BVH::Node& root = bvh.getNodes()[0];
+    glm::vec3 center = (root.boundsMin + root.boundsMax) * 0.5f;
+    glm::vec3 extent = root.boundsMax - root.boundsMin;
+    float radius = glm::length(extent);
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    RaySet set;
+    set.rays.reserve(count);
+    while (set.rays.size() < count) {
+        glm::vec3 d(unit(rng), unit(rng), unit(rng));
+        float len = glm::length(d);
+        if (len < 1e-3f || len > 1.0f)
+            continue;
+        glm::vec3 origin = center + d / len * radius;
+        glm::vec3 target = center + glm::vec3(unit(rng), unit(rng), unit(rng)) * extent * 0.5f;
+        set.rays.push_back({ origin, glm::normalize(target - origin) });
+    }
+    return set;
+}
+
+bool bruteForce(const BVH& bvh, const Ray& ray, RayHit& hit) {
+    bool found = false;
+    for (const BVH::Triangle& tri : bvh.getTriangles()) {
+        float u, v;
+        float t = intersectTriangle(ray, tri, u, v);
+        if (t > 0.0f && t < hit.distance) {
+            hit.distance = t;
+            hit.mesh = tri.mesh;
+            hit.triangle = tri.index;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Compare the BVH against brute force; returns the number of mismatches
+unsigned int validate(const BVH& bvh, const RaySet& set) {
+    unsigned int mismatches = 0;
+    for (const Ray& ray : set.rays) {
+        RayHit expected, actual;
+        bool expectedHit = bruteForce(bvh, ray, expected);
+        bool actualHit = bvh.intersect(ray, actual);
+        if (expectedHit != actualHit ||
+            (expectedHit && std::abs(expected.distance - actual.distance) > 1e-4f * (1.0f + expected.distance)))
+            mismatches++;
+    }
+    return mismatches;
+}
+
+MeshData targetStandIn() { return bench::makeSphere(200, 200, 1.0f, glm::vec3(0.0f, 1.0f, 0.0f)); }
+MeshData towerStandIn() { return bench::makeCylinder(300, 256, 2.0f, 12.0f, glm::vec3(0.0f)); }
+
+}
+
+int main(int argc, char** argv) {
+    size_t rayCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    bool failed = false;
+
+    struct Case { const char* path; MeshData (*standIn)(); };
+    const Case cases[] = {
+        { "Resources/Models/Target/scene.gltf", targetStandIn },
+        { "Resources/Models/Tower/scene.gltf", towerStandIn },
+    };
+
+    for (const Case& c : cases) {
+        ModelData data = bench::loadBenchModel(c.path, c.standIn);
+
+        bench::Clock::time_point start = bench::Clock::now();
+        BVH bvh;
+        bvh.build(data.meshes);
+        double buildMs = bench::elapsedMs(start);
+        std::cout << c.path << ": " << bench::triangleCount(data) << " triangles, "
+            << bvh.getNodes().size() << " nodes, built in " << buildMs << " ms" << std::endl;
+        if (bvh.empty())
+            continue;
+
+        unsigned int mismatches = validate(bvh, makeRays(bvh, 2000, 1));
+        std::cout << "  validation against brute force: " << mismatches << " mismatches in 2000 rays" << std::endl;
+        failed |= mismatches > 0;
+
+        RaySet set = makeRays(bvh, rayCount, 2);
+        size_t hits = 0;
+        start = bench::Clock::now();
+        for (const Ray& ray : set.rays) {
+            RayHit hit;
+            hits += bvh.intersect(ray, hit);
+        }
+        double ms = bench::elapsedMs(start);
+        std::cout << "  " << rayCount << " rays in " << ms << " ms: " << rayCount / (ms * 1000.0)
+            << " Mrays/s, " << ms * 1000.0 / rayCount << " us/ray, " << 100.0 * hits / rayCount << "% hit" << std::endl;
+    }
+
+    return failed ? 1 : 0;
+}
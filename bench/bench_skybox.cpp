@@ -0,0 +1,225 @@
+// Skybox fill-rate benchmark: a ground and a grid of towers covering most of
+// a 1350x1080 frame, with the skybox drawn first without depth writes, as the
+// game did, against drawn last at the far plane with GL_LEQUAL, where early
+// depth testing skips the pixels the scene covered. Fragment shader
+// invocations are counted with a pipeline statistics query where the driver
+// has one; GPU time per frame comes from GL_TIME_ELAPSED queries either way,
+// and wall time to glFinish for software renderers, whose queries see little.
+// Drivers that count invocations before the depth test report the same
+// count for both orders. The run fails if the two orders give different
+// images, or if the sky-last frame runs more fragment shader invocations.
+//
+// Usage: bench_skybox [frames]   (default 50)
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "BenchScene.h"
+#include "BenchGL.h"
+#include "Model.h"
+#include "ModelInstance.h"
+#include "InstanceBatch.h"
+#include "RenderQueue.h"
+#include "Skybox.h"
+#include "UniformBuffer.h"
+
+// GL 4.6 or ARB_pipeline_statistics_query, not in the GL 3.3 headers
+#ifndef GL_FRAGMENT_SHADER_INVOCATIONS
+#define GL_FRAGMENT_SHADER_INVOCATIONS 0x82F4
+#endif
+
+namespace {
+
+const unsigned int IMAGE_WIDTH = 1350;
+const unsigned int IMAGE_HEIGHT = 1080;
+const unsigned int GRID_SIZE = 12;
+
+MeshData towerStandIn() { return bench::makeCylinder(4, 16, 0.3f, 2.0f, glm::vec3(0.0f)); }
+
+// A square of ground, two triangles facing up
+MeshData groundPlane(float halfSize) {
+    MeshData mesh;
+    glm::vec3 up(0.0f, 1.0f, 0.0f);
+    mesh.vertices.push_back({ glm::vec3(-halfSize, 0.0f, -halfSize), up, glm::vec2(0.0f, 0.0f) });
+    mesh.vertices.push_back({ glm::vec3(halfSize, 0.0f, -halfSize), up, glm::vec2(1.0f, 0.0f) });
+    mesh.vertices.push_back({ glm::vec3(halfSize, 0.0f, halfSize), up, glm::vec2(1.0f, 1.0f) });
+    mesh.vertices.push_back({ glm::vec3(-halfSize, 0.0f, halfSize), up, glm::vec2(0.0f, 1.0f) });
+    mesh.indices = { 0, 2, 1, 0, 3, 2 };
+    mesh.boundsMin = glm::vec3(-halfSize, 0.0f, -halfSize);
+    mesh.boundsMax = glm::vec3(halfSize, 0.0f, halfSize);
+    return mesh;
+}
+
+bool hasPipelineStatistics() {
+    GLint major = 0, minor = 0, extensions = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 6))
+        return true;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions; i++) {
+        if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_pipeline_statistics_query") == 0)
+            return true;
+    }
+    return false;
+}
+
+struct FrameResult {
+    double gpuMs = 0.0;
+    double wallMs = 0.0;
+    GLuint64 fragments = 0;
+    std::vector<unsigned char> image;
+};
+
+// Draw frames frames with drawScene, timing each on the GPU and counting the
+// fragment shader invocations of the last, and read back the last frame
+template <typename DrawScene>
+FrameResult run(DrawScene drawScene, unsigned int frames, bool statistics) {
+    FrameResult result;
+    GLuint timeQuery, fragmentQuery;
+    glGenQueries(1, &timeQuery);
+    glGenQueries(1, &fragmentQuery);
+    bench::Clock::time_point start;
+    for (unsigned int frame = 0; frame <= frames; frame++) {
+        // The first frame warms up
+        bool measured = frame > 0;
+        if (frame == 1)
+            start = bench::Clock::now();
+        if (measured)
+            glBeginQuery(GL_TIME_ELAPSED, timeQuery);
+        if (frame == frames && statistics)
+            glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, fragmentQuery);
+        GLState::instance().clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawScene();
+        if (frame == frames && statistics)
+            glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+        if (measured) {
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(timeQuery, GL_QUERY_RESULT, &ns);
+            result.gpuMs += ns / 1e6;
+        }
+        glFinish();
+    }
+    result.wallMs = frames ? bench::elapsedMs(start) / frames : 0.0;
+    if (statistics)
+        glGetQueryObjectui64v(fragmentQuery, GL_QUERY_RESULT, &result.fragments);
+    glDeleteQueries(1, &timeQuery);
+    glDeleteQueries(1, &fragmentQuery);
+
+    result.gpuMs = frames ? result.gpuMs / frames : 0.0;
+    result.image.resize(IMAGE_WIDTH * IMAGE_HEIGHT * 4);
+    glReadPixels(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, result.image.data());
+    return result;
+}
+
+// Share of the pixels that differ by more than 8/255
+double differingShare(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) {
+    size_t differing = 0;
+    for (size_t i = 0; i < a.size(); i += 4) {
+        int difference = 0;
+        for (int c = 0; c < 4; c++)
+            difference = std::max(difference, std::abs((int)a[i + c] - (int)b[i + c]));
+        differing += difference > 8;
+    }
+    return (double)differing / (a.size() / 4);
+}
+
+}
+
+int main(int argc, char** argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)std::strtoul(argv[1], nullptr, 10) : 50;
+
+    bench::HiddenContext context("bench_skybox");
+    if (!context.ok())
+        return 1;
+    bool statistics = hasPipelineStatistics();
+
+    bool passed = true;
+    {
+        resetInstanceAttributes();
+        GLState::instance().setEnabled(GL_DEPTH_TEST, true);
+
+        // The game's faces; without them the sky samples black, which costs the same
+        Skybox skybox({
+            "Assets/skybox/px.png", "Assets/skybox/nx.png",
+            "Assets/skybox/py.png", "Assets/skybox/ny.png",
+            "Assets/skybox/pz.png", "Assets/skybox/nz.png" });
+
+        ModelData groundData;
+        groundData.meshes.push_back(groundPlane(50.0f));
+        Model ground(groundData, BVH(), Model::decodeImages(groundData));
+        ModelData towerData = bench::loadBenchModel("Resources/Models/Tower/scene.gltf", towerStandIn);
+        Model tower(towerData, BVH(), Model::decodeImages(towerData));
+
+        std::vector<ModelInstance> scene;
+        scene.push_back(ModelInstance(ground));
+        float towerSize = glm::max(glm::length(tower.getBoundsMax() - tower.getBoundsMin()), 1e-3f);
+        for (unsigned int i = 0; i < GRID_SIZE * GRID_SIZE; i++) {
+            ModelInstance instance(tower);
+            instance.translate(glm::vec3(((float)(i % GRID_SIZE) - GRID_SIZE * 0.5f) * 1.5f, 0.0f, -(float)(i / GRID_SIZE) * 1.5f));
+            instance.scale(glm::vec3(3.0f / towerSize));
+            scene.push_back(instance);
+        }
+
+        // Looking over the towers, with a strip of sky above them
+        glm::vec3 eye(0.0f, 4.0f, 8.0f);
+        FrameData frame;
+        frame.view = glm::lookAt(eye, glm::vec3(0.0f, 1.0f, -6.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        frame.projection = glm::perspective(glm::radians(45.0f), (float)IMAGE_WIDTH / IMAGE_HEIGHT, 0.1f, 100.0f);
+        frame.viewPos = glm::vec4(eye, 1.0f);
+        Frustum frustum(frame.projection * frame.view);
+        UniformBuffer<FrameData> frameData(FRAME_DATA_BINDING);
+        UniformBuffer<LightData> lightData(LIGHT_DATA_BINDING);
+        frameData.update(frame);
+        lightData.update(LightData());
+
+        // Normals make the image independent of the textures, which stand-ins lack
+        Shader shader("model_vertex.glsl", "model_fragment.glsl", nullptr, "#define SHOW_NORMALS\n");
+
+        OffscreenTarget framebuffer(IMAGE_WIDTH, IMAGE_HEIGHT);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+        RenderQueue queue;
+        auto drawScene = [&](RenderPass skyPass) {
+            CullStats stats;
+            queue.begin(eye, 100.0f);
+            queue.add(skyPass, skybox.getProgram(), 1.0f, [&]() {
+                skybox.Draw();
+            });
+            for (const ModelInstance& instance : scene)
+                queue.add(shader, instance, frustum, stats);
+            queue.submit();
+        };
+
+        FrameResult skyFirst = run([&]() { drawScene(RENDER_PASS_BACKGROUND); }, frames, statistics);
+        FrameResult skyLast = run([&]() { drawScene(RENDER_PASS_SKY); }, frames, statistics);
+
+        std::cout << IMAGE_WIDTH << "x" << IMAGE_HEIGHT << ", " << scene.size() << " instances" << std::endl;
+
+        const char* names[] = { "sky first: ", "sky last:  " };
+        const FrameResult* results[] = { &skyFirst, &skyLast };
+        for (int i = 0; i < 2; i++) {
+            std::cout << "  " << names[i] << results[i]->gpuMs << " GPU ms, " << results[i]->wallMs << " wall ms per frame";
+            if (statistics)
+                std::cout << ", " << results[i]->fragments << " fragment shader invocations ("
+                    << (double)results[i]->fragments / (IMAGE_WIDTH * IMAGE_HEIGHT) << " per pixel)";
+            std::cout << std::endl;
+        }
+        if (!statistics)
+            std::cout << "  (no pipeline statistics queries on this driver; GPU time only)" << std::endl;
+
+        double share = differingShare(skyFirst.image, skyLast.image);
+        bool sameImage = share <= 0.001;
+        bool noMoreFragments = !statistics || skyLast.fragments <= skyFirst.fragments;
+        passed = sameImage && noMoreFragments;
+        std::cout << "  " << share * 100.0 << "% of pixels differ" << (sameImage ? "" : " (over 0.1%)")
+            << (noMoreFragments ? "" : ", more fragment shader invocations with the sky last") << std::endl;
+
+    }
+    GeometryArena::instance().release();
+
+    return passed ? 0 : 1;
+}
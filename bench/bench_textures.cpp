@@ -0,0 +1,175 @@
+// Texture pipeline benchmark: load time and GPU memory of every model image
+// decoded with stb_image and uploaded uncompressed (with glGenerateMipmap),
+// against the baked KTX2 files that are only mapped and uploaded as blocks.
+// Each image is also compressed in memory and checked against its source: the
+// run fails if the PSNR of any level 0 falls below the format's threshold.
+// When no model images are on disk a synthetic one is used.
+//
+// Usage: bench_textures [--bc7]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include "BenchScene.h"
+#include "BlockCompression.h"
+#include "Ktx2.h"
+#include "TextureManager.h"
+
+namespace {
+
+const char* modelPaths[] = {
+    "Resources/Models/Guns/scene.gltf",
+    "Resources/Models/Ground/scene.gltf",
+    "Resources/Models/Plants1/scene.gltf",
+    "Resources/Models/Target/scene.gltf",
+    "Resources/Models/Tower/scene.gltf",
+    "Resources/Models/Hut/scene.gltf",
+};
+
+// Smooth gradients, hard edges and some grain, 1024x1024 RGBA, saved as an
+// uncompressed TGA so stb_image has a real file to decode
+bool writeSyntheticImage(const std::string& path) {
+    const int size = 1024;
+    unsigned char header[18] = {};
+    header[2] = 2; // uncompressed true color
+    header[12] = size & 255; header[13] = size >> 8;
+    header[14] = size & 255; header[15] = size >> 8;
+    header[16] = 32;   // BGRA
+    header[17] = 0x28; // 8 alpha bits, top-left origin
+
+    std::vector<unsigned char> pixels((size_t)size * size * 4);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> grain(-6, 6);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            unsigned char* p = &pixels[((size_t)y * size + x) * 4];
+            bool stripe = (x / 64 + y / 64) % 2 == 0;
+            p[2] = (unsigned char)glm::clamp(x / 4 + grain(rng), 0, 255);
+            p[1] = (unsigned char)glm::clamp(y / 4 + grain(rng), 0, 255);
+            p[0] = (unsigned char)(stripe ? 200 : 40);
+            p[3] = (unsigned char)(128 + 127 * std::sin(x * 0.02f) * std::cos(y * 0.02f));
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write((const char*)header, sizeof(header));
+    out.write((const char*)pixels.data(), pixels.size());
+    return (bool)out;
+}
+
+double psnr(const ImageData& image, const std::vector<uint8_t>& decoded) {
+    // Compare the channels the image has, placed as compressImage places them
+    double sum = 0.0;
+    size_t count = 0;
+    const unsigned char* source = image.pixels.get();
+    for (size_t i = 0; i < (size_t)image.width * image.height; i++) {
+        const unsigned char* s = source + i * image.components;
+        const uint8_t* d = &decoded[i * 4];
+        for (int c = 0; c < image.components; c++) {
+            double e = (double)s[c] - d[c];
+            sum += e * e;
+            count++;
+        }
+    }
+    double mse = sum / (double)count;
+    return mse == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+double psnrThreshold(BlockFormat format) {
+    return format == BlockFormat::BC1 || format == BlockFormat::BC3 ? 30.0 : 35.0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    bool highQuality = argc > 1 && std::strcmp(argv[1], "--bc7") == 0;
+    bool failed = false;
+
+    // Every image file referenced by the models, once
+    std::vector<std::string> files;
+    for (const char* path : modelPaths) {
+        struct stat info;
+        ModelData data;
+        if (stat(path, &info) != 0 || !loadModelData(path, data))
+            continue;
+        for (const ImageData& image : data.images) {
+            std::string file = TextureManager::canonicalPath(data.directory, image.path);
+            if (std::find(files.begin(), files.end(), file) == files.end())
+                files.push_back(file);
+        }
+    }
+
+    // Without assets, a synthetic image in the working directory
+    const std::string syntheticPath = "bench_textures_synthetic.tga";
+    bool synthetic = files.empty();
+    if (synthetic) {
+        std::cout << "No model images found, using a synthetic 1024x1024 image" << std::endl;
+        if (!writeSyntheticImage(syntheticPath))
+            return 1;
+        files.push_back(syntheticPath);
+    }
+
+    double decodeMs = 0.0, mapMs = 0.0, encodeMs = 0.0;
+    size_t uncompressedBytes = 0, compressedBytes = 0;
+    for (const std::string& file : files) {
+        // Before: decode on the CPU, upload RGBA8 (drivers pad RGB) plus a third for mips
+        bench::Clock::time_point start = bench::Clock::now();
+        ImageData image;
+        image.path = file;
+        decodeImageFile(file, image);
+        decodeMs += bench::elapsedMs(start);
+        if (!image.pixels)
+            continue;
+        uncompressedBytes += (size_t)image.width * image.height * 4 * 4 / 3;
+
+        // Bake, and check the quality of the top level
+        BlockFormat format = chooseBlockFormat(image.components, highQuality);
+        start = bench::Clock::now();
+        CompressedImage compressed = compressImage(image, format);
+        encodeMs += bench::elapsedMs(start);
+        const CompressedImage::Level& top = compressed.levels[0];
+        double quality = psnr(image, decompressLevel(format, top.data.data(), top.width, top.height));
+        bool good = quality >= psnrThreshold(format);
+        failed |= !good;
+        std::cout << "  " << file << ": " << image.width << "x" << image.height << "x" << image.components << ", "
+            << blockFormatName(format) << ", " << compressed.levels.size() << " levels, PSNR " << quality << " dB"
+            << (good ? "" : " (below threshold)") << std::endl;
+
+        // After: map the baked file; the driver reads the blocks straight from it
+        Ktx2Texture texture;
+        if (!readKtx2(file, texture) || texture.format != format) {
+            if (!writeKtx2(file, compressed)) {
+                std::cout << "ERROR::BENCH::KTX2_WRITE_FAILED: " << file << std::endl;
+                failed = true;
+                continue;
+            }
+        }
+        start = bench::Clock::now();
+        Ktx2Texture mapped;
+        bool read = readKtx2(file, mapped);
+        volatile uint8_t touched = 0;
+        for (const Ktx2Texture::Level& level : mapped.levels) {
+            for (size_t i = 0; i < level.size; i += 4096)
+                touched = touched + level.data[i]; // fault the pages in, as the upload would
+            compressedBytes += level.size;
+        }
+        mapMs += bench::elapsedMs(start);
+        failed |= !read;
+    }
+
+    std::cout << files.size() << " images" << std::endl;
+    std::cout << "  stb_image + uncompressed: " << decodeMs << " ms to decode, "
+        << uncompressedBytes / (1024.0 * 1024.0) << " MB of GPU memory" << std::endl;
+    std::cout << "  baked KTX2:               " << mapMs << " ms to map, "
+        << compressedBytes / (1024.0 * 1024.0) << " MB of GPU memory (" << (double)uncompressedBytes / compressedBytes
+        << "x smaller); encoding took " << encodeMs << " ms offline" << std::endl;
+
+    if (synthetic) {
+        std::remove(ktx2Path(syntheticPath).c_str());
+        std::remove(syntheticPath.c_str());
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+// Vertex format benchmark: buffer size and GPU time of the Plants1 model
+// uploaded as full float vertices with 32-bit indices against PackedVertex with
+// 16-bit indices, plus a visual diff of the two. Each path renders the model
+// lit, as normals and as texture coordinates into an offscreen framebuffer;
+// the run fails if more than 1% of the covered pixels differ by more than
+// 8/255 in any channel. The timing draws instanced copies into a 1x1 viewport
+// as bench_normal_matrix does.
+//
+// Usage: bench_vertex_format [instances]   (default 200)
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdlib>
+#include "BenchScene.h"
+#include "BenchGL.h"
+#include "Model.h"
+#include "InstanceBatch.h"
+#include "GpuTimer.h"
+#include "UniformBuffer.h"
+
+namespace {
+
+const unsigned int IMAGE_SIZE = 512;
+
+MeshData foliageStandIn() { return bench::makeSphere(300, 300, 0.5f, glm::vec3(0.0f, 0.5f, 0.0f)); }
+
+size_t bufferBytes(const Model& model) {
+    size_t bytes = 0;
+    for (const Mesh& mesh : model.getMeshes())
+        bytes += mesh.gpuBytes();
+    return bytes;
+}
+
+// The model drawn once with shader into the framebuffer, read back as RGBA
+std::vector<unsigned char> renderImage(const Shader& shader, const Model& model, const OffscreenTarget& target) {
+    target.bind();
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    shader.use();
+    shader.set(shader.uniform<glm::mat4>("model"), glm::mat4(1.0f));
+    shader.set(shader.uniform<glm::mat3>("normalMatrix"), glm::mat3(1.0f));
+    model.Draw(shader);
+
+    std::vector<unsigned char> pixels(target.width * target.height * 4);
+    glReadPixels(0, 0, target.width, target.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return pixels;
+}
+
+// Share of the pixels covered in either image that differ by more than 8/255
+double differingShare(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, size_t& covered, int& maxDifference) {
+    size_t differing = 0;
+    for (size_t i = 0; i < a.size(); i += 4) {
+        if (a[i + 3] == 0 && b[i + 3] == 0)
+            continue;
+        covered++;
+        int difference = 0;
+        for (int c = 0; c < 4; c++)
+            difference = std::max(difference, std::abs((int)a[i + c] - (int)b[i + c]));
+        maxDifference = std::max(maxDifference, difference);
+        differing += difference > 8;
+    }
+    return covered ? (double)differing / covered : 0.0;
+}
+
+// Average GPU time of one instanced draw of the batch over frames frames
+double timeDraws(const Shader& shader, InstanceBatch& batch, const Frustum& frustum, unsigned int frames) {
+    shader.use();
+    shader.set(shader.uniform<glm::mat4>("model"), glm::mat4(1.0f));
+    shader.set(shader.uniform<glm::mat3>("normalMatrix"), glm::mat3(1.0f));
+
+    GpuTimer timer;
+    double totalMs = 0.0;
+    unsigned int samples = 0;
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        CullStats stats;
+        timer.begin();
+        batch.Draw(shader, frustum, stats);
+        if (timer.end() && frame >= frames / 4) { // skip warm-up frames
+            totalMs += timer.lastMs();
+            samples++;
+        }
+        glFlush();
+    }
+    glFinish();
+    return samples ? totalMs / samples : 0.0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    unsigned int instanceCount = argc > 1 ? (unsigned int)std::strtoul(argv[1], nullptr, 10) : 200;
+
+    bench::HiddenContext context("bench_vertex_format");
+    if (!context.ok())
+        return 1;
+
+    bool passed = true;
+    {
+        resetInstanceAttributes();
+        glEnable(GL_DEPTH_TEST);
+
+        // The same model uploaded both ways
+        const char* path = "Resources/Models/Plants1/scene.gltf";
+        vertexCompression() = false;
+        ModelData floatData = bench::loadBenchModel(path, foliageStandIn);
+        size_t triangles = bench::triangleCount(floatData);
+        Model floatModel(floatData, BVH(), Model::decodeImages(floatData));
+        vertexCompression() = true;
+        ModelData packedData = bench::loadBenchModel(path, foliageStandIn);
+        Model packedModel(packedData, BVH(), Model::decodeImages(packedData));
+
+        unsigned int packedMeshes = 0;
+        for (const Mesh& mesh : packedModel.getMeshes())
+            packedMeshes += mesh.isPacked();
+
+        // Frame the model's bounds
+        glm::vec3 center = (floatModel.getBoundsMin() + floatModel.getBoundsMax()) * 0.5f;
+        float radius = glm::length(floatModel.getBoundsMax() - floatModel.getBoundsMin()) * 0.5f;
+        glm::vec3 eye = center + glm::normalize(glm::vec3(1.0f, 0.7f, 1.2f)) * radius * 2.0f;
+        UniformBuffer<FrameData> frameData(FRAME_DATA_BINDING);
+        UniformBuffer<LightData> lightData(LIGHT_DATA_BINDING);
+        FrameData frame;
+        frame.view = glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+        frame.projection = glm::perspective(glm::radians(45.0f), 1.0f, radius * 0.1f, radius * 10.0f);
+        frame.viewPos = glm::vec4(eye, 1.0f);
+        frameData.update(frame);
+        LightData light;
+        light.position = glm::vec4(eye + glm::vec3(0.0f, radius * 4.0f, 0.0f), 1.0f);
+        light.ambient = glm::vec4(0.2f);
+        light.diffuse = glm::vec4(0.8f);
+        light.specular = glm::vec4(0.4f);
+        lightData.update(light);
+
+        // Visual diff of every view
+        Shader litShader("model_vertex.glsl", "model_fragment.glsl");
+        Shader normalShader("model_vertex.glsl", "model_fragment.glsl", nullptr, "#define SHOW_NORMALS\n");
+        Shader texCoordShader("model_vertex.glsl", "model_fragment.glsl", nullptr, "#define SHOW_TEXCOORDS\n");
+        litShader.use();
+        litShader.set(litShader.uniform<float>("material.shininess"), 40.0f);
+        const Shader* views[] = { &litShader, &normalShader, &texCoordShader };
+        const char* viewNames[] = { "lit", "normals", "texture coordinates" };
+
+        std::cout << triangles << " triangles, " << packedMeshes << " of " << packedModel.getMeshes().size()
+            << " meshes packed" << std::endl;
+        {
+            OffscreenTarget image(IMAGE_SIZE, IMAGE_SIZE);
+            for (unsigned int i = 0; i < 3; i++) {
+                std::vector<unsigned char> reference = renderImage(*views[i], floatModel, image);
+                std::vector<unsigned char> packed = renderImage(*views[i], packedModel, image);
+                size_t covered = 0;
+                int maxDifference = 0;
+                double share = differingShare(reference, packed, covered, maxDifference);
+                bool good = covered > 0 && share <= 0.01;
+                passed &= good;
+                std::cout << "  " << viewNames[i] << ": " << share * 100.0 << "% of " << covered
+                    << " pixels differ, at most by " << maxDifference << "/255"
+                    << (covered == 0 ? " (nothing drawn)" : good ? "" : " (over 1%)") << std::endl;
+            }
+        }
+
+        // Timing, with instanced copies in a 1x1 viewport
+        InstanceBatch floatBatch(floatModel), packedBatch(packedModel);
+        for (unsigned int i = 0; i < instanceCount; i++) {
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3((float)(i % 20), 0.0f, -(float)(i / 20)));
+            floatBatch.add(transform);
+            packedBatch.add(transform);
+        }
+        Frustum frustum(glm::ortho(-1e4f, 1e4f, -1e4f, 1e4f, -1e4f, 1e4f));
+        double floatMs, packedMs;
+        {
+            OffscreenTarget pixel(1, 1);
+            floatMs = timeDraws(litShader, floatBatch, frustum, 200);
+            packedMs = timeDraws(litShader, packedBatch, frustum, 200);
+        }
+
+        size_t floatBytes = bufferBytes(floatModel), packedBytes = bufferBytes(packedModel);
+        std::cout << "  float vertices:  " << floatBytes / 1024.0 << " KB, " << floatMs << " ms for "
+            << instanceCount << " instances" << std::endl;
+        std::cout << "  packed vertices: " << packedBytes / 1024.0 << " KB (" << (double)packedBytes / floatBytes
+            << " of the size), " << packedMs << " ms" << std::endl;
+    }
+
+    return passed ? 0 : 1;
+}
@@ -26,7 +26,13 @@ struct SpotLight {
     float outerCutOff;
 };
 
-uniform vec3 viewPos;
+// Shared per-frame camera data
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
 uniform PointLight pointLight;
 uniform DirectionalLight dirLight;
 uniform SpotLight spotLight;
@@ -1,6 +1,7 @@
 // mesh_generator.cpp
 #include "meshGenerator.h"
 #include "glm/glm.hpp"
+#include "GLState.h"
 #include <iostream>
 
 MeshGen::MeshGen(const std::vector<float>& vertices, const std::vector<unsigned int>& indices)
@@ -9,9 +10,9 @@ MeshGen::MeshGen(const std::vector<float>& vertices, const std::vector<unsigned
 }
 
 MeshGen::~MeshGen() {
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    GLState::instance().deleteVertexArrays(1, &VAO);
+    GLState::instance().deleteBuffers(1, &VBO);
+    GLState::instance().deleteBuffers(1, &EBO);
 }
 
 void MeshGen::setupMesh() {
@@ -19,12 +20,12 @@ void MeshGen::setupMesh() {
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
+    GLState::instance().bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLState::instance().bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    GLState::instance().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
     // Position attribute
@@ -35,13 +36,12 @@ void MeshGen::setupMesh() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);
+    GLState::instance().bindVertexArray(0);
 }
 
 void MeshGen::render() const {
-    glBindVertexArray(VAO);
+    GLState::instance().bindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
 
 MeshGen MeshGenerator::generatePlane(float width, float height, const glm::vec3& position) {
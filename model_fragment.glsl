@@ -19,9 +19,19 @@ struct Light {
     vec3 specular;
 };
 
-uniform vec3 viewPos;
+// Shared per-frame camera data
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+// Sun light, updated only when it changes
+layout (std140) uniform LightData {
+    Light light;
+};
+
 uniform Material material;
-uniform Light light;
 
 void main()
 {    
@@ -42,4 +52,11 @@ void main()
         
     vec3 result = ambient + diffuse + specular;
     FragColor = vec4(result, 1.0);
+
+    // Debug views of the vertex attributes, for bench_vertex_format
+#if defined(SHOW_NORMALS)
+    FragColor = vec4(norm * 0.5 + 0.5, 1.0);
+#elif defined(SHOW_TEXCOORDS)
+    FragColor = vec4(fract(TexCoords), 0.0, 1.0);
+#endif
 }
\ No newline at end of file
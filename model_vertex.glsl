@@ -3,19 +3,55 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// Per-instance transforms. Non-instanced draws leave the arrays disabled and
+// read the identity set by resetInstanceAttributes().
+layout (location = 3) in mat4 aInstanceModel;
+layout (location = 7) in mat3 aInstanceNormal;
+#ifdef DRAW_ID
+// DrawList draws read their transform and position decoding from drawData,
+// 9 texels per draw (see DrawData in DrawList.h)
+layout (location = 10) in uint aDrawId;
+uniform samplerBuffer drawData;
+#endif
 
 out vec2 TexCoords;
 out vec3 FragPos;
 out vec3 Normal;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix; // inverse transpose of model, computed on the CPU
+// Packed meshes store positions as 0-1 within their bounds; float ones use 0 and 1
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+// Shared per-frame camera data
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+#ifdef DRAW_ID
+    int base = int(aDrawId) * 9;
+    mat4 world = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1),
+        texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    mat3 worldNormal = mat3(texelFetch(drawData, base + 4).xyz, texelFetch(drawData, base + 5).xyz,
+        texelFetch(drawData, base + 6).xyz);
+    vec3 position = texelFetch(drawData, base + 7).xyz + texelFetch(drawData, base + 8).xyz * aPos;
+#else
+    mat4 world = model * aInstanceModel;
+    mat3 worldNormal = normalMatrix * aInstanceNormal;
+    vec3 position = positionOffset + positionScale * aPos;
+#endif
+    FragPos = vec3(world * vec4(position, 1.0));
+#ifdef INVERSE_NORMAL_MATRIX
+    // Old per-vertex inverse, kept for bench_normal_matrix
+    Normal = mat3(transpose(inverse(world))) * aNormal;
+#else
+    Normal = worldNormal * aNormal;
+#endif
     TexCoords = aTexCoords;
     
     gl_Position = projection * view * vec4(FragPos, 1.0);
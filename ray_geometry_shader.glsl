@@ -2,8 +2,13 @@
 layout(lines) in;               // Input: 2 vertices defining a line
 layout(triangle_strip, max_vertices = 6) out; // Output: 6 vertices for a quad
 
-uniform mat4 view;
-uniform mat4 projection;
+// Shared per-frame camera data
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
 uniform float thickness; // Thickness of the ray
 
 out vec3 fragColor; // Pass color to fragment shader
@@ -1,8 +1,12 @@
 #version 330 core
 layout (location = 0) in vec3 position;
 
-uniform mat4 view;
-uniform mat4 projection;
+// Shared per-frame camera data
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 void main() {
     gl_Position = projection * view * vec4(position, 1.0);
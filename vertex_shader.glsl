@@ -8,12 +8,18 @@ out vec3 Normal;
 out vec2 TexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix; // inverse transpose of model, computed on the CPU
+
+// Shared per-frame camera data
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 void main() {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal; // Handle normal transformation
+    Normal = normalMatrix * aNormal; // Handle normal transformation
     TexCoords = aTexCoords;
 
     gl_Position = projection * view * vec4(FragPos, 1.0);